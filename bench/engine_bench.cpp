@@ -0,0 +1,333 @@
+// Headless engine benchmark. Builds a synthetic project, renders it offline
+// through uph_engine_render the same way the device callback would and
+// prints one JSON object with the results on stdout.
+//
+// MIDI tracks play the built-in synth so the numbers don't depend on which
+// plugins happen to be installed.
+//
+//   UphonicBench --tracks 32 --patterns 8 --notes 256 --seconds 30
+//   UphonicBench --tracks 32 --double 1     (double precision tracks and mix)
+//   UphonicBench --tracks 4 --idle-tracks 60 (instruments with nothing to play)
+
+#include "types.h"
+#include "engine/engine.h"
+#include "engine/dsp_kernels.h"
+#include "engine/interpolation.h"
+#include "engine/realtime.h"
+#include "engine/render_snapshot.h"
+
+#include <uvi_synth.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#if UPH_PLATFORM_WINDOWS
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+struct UphBenchConfig
+{
+    uint32_t tracks = 16;
+    uint32_t patterns = 8;
+    uint32_t notes = 128;
+    uint32_t idle_tracks = 0;
+    uint32_t sample_tracks = 0;
+    float sample_seconds = 4.0f;
+    float stretch = 1.0f;
+    UphInterpolation interpolation = UphInterpolation_Cubic;
+    float seconds = 10.0f;
+    uint32_t block_size = 256;
+    uint32_t sample_rate = 48000;
+    uint32_t workers = 0;
+    int isa = -1;
+    bool double_precision = false;
+    bool realtime = false;
+    uint32_t seed = 1;
+};
+
+static const float k_pattern_beats = 16.0f;
+
+static void uph_bench_build_project(const UphBenchConfig &config)
+{
+    UphProject &project = app->project;
+    project.double_precision = config.double_precision;
+    std::mt19937 rng(config.seed);
+    std::uniform_real_distribution<float> start_dist(0.0f, k_pattern_beats);
+    std::uniform_real_distribution<float> length_dist(0.125f, 1.0f);
+    std::uniform_int_distribution<int> key_dist(36, 96);
+
+    project.patterns.resize(config.patterns);
+    for (uint32_t i = 0; i < config.patterns; ++i)
+    {
+        UphMidiPattern &pattern = project.patterns[i];
+        snprintf(pattern.name, sizeof(pattern.name), "Pattern %u", i);
+        for (uint32_t n = 0; n < config.notes; ++n)
+            pattern.notes.push_back({ start_dist(rng), length_dist(rng), (uint8_t)key_dist(rng), 100 });
+    }
+
+    const uint64_t sample_frames = (uint64_t)(config.sample_seconds * config.sample_rate);
+    if (config.sample_tracks > 0 && sample_frames > 0)
+    {
+        UphSample sample{};
+        snprintf(sample.name, sizeof(sample.name), "Bench Sample");
+        sample.type = UphSampleType_Stereo;
+        sample.sample_rate = (float)config.sample_rate;
+        sample.frame_count = sample_frames;
+        sample.frames = uph_sample_frames_alloc(sample_frames, 2);
+        for (uint64_t i = 0; i < sample_frames; ++i)
+        {
+            const float value = 0.1f * sinf((float)i * 0.01f);
+            sample.frames[i * 2] = value;
+            sample.frames[i * 2 + 1] = value;
+        }
+        project.samples.push_back(sample);
+    }
+
+    const float song_beats = config.seconds * project.bpm / 60.0f;
+    const uint32_t instance_count = (uint32_t)ceilf(song_beats / k_pattern_beats) + 1;
+
+    project.tracks.clear();
+    project.tracks.resize(config.tracks + config.sample_tracks + config.idle_tracks);
+    for (uint32_t t = 0; t < config.tracks; ++t)
+    {
+        UphTrack &track = project.tracks[t];
+        snprintf(track.name, sizeof(track.name), "Midi %u", t);
+        track.track_type = UphTrackType_Midi;
+        track.instrument.plugin = new UviPlugin(uvi_plugin_load(UVI_SYNTH_PATH));
+
+        if (config.patterns == 0)
+            continue;
+
+        for (uint32_t i = 0; i < instance_count; ++i)
+        {
+            UphTimelineBlock block{};
+            block.track_type = UphTrackType_Midi;
+            block.pattern_index = (uint16_t)((t + i) % config.patterns);
+            block.start_time = i * k_pattern_beats;
+            block.start_offset = 0.0f;
+            block.length = k_pattern_beats;
+            track.timeline_blocks.push_back(block);
+        }
+    }
+
+    const float sample_beats = config.sample_seconds * project.bpm / 60.0f;
+    for (uint32_t t = 0; t < config.sample_tracks; ++t)
+    {
+        UphTrack &track = project.tracks[config.tracks + t];
+        snprintf(track.name, sizeof(track.name), "Sample %u", t);
+        track.track_type = UphTrackType_Sample;
+        track.interpolation = config.interpolation;
+
+        if (project.samples.empty())
+            continue;
+
+        for (float beat = 0.0f; beat < song_beats; beat += sample_beats)
+        {
+            UphTimelineBlock block{};
+            block.track_type = UphTrackType_Sample;
+            block.sample_index = 0;
+            block.start_time = beat;
+            block.start_offset = 0.0f;
+            block.length = sample_beats;
+            block.stretch_scale = config.stretch;
+            track.timeline_blocks.push_back(block);
+        }
+    }
+
+    for (uint32_t t = 0; t < config.idle_tracks; ++t)
+    {
+        UphTrack &track = project.tracks[config.tracks + config.sample_tracks + t];
+        snprintf(track.name, sizeof(track.name), "Idle %u", t);
+        track.track_type = UphTrackType_Midi;
+        track.instrument.plugin = new UviPlugin(uvi_plugin_load(UVI_SYNTH_PATH));
+    }
+
+    // Keep the editor's track selection off the measured tracks, selected
+    // tracks never sleep.
+    app->current_track_index = (uint32_t)project.tracks.size();
+}
+
+static void uph_bench_destroy_project(void)
+{
+    for (UphTrack &track : app->project.tracks)
+    {
+        if (!track.instrument.plugin)
+            continue;
+        uvi_plugin_unload(track.instrument.plugin);
+        delete track.instrument.plugin;
+    }
+    for (UphSample &sample : app->project.samples)
+        uph_sample_frames_free(sample.frames);
+}
+
+static uint64_t uph_bench_peak_rss_kb(void)
+{
+#if UPH_PLATFORM_WINDOWS
+    PROCESS_MEMORY_COUNTERS counters{};
+    GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters));
+    return counters.PeakWorkingSetSize / 1024;
+#else
+    struct rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+    return (uint64_t)usage.ru_maxrss;
+#endif
+}
+
+static bool uph_bench_parse_args(int argc, char **argv, UphBenchConfig *config)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        const char *arg = argv[i];
+        const char *value = (i + 1 < argc) ? argv[i + 1] : nullptr;
+        if (!value)
+        {
+            fprintf(stderr, "Missing value for %s\n", arg);
+            return false;
+        }
+        ++i;
+
+        if (strcmp(arg, "--tracks") == 0)              config->tracks = (uint32_t)atoi(value);
+        else if (strcmp(arg, "--patterns") == 0)       config->patterns = (uint32_t)atoi(value);
+        else if (strcmp(arg, "--notes") == 0)          config->notes = (uint32_t)atoi(value);
+        else if (strcmp(arg, "--idle-tracks") == 0)    config->idle_tracks = (uint32_t)atoi(value);
+        else if (strcmp(arg, "--sample-tracks") == 0)  config->sample_tracks = (uint32_t)atoi(value);
+        else if (strcmp(arg, "--sample-seconds") == 0) config->sample_seconds = (float)atof(value);
+        else if (strcmp(arg, "--stretch") == 0)        config->stretch = (float)atof(value);
+        else if (strcmp(arg, "--interpolation") == 0)  config->interpolation = (UphInterpolation)std::clamp(atoi(value), 0, (int)UphInterpolation_Count - 1);
+        else if (strcmp(arg, "--seconds") == 0)        config->seconds = (float)atof(value);
+        else if (strcmp(arg, "--block") == 0)          config->block_size = (uint32_t)atoi(value);
+        else if (strcmp(arg, "--rate") == 0)           config->sample_rate = (uint32_t)atoi(value);
+        else if (strcmp(arg, "--workers") == 0)        config->workers = (uint32_t)atoi(value);
+        else if (strcmp(arg, "--isa") == 0)            config->isa = atoi(value);
+        else if (strcmp(arg, "--double") == 0)         config->double_precision = atoi(value) != 0;
+        else if (strcmp(arg, "--realtime") == 0)       config->realtime = atoi(value) != 0;
+        else if (strcmp(arg, "--seed") == 0)           config->seed = (uint32_t)atoi(value);
+        else
+        {
+            fprintf(stderr, "Unknown option %s\n", arg);
+            return false;
+        }
+    }
+
+    return config->block_size > 0 && config->sample_rate > 0;
+}
+
+int main(int argc, char **argv)
+{
+    UphBenchConfig config;
+    if (!uph_bench_parse_args(argc, argv, &config))
+        return 1;
+
+    const UviHostInfo host_info = { (float)config.sample_rate, (int32_t)config.block_size, 0 };
+    uvi_set_host_info(&host_info);
+
+    app = new UphApplication;
+    uph_bench_build_project(config);
+
+    // The main thread stands in for the audio callback.
+    UphRealtimeConfig realtime_config{};
+    realtime_config.request_realtime = config.realtime;
+    uph_realtime_configure(&realtime_config);
+    uph_realtime_setup_thread(UphRealtimeRole_Audio, 0);
+
+    uph_engine_initialize(config.workers);
+    if (config.isa >= 0)
+        uph_dsp_select((UphDspIsa)config.isa);
+
+    app->is_song_timeline_playing = true;
+    uph_render_snapshot_publish();
+
+    using clock = std::chrono::steady_clock;
+
+    const uint64_t total_frames = (uint64_t)(config.seconds * config.sample_rate);
+    const uint32_t publish_interval = std::max<uint32_t>(1, config.sample_rate / 60);
+    std::vector<float> output(config.block_size * 2);
+    std::vector<uint64_t> block_ns;
+    block_ns.reserve(total_frames / config.block_size + 1);
+
+    uint64_t publish_ns = 0, publish_count = 0;
+    uint64_t frames_since_publish = 0;
+    double checksum = 0.0;
+
+    const auto start = clock::now();
+    for (uint64_t frame = 0; frame < total_frames; frame += config.block_size)
+    {
+        const uint32_t frame_count = (uint32_t)std::min<uint64_t>(config.block_size, total_frames - frame);
+        memset(output.data(), 0, frame_count * 2 * sizeof(float));
+
+        const auto block_start = clock::now();
+        uph_realtime_flush_denormals();
+        uph_engine_render(output.data(), frame_count, (float)config.sample_rate);
+        block_ns.push_back((uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - block_start).count());
+
+        checksum += output[0] + output[frame_count * 2 - 1];
+
+        // Stand in for the UI thread publishing at 60 Hz.
+        frames_since_publish += frame_count;
+        if (frames_since_publish >= publish_interval)
+        {
+            frames_since_publish = 0;
+            const auto publish_start = clock::now();
+            uph_render_snapshot_publish();
+            publish_ns += (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - publish_start).count();
+            ++publish_count;
+        }
+    }
+    const double wall_seconds = std::chrono::duration<double>(clock::now() - start).count();
+
+    uint64_t render_ns = 0;
+    for (uint64_t ns : block_ns)
+        render_ns += ns;
+
+    const size_t blocks = block_ns.size();
+    std::vector<uint64_t> sorted = block_ns;
+    std::sort(sorted.begin(), sorted.end());
+    auto percentile = [&](double p) -> uint64_t
+    {
+        return sorted.empty() ? 0 : sorted[std::min(sorted.size() - 1, (size_t)(p * sorted.size()))];
+    };
+
+    const uint32_t track_count = config.tracks + config.sample_tracks + config.idle_tracks;
+    const uint32_t sleeping = (uint32_t)std::count_if(app->project.tracks.begin(), app->project.tracks.end(),
+        [](const UphTrack &track) { return track.is_sleeping; });
+    const double track_blocks = (double)blocks * std::max<uint32_t>(1, track_count);
+
+    printf("{");
+    printf("\"tracks\":%u,\"patterns\":%u,\"notes\":%u,", config.tracks, config.patterns, config.notes);
+    printf("\"sample_tracks\":%u,\"sample_seconds\":%.3f,", config.sample_tracks, config.sample_seconds);
+    printf("\"stretch\":%.3f,\"interpolation\":\"%s\",", config.stretch, uph_interpolation_name(config.interpolation));
+    printf("\"idle_tracks\":%u,\"sleeping_tracks\":%u,", config.idle_tracks, sleeping);
+    printf("\"seconds\":%.3f,\"block_size\":%u,\"sample_rate\":%u,", config.seconds, config.block_size, config.sample_rate);
+    printf("\"workers\":%u,\"isa\":\"%s\",", config.workers, uph_dsp_kernels()->name);
+    printf("\"precision\":\"%s\",", config.double_precision ? "double" : "float");
+    UphRealtimeThreadInfo audio_thread{};
+    uph_realtime_threads(&audio_thread, 1);
+    printf("\"realtime\":%s,\"flushes_denormals\":%s,",
+        audio_thread.scheduling == UphRealtimeScheduling_Realtime ? "true" : "false",
+        audio_thread.flushes_denormals ? "true" : "false");
+    printf("\"blocks\":%zu,\"wall_seconds\":%.6f,", blocks, wall_seconds);
+    printf("\"blocks_per_sec\":%.1f,", blocks / std::max(wall_seconds, 1e-9));
+    printf("\"realtime_factor\":%.2f,", config.seconds / std::max(wall_seconds, 1e-9));
+    printf("\"ns_per_track_block\":%.1f,", render_ns / track_blocks);
+    printf("\"block_p50_ns\":%llu,\"block_p99_ns\":%llu,\"block_max_ns\":%llu,",
+        (unsigned long long)percentile(0.50), (unsigned long long)percentile(0.99),
+        (unsigned long long)(sorted.empty() ? 0 : sorted.back()));
+    printf("\"publish_avg_ns\":%.1f,", publish_count ? (double)publish_ns / publish_count : 0.0);
+    printf("\"peak_rss_kb\":%llu,", (unsigned long long)uph_bench_peak_rss_kb());
+    printf("\"checksum\":%.6f", checksum);
+    printf("}\n");
+
+    uph_engine_shutdown();
+    uph_render_snapshot_shutdown();
+    uph_bench_destroy_project();
+    delete app;
+    return 0;
+}
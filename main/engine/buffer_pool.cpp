@@ -0,0 +1,78 @@
+#include "buffer_pool.h"
+
+#include <algorithm>
+#include <cstring>
+#include <new>
+
+struct UphBufferPool
+{
+    unsigned char *storage;
+    uint32_t channel_count;
+    uint32_t frame_capacity;
+    size_t channel_stride;  // bytes, room for frame_capacity doubles
+};
+
+UphBufferPool *uph_buffer_pool_create(uint32_t channel_count, uint32_t frame_capacity)
+{
+    UphBufferPool *pool = new UphBufferPool;
+    pool->channel_count = channel_count;
+    pool->frame_capacity = frame_capacity;
+    pool->channel_stride = (frame_capacity * sizeof(double) + UPH_BUFFER_POOL_ALIGNMENT - 1) / UPH_BUFFER_POOL_ALIGNMENT * UPH_BUFFER_POOL_ALIGNMENT;
+
+    // Inputs and outputs share one arena, inputs first.
+    const size_t size = pool->channel_stride * channel_count * 2;
+    pool->storage = (unsigned char*)::operator new(size, std::align_val_t(UPH_BUFFER_POOL_ALIGNMENT));
+    memset(pool->storage, 0, size);
+
+    return pool;
+}
+
+void uph_buffer_pool_destroy(UphBufferPool *pool)
+{
+    if (!pool)
+        return;
+    ::operator delete(pool->storage, std::align_val_t(UPH_BUFFER_POOL_ALIGNMENT));
+    delete pool;
+}
+
+template <typename T>
+static void uph_buffer_pool_bind_channels(
+    UphBufferPool *pool,
+    uint32_t *num_inputs, uint32_t *num_outputs, uint32_t frame_count,
+    T **inputs, T **outputs
+)
+{
+    *num_inputs = std::min(*num_inputs, pool->channel_count);
+    *num_outputs = std::min(*num_outputs, pool->channel_count);
+    frame_count = std::min(frame_count, pool->frame_capacity);
+
+    unsigned char *input_base = pool->storage;
+    unsigned char *output_base = pool->storage + pool->channel_stride * pool->channel_count;
+
+    for (uint32_t i = 0; i < *num_inputs; ++i)
+    {
+        inputs[i] = (T*)(input_base + pool->channel_stride * i);
+        memset(inputs[i], 0, frame_count * sizeof(T));
+    }
+
+    for (uint32_t i = 0; i < *num_outputs; ++i)
+        outputs[i] = (T*)(output_base + pool->channel_stride * i);
+}
+
+void uph_buffer_pool_bind(
+    UphBufferPool *pool,
+    uint32_t *num_inputs, uint32_t *num_outputs, uint32_t frame_count,
+    float **inputs, float **outputs
+)
+{
+    uph_buffer_pool_bind_channels(pool, num_inputs, num_outputs, frame_count, inputs, outputs);
+}
+
+void uph_buffer_pool_bind_double(
+    UphBufferPool *pool,
+    uint32_t *num_inputs, uint32_t *num_outputs, uint32_t frame_count,
+    double **inputs, double **outputs
+)
+{
+    uph_buffer_pool_bind_channels(pool, num_inputs, num_outputs, frame_count, inputs, outputs);
+}
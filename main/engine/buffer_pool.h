@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstdint>
+
+// Cache-aligned plugin scratch channels, one pool per render participant.
+// Only the channels a plugin actually declares are handed out, and only
+// its inputs are cleared, so a stereo synth touches a few KB per block
+// instead of the whole channel array.
+
+// Bytes every channel starts on, a cache line.
+#define UPH_BUFFER_POOL_ALIGNMENT 64
+
+struct UphBufferPool;
+
+UphBufferPool *uph_buffer_pool_create(uint32_t channel_count, uint32_t frame_capacity);
+void uph_buffer_pool_destroy(UphBufferPool *pool);
+
+// Clamps both counts to the pool size and writes them back, then fills
+// inputs[0, *num_inputs) with silent channels and outputs[0, *num_outputs)
+// with scratch channels.
+void uph_buffer_pool_bind(
+    UphBufferPool *pool,
+    uint32_t *num_inputs, uint32_t *num_outputs, uint32_t frame_count,
+    float **inputs, float **outputs
+);
+
+// Same channels seen as doubles, for plugins rendering in double precision.
+void uph_buffer_pool_bind_double(
+    UphBufferPool *pool,
+    uint32_t *num_inputs, uint32_t *num_outputs, uint32_t frame_count,
+    double **inputs, double **outputs
+);
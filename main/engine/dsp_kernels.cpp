@@ -0,0 +1,450 @@
+#include "dsp_kernels.h"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(_M_X64) || defined(__x86_64__)
+#define UPH_DSP_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#define UPH_TARGET_AVX2
+#define UPH_TARGET_AVX512
+#else
+#include <cpuid.h>
+#define UPH_TARGET_AVX2   __attribute__((target("avx2")))
+#define UPH_TARGET_AVX512 __attribute__((target("avx512f")))
+#endif
+#endif
+
+// --- Scalar reference ---
+
+static float uph_dsp_accumulate_peak_scalar(float *dst, const float *src, uint32_t count, float gain)
+{
+    float peak = 0.0f;
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        const float v = src[i] * gain;
+        dst[i] += v;
+        peak = std::max<float>(peak, fabsf(v));
+    }
+    return peak;
+}
+
+static void uph_dsp_interleave_add_scalar(float *output, const float *left, const float *right, uint32_t count, float gain)
+{
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        output[i * 2]     += left[i] * gain;
+        output[i * 2 + 1] += right[i] * gain;
+    }
+}
+
+static void uph_dsp_min_max_scalar(const float *src, uint32_t count, float *min, float *max)
+{
+    float lo = src[0], hi = src[0];
+    for (uint32_t i = 1; i < count; ++i)
+    {
+        lo = std::min<float>(lo, src[i]);
+        hi = std::max<float>(hi, src[i]);
+    }
+    *min = lo;
+    *max = hi;
+}
+
+static void uph_dsp_convolve_stereo_scalar(const float *frames, const float *taps, const float *deltas, float frac,
+    uint32_t tap_count, float *left, float *right)
+{
+    float l = 0.0f, r = 0.0f;
+    for (uint32_t i = 0; i < tap_count * 2; i += 2)
+    {
+        l += frames[i]     * (taps[i]     + frac * deltas[i]);
+        r += frames[i + 1] * (taps[i + 1] + frac * deltas[i + 1]);
+    }
+    *left = l;
+    *right = r;
+}
+
+#if UPH_DSP_X86
+
+// --- SSE2, baseline on x64 ---
+
+static inline float uph_dsp_hmax_sse(__m128 v)
+{
+    v = _mm_max_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1)));
+    v = _mm_max_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 0, 3, 2)));
+    return _mm_cvtss_f32(v);
+}
+
+static inline float uph_dsp_hmin_sse(__m128 v)
+{
+    v = _mm_min_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1)));
+    v = _mm_min_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 0, 3, 2)));
+    return _mm_cvtss_f32(v);
+}
+
+static float uph_dsp_accumulate_peak_sse2(float *dst, const float *src, uint32_t count, float gain)
+{
+    const __m128 g = _mm_set1_ps(gain);
+    const __m128 abs_mask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+    __m128 peak = _mm_setzero_ps();
+
+    uint32_t i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        const __m128 v = _mm_mul_ps(_mm_loadu_ps(src + i), g);
+        _mm_storeu_ps(dst + i, _mm_add_ps(_mm_loadu_ps(dst + i), v));
+        peak = _mm_max_ps(peak, _mm_and_ps(v, abs_mask));
+    }
+
+    const float tail = uph_dsp_accumulate_peak_scalar(dst + i, src + i, count - i, gain);
+    return std::max<float>(uph_dsp_hmax_sse(peak), tail);
+}
+
+static void uph_dsp_interleave_add_sse2(float *output, const float *left, const float *right, uint32_t count, float gain)
+{
+    const __m128 g = _mm_set1_ps(gain);
+
+    uint32_t i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        const __m128 l = _mm_mul_ps(_mm_loadu_ps(left + i), g);
+        const __m128 r = _mm_mul_ps(_mm_loadu_ps(right + i), g);
+        float *out = output + i * 2;
+        _mm_storeu_ps(out,     _mm_add_ps(_mm_loadu_ps(out),     _mm_unpacklo_ps(l, r)));
+        _mm_storeu_ps(out + 4, _mm_add_ps(_mm_loadu_ps(out + 4), _mm_unpackhi_ps(l, r)));
+    }
+
+    uph_dsp_interleave_add_scalar(output + i * 2, left + i, right + i, count - i, gain);
+}
+
+static void uph_dsp_min_max_sse2(const float *src, uint32_t count, float *min, float *max)
+{
+    if (count < 4)
+        return uph_dsp_min_max_scalar(src, count, min, max);
+
+    __m128 lo = _mm_loadu_ps(src), hi = lo;
+
+    uint32_t i = 4;
+    for (; i + 4 <= count; i += 4)
+    {
+        const __m128 v = _mm_loadu_ps(src + i);
+        lo = _mm_min_ps(lo, v);
+        hi = _mm_max_ps(hi, v);
+    }
+
+    float tail_lo = uph_dsp_hmin_sse(lo), tail_hi = uph_dsp_hmax_sse(hi);
+    for (; i < count; ++i)
+    {
+        tail_lo = std::min<float>(tail_lo, src[i]);
+        tail_hi = std::max<float>(tail_hi, src[i]);
+    }
+    *min = tail_lo;
+    *max = tail_hi;
+}
+
+// Lanes alternate left and right.
+static inline void uph_dsp_store_stereo_sse(__m128 v, float *left, float *right)
+{
+    v = _mm_add_ps(v, _mm_movehl_ps(v, v));
+    *left = _mm_cvtss_f32(v);
+    *right = _mm_cvtss_f32(_mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 1, 1, 1)));
+}
+
+static void uph_dsp_convolve_stereo_sse2(const float *frames, const float *taps, const float *deltas, float frac,
+    uint32_t tap_count, float *left, float *right)
+{
+    const __m128 f = _mm_set1_ps(frac);
+    __m128 acc0 = _mm_setzero_ps(), acc1 = _mm_setzero_ps();
+
+    for (uint32_t i = 0; i < tap_count * 2; i += 8)
+    {
+        const __m128 c0 = _mm_add_ps(_mm_loadu_ps(taps + i),     _mm_mul_ps(f, _mm_loadu_ps(deltas + i)));
+        const __m128 c1 = _mm_add_ps(_mm_loadu_ps(taps + i + 4), _mm_mul_ps(f, _mm_loadu_ps(deltas + i + 4)));
+        acc0 = _mm_add_ps(acc0, _mm_mul_ps(_mm_loadu_ps(frames + i),     c0));
+        acc1 = _mm_add_ps(acc1, _mm_mul_ps(_mm_loadu_ps(frames + i + 4), c1));
+    }
+
+    uph_dsp_store_stereo_sse(_mm_add_ps(acc0, acc1), left, right);
+}
+
+// --- AVX2 ---
+// Every wide kernel ends with vzeroupper, the plugins we call next are
+// mostly SSE code and would otherwise pay the transition penalty.
+
+UPH_TARGET_AVX2 static inline __m128 uph_dsp_fold_max_avx(__m256 v)
+{
+    return _mm_max_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+}
+
+UPH_TARGET_AVX2 static inline __m128 uph_dsp_fold_min_avx(__m256 v)
+{
+    return _mm_min_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+}
+
+UPH_TARGET_AVX2 static float uph_dsp_accumulate_peak_avx2(float *dst, const float *src, uint32_t count, float gain)
+{
+    const __m256 g = _mm256_set1_ps(gain);
+    const __m256 abs_mask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7FFFFFFF));
+    __m256 peak = _mm256_setzero_ps();
+
+    uint32_t i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        const __m256 v = _mm256_mul_ps(_mm256_loadu_ps(src + i), g);
+        _mm256_storeu_ps(dst + i, _mm256_add_ps(_mm256_loadu_ps(dst + i), v));
+        peak = _mm256_max_ps(peak, _mm256_and_ps(v, abs_mask));
+    }
+
+    const float vector_peak = uph_dsp_hmax_sse(uph_dsp_fold_max_avx(peak));
+    _mm256_zeroupper();
+
+    const float tail = uph_dsp_accumulate_peak_scalar(dst + i, src + i, count - i, gain);
+    return std::max<float>(vector_peak, tail);
+}
+
+UPH_TARGET_AVX2 static void uph_dsp_interleave_add_avx2(float *output, const float *left, const float *right, uint32_t count, float gain)
+{
+    const __m256 g = _mm256_set1_ps(gain);
+
+    uint32_t i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        const __m256 l = _mm256_mul_ps(_mm256_loadu_ps(left + i), g);
+        const __m256 r = _mm256_mul_ps(_mm256_loadu_ps(right + i), g);
+
+        // unpack works per 128-bit lane, permute the halves back in order.
+        const __m256 lo = _mm256_unpacklo_ps(l, r);
+        const __m256 hi = _mm256_unpackhi_ps(l, r);
+        const __m256 first  = _mm256_permute2f128_ps(lo, hi, 0x20);
+        const __m256 second = _mm256_permute2f128_ps(lo, hi, 0x31);
+
+        float *out = output + i * 2;
+        _mm256_storeu_ps(out,     _mm256_add_ps(_mm256_loadu_ps(out),     first));
+        _mm256_storeu_ps(out + 8, _mm256_add_ps(_mm256_loadu_ps(out + 8), second));
+    }
+
+    _mm256_zeroupper();
+
+    uph_dsp_interleave_add_scalar(output + i * 2, left + i, right + i, count - i, gain);
+}
+
+UPH_TARGET_AVX2 static void uph_dsp_min_max_avx2(const float *src, uint32_t count, float *min, float *max)
+{
+    if (count < 8)
+        return uph_dsp_min_max_scalar(src, count, min, max);
+
+    __m256 lo = _mm256_loadu_ps(src), hi = lo;
+
+    uint32_t i = 8;
+    for (; i + 8 <= count; i += 8)
+    {
+        const __m256 v = _mm256_loadu_ps(src + i);
+        lo = _mm256_min_ps(lo, v);
+        hi = _mm256_max_ps(hi, v);
+    }
+
+    float tail_lo = uph_dsp_hmin_sse(uph_dsp_fold_min_avx(lo));
+    float tail_hi = uph_dsp_hmax_sse(uph_dsp_fold_max_avx(hi));
+    _mm256_zeroupper();
+    for (; i < count; ++i)
+    {
+        tail_lo = std::min<float>(tail_lo, src[i]);
+        tail_hi = std::max<float>(tail_hi, src[i]);
+    }
+    *min = tail_lo;
+    *max = tail_hi;
+}
+
+UPH_TARGET_AVX2 static void uph_dsp_convolve_stereo_avx2(const float *frames, const float *taps, const float *deltas, float frac,
+    uint32_t tap_count, float *left, float *right)
+{
+    const __m256 f = _mm256_set1_ps(frac);
+    __m256 acc0 = _mm256_setzero_ps(), acc1 = _mm256_setzero_ps();
+
+    for (uint32_t i = 0; i < tap_count * 2; i += 16)
+    {
+        const __m256 c0 = _mm256_add_ps(_mm256_loadu_ps(taps + i),     _mm256_mul_ps(f, _mm256_loadu_ps(deltas + i)));
+        const __m256 c1 = _mm256_add_ps(_mm256_loadu_ps(taps + i + 8), _mm256_mul_ps(f, _mm256_loadu_ps(deltas + i + 8)));
+        acc0 = _mm256_add_ps(acc0, _mm256_mul_ps(_mm256_loadu_ps(frames + i),     c0));
+        acc1 = _mm256_add_ps(acc1, _mm256_mul_ps(_mm256_loadu_ps(frames + i + 8), c1));
+    }
+
+    const __m256 acc = _mm256_add_ps(acc0, acc1);
+    const __m128 sum = _mm_add_ps(_mm256_castps256_ps128(acc), _mm256_extractf128_ps(acc, 1));
+    _mm256_zeroupper();
+    uph_dsp_store_stereo_sse(sum, left, right);
+}
+
+// --- AVX-512 ---
+
+UPH_TARGET_AVX512 static float uph_dsp_accumulate_peak_avx512(float *dst, const float *src, uint32_t count, float gain)
+{
+    const __m512 g = _mm512_set1_ps(gain);
+    __m512 peak = _mm512_setzero_ps();
+
+    uint32_t i = 0;
+    for (; i + 16 <= count; i += 16)
+    {
+        const __m512 v = _mm512_mul_ps(_mm512_loadu_ps(src + i), g);
+        _mm512_storeu_ps(dst + i, _mm512_add_ps(_mm512_loadu_ps(dst + i), v));
+        peak = _mm512_max_ps(peak, _mm512_abs_ps(v));
+    }
+
+    const float vector_peak = _mm512_reduce_max_ps(peak);
+    _mm256_zeroupper();
+
+    const float tail = uph_dsp_accumulate_peak_scalar(dst + i, src + i, count - i, gain);
+    return std::max<float>(vector_peak, tail);
+}
+
+UPH_TARGET_AVX512 static void uph_dsp_interleave_add_avx512(float *output, const float *left, const float *right, uint32_t count, float gain)
+{
+    const __m512 g = _mm512_set1_ps(gain);
+    const __m512i first_index  = _mm512_setr_epi32(0, 16, 1, 17, 2, 18, 3, 19, 4, 20, 5, 21, 6, 22, 7, 23);
+    const __m512i second_index = _mm512_setr_epi32(8, 24, 9, 25, 10, 26, 11, 27, 12, 28, 13, 29, 14, 30, 15, 31);
+
+    uint32_t i = 0;
+    for (; i + 16 <= count; i += 16)
+    {
+        const __m512 l = _mm512_mul_ps(_mm512_loadu_ps(left + i), g);
+        const __m512 r = _mm512_mul_ps(_mm512_loadu_ps(right + i), g);
+
+        float *out = output + i * 2;
+        _mm512_storeu_ps(out,      _mm512_add_ps(_mm512_loadu_ps(out),      _mm512_permutex2var_ps(l, first_index, r)));
+        _mm512_storeu_ps(out + 16, _mm512_add_ps(_mm512_loadu_ps(out + 16), _mm512_permutex2var_ps(l, second_index, r)));
+    }
+
+    _mm256_zeroupper();
+
+    uph_dsp_interleave_add_scalar(output + i * 2, left + i, right + i, count - i, gain);
+}
+
+UPH_TARGET_AVX512 static void uph_dsp_min_max_avx512(const float *src, uint32_t count, float *min, float *max)
+{
+    if (count < 16)
+        return uph_dsp_min_max_scalar(src, count, min, max);
+
+    __m512 lo = _mm512_loadu_ps(src), hi = lo;
+
+    uint32_t i = 16;
+    for (; i + 16 <= count; i += 16)
+    {
+        const __m512 v = _mm512_loadu_ps(src + i);
+        lo = _mm512_min_ps(lo, v);
+        hi = _mm512_max_ps(hi, v);
+    }
+
+    float tail_lo = _mm512_reduce_min_ps(lo), tail_hi = _mm512_reduce_max_ps(hi);
+    _mm256_zeroupper();
+    for (; i < count; ++i)
+    {
+        tail_lo = std::min<float>(tail_lo, src[i]);
+        tail_hi = std::max<float>(tail_hi, src[i]);
+    }
+    *min = tail_lo;
+    *max = tail_hi;
+}
+
+UPH_TARGET_AVX512 static void uph_dsp_convolve_stereo_avx512(const float *frames, const float *taps, const float *deltas, float frac,
+    uint32_t tap_count, float *left, float *right)
+{
+    const __m512 f = _mm512_set1_ps(frac);
+    __m512 acc = _mm512_setzero_ps();
+
+    for (uint32_t i = 0; i < tap_count * 2; i += 16)
+    {
+        const __m512 c = _mm512_add_ps(_mm512_loadu_ps(taps + i), _mm512_mul_ps(f, _mm512_loadu_ps(deltas + i)));
+        acc = _mm512_add_ps(acc, _mm512_mul_ps(_mm512_loadu_ps(frames + i), c));
+    }
+
+    // extractf32x8 needs AVX-512DQ, the 64-bit lane version is plain AVX-512F.
+    const __m256 high = _mm256_castpd_ps(_mm512_extractf64x4_pd(_mm512_castps_pd(acc), 1));
+    const __m256 half = _mm256_add_ps(_mm512_castps512_ps256(acc), high);
+    const __m128 sum = _mm_add_ps(_mm256_castps256_ps128(half), _mm256_extractf128_ps(half, 1));
+    _mm256_zeroupper();
+    uph_dsp_store_stereo_sse(sum, left, right);
+}
+
+#endif
+
+static const UphDspKernels dsp_kernel_table[] =
+{
+    { UphDspIsa_Scalar, "Scalar", uph_dsp_accumulate_peak_scalar, uph_dsp_interleave_add_scalar, uph_dsp_min_max_scalar, uph_dsp_convolve_stereo_scalar },
+#if UPH_DSP_X86
+    { UphDspIsa_Sse2,   "SSE2",    uph_dsp_accumulate_peak_sse2,   uph_dsp_interleave_add_sse2,   uph_dsp_min_max_sse2,   uph_dsp_convolve_stereo_sse2 },
+    { UphDspIsa_Avx2,   "AVX2",    uph_dsp_accumulate_peak_avx2,   uph_dsp_interleave_add_avx2,   uph_dsp_min_max_avx2,   uph_dsp_convolve_stereo_avx2 },
+    { UphDspIsa_Avx512, "AVX-512", uph_dsp_accumulate_peak_avx512, uph_dsp_interleave_add_avx512, uph_dsp_min_max_avx512, uph_dsp_convolve_stereo_avx512 },
+#endif
+};
+
+static const UphDspKernels *dsp_kernels = &dsp_kernel_table[0];
+
+#if UPH_DSP_X86
+static void uph_dsp_cpuid(uint32_t leaf, uint32_t subleaf, uint32_t regs[4])
+{
+#if defined(_MSC_VER) && !defined(__clang__)
+    __cpuidex((int*)regs, (int)leaf, (int)subleaf);
+#else
+    __cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+}
+
+static uint64_t uph_dsp_xgetbv(void)
+{
+#if defined(_MSC_VER) && !defined(__clang__)
+    return _xgetbv(0);
+#else
+    uint32_t eax, edx;
+    __asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+    return ((uint64_t)edx << 32) | eax;
+#endif
+}
+#endif
+
+UphDspIsa uph_dsp_detect_isa(void)
+{
+#if UPH_DSP_X86
+    uint32_t regs[4];
+    uph_dsp_cpuid(0, 0, regs);
+    const uint32_t max_leaf = regs[0];
+
+    uph_dsp_cpuid(1, 0, regs);
+    const bool has_osxsave = (regs[2] >> 27) & 1;
+    const bool has_avx = (regs[2] >> 28) & 1;
+    if (!has_osxsave || !has_avx || max_leaf < 7)
+        return UphDspIsa_Sse2;
+
+    // The OS has to save the wider registers too, not just the CPU have them.
+    const uint64_t xcr0 = uph_dsp_xgetbv();
+    const bool os_avx = (xcr0 & 0x6) == 0x6;
+    const bool os_avx512 = (xcr0 & 0xE6) == 0xE6;
+
+    uph_dsp_cpuid(7, 0, regs);
+    const bool has_avx2 = (regs[1] >> 5) & 1;
+    const bool has_avx512f = (regs[1] >> 16) & 1;
+
+    if (has_avx512f && os_avx512)
+        return UphDspIsa_Avx512;
+    if (has_avx2 && os_avx)
+        return UphDspIsa_Avx2;
+    return UphDspIsa_Sse2;
+#else
+    return UphDspIsa_Scalar;
+#endif
+}
+
+void uph_dsp_select(UphDspIsa isa)
+{
+    isa = std::min(isa, uph_dsp_detect_isa());
+    for (const UphDspKernels &kernels : dsp_kernel_table)
+    {
+        if (kernels.isa == isa)
+            dsp_kernels = &kernels;
+    }
+}
+
+const UphDspKernels *uph_dsp_kernels(void)
+{
+    return dsp_kernels;
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstdint>
+
+// Mixing kernels with scalar reference versions and SSE2/AVX2/AVX-512
+// variants, the best one the CPU supports is picked at startup.
+
+enum UphDspIsa : uint8_t
+{
+    UphDspIsa_Scalar,
+    UphDspIsa_Sse2,
+    UphDspIsa_Avx2,
+    UphDspIsa_Avx512
+};
+
+struct UphDspKernels
+{
+    UphDspIsa isa;
+    const char *name;
+
+    // dst[i] += src[i] * gain, returns max |src[i] * gain|.
+    float (*accumulate_peak)(float *dst, const float *src, uint32_t count, float gain);
+
+    // output[2i] += left[i] * gain, output[2i + 1] += right[i] * gain.
+    void (*interleave_add)(float *output, const float *left, const float *right, uint32_t count, float gain);
+
+    // Smallest and largest value of src[0, count), count must be > 0.
+    void (*min_max)(const float *src, uint32_t count, float *min, float *max);
+
+    // One FIR output of interleaved stereo frames[0, tap_count) with the
+    // coefficients taps + frac * deltas. Both hold every coefficient twice,
+    // once per channel, and tap_count is a multiple of 8.
+    void (*convolve_stereo)(const float *frames, const float *taps, const float *deltas, float frac,
+        uint32_t tap_count, float *left, float *right);
+};
+
+UphDspIsa uph_dsp_detect_isa(void);
+
+// Selects the kernels for isa, clamped to what the CPU supports.
+void uph_dsp_select(UphDspIsa isa);
+const UphDspKernels *uph_dsp_kernels(void);
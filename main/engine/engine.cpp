@@ -0,0 +1,910 @@
+#include "engine.h"
+#include "buffer_pool.h"
+#include "dsp_kernels.h"
+#include "interpolation.h"
+#include "profiler.h"
+#include "render_snapshot.h"
+#include "transport.h"
+#include "worker_pool.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <memory>
+#include <thread>
+#include <vector>
+
+constexpr float PI = 3.14159265358979323846f;
+constexpr float HALF_PI = PI * 0.5f;
+
+struct UphEngineBlock
+{
+    const UphRenderSnapshot *snapshot;
+    float sample_rate;
+    uint32_t frame_count;
+    double frames_per_beat;
+    double prev_beat, new_beat;
+    double ahead_prev_beat, ahead_new_beat;     // compensation frames later
+    bool schedule_song;
+    bool schedule_editor;
+    bool render_samples;
+    bool is_exporting;
+    bool is_seek;
+};
+
+struct UphEngine
+{
+    // One per pool participant so tracks rendered in parallel never share
+    // scratch channels.
+    std::vector<UphBufferPool*> buffer_pools;
+
+    // Non-interleaved master bus, only touched by the audio thread. The
+    // double one is used instead in double precision projects.
+    alignas(64) float bus[2][UPH_ENGINE_BLOCK_SIZE];
+    alignas(64) double bus64[2][UPH_ENGINE_BLOCK_SIZE];
+};
+
+static UphEngine engine;
+
+// Turns beat positions into sample offsets within the block, nudging events
+// that land on the same sample apart so none of them get dropped.
+struct UphNoteQueue
+{
+    UviPlugin *plugin;
+    double block_beat, frames_per_beat;
+    int frame_count;
+
+    int note_on_micro_offset = 0;
+    int note_off_micro_offset = 0;
+    int last_note_on_sample = -1;
+    int last_note_off_sample = -1;
+
+    // Where the plugin renders, null when the track isn't audible. The
+    // block is rendered in pieces whenever the plugin's event buffer fills.
+    // Plugins rendering in double precision get the 64 bit channels instead.
+    float **inputs = nullptr;
+    float **outputs = nullptr;
+    double **inputs64 = nullptr;
+    double **outputs64 = nullptr;
+    uint32_t num_inputs = 0, num_outputs = 0;
+
+    // Aligned channels the two mixed outputs render into when a piece
+    // doesn't start on a cache line, copied into place after.
+    float *scratch[2] = {};
+    double *scratch64[2] = {};
+    int rendered = 0;
+    uint64_t plugin_ns = 0;
+    bool is_silent = true;
+};
+
+// Channels for the piece starting at queue.rendered. Plugins are promised
+// cache aligned channels, a piece starting off a line gets the scratch for
+// the mixed outputs and the others from their start, as those are silent
+// inputs and outputs nobody reads. False when the scratch needs copying.
+template <typename T>
+static bool uph_note_queue_channels(const UphNoteQueue &queue, T *const *source_inputs, T *const *source_outputs,
+    T *const *scratch, int frame_count, T **inputs, T **outputs)
+{
+    const bool is_aligned = (queue.rendered * sizeof(T)) % UPH_BUFFER_POOL_ALIGNMENT == 0;
+    const int offset = is_aligned ? queue.rendered : 0;
+    for (uint32_t c = 0; c < queue.num_inputs; ++c)
+        inputs[c] = source_inputs[c] + offset;
+    for (uint32_t c = 0; c < queue.num_outputs; ++c)
+        outputs[c] = source_outputs[c] + offset;
+
+    if (!is_aligned)
+    {
+        for (uint32_t c = 0; c < 2; ++c)
+        {
+            outputs[c] = scratch[c];
+            memset(outputs[c], 0, frame_count * sizeof(T));
+        }
+    }
+    return is_aligned;
+}
+
+template <typename T>
+static void uph_note_queue_copy_scratch(const UphNoteQueue &queue, T *const *source_outputs, T *const *scratch, int frame_count)
+{
+    for (uint32_t c = 0; c < 2; ++c)
+        std::copy(scratch[c], scratch[c] + frame_count, source_outputs[c] + queue.rendered);
+}
+
+static void uph_note_queue_render(UphNoteQueue &queue, int end)
+{
+    if ((!queue.outputs && !queue.outputs64) || end <= queue.rendered)
+        return;
+
+    // The mixed outputs are the track buffers, which may hold an older
+    // block. Cleared here so a sleeping plugin doesn't pay for it.
+    if (queue.rendered == 0)
+    {
+        for (uint32_t c = 0; c < 2; ++c)
+        {
+            if (queue.outputs64)
+                memset(queue.outputs64[c], 0, queue.frame_count * sizeof(double));
+            else
+                memset(queue.outputs[c], 0, queue.frame_count * sizeof(float));
+        }
+    }
+
+    UviPlugin *plugin = queue.plugin;
+    const int frame_count = end - queue.rendered;
+    const uint64_t plugin_start = uph_profiler_now_ns();
+    if (queue.outputs64)
+    {
+        double *inputs[UPH_ENGINE_MAX_CHANNELS];
+        double *outputs[UPH_ENGINE_MAX_CHANNELS];
+        const bool is_aligned = uph_note_queue_channels(queue, queue.inputs64, queue.outputs64, queue.scratch64, frame_count, inputs, outputs);
+        plugin->process_double(plugin, inputs, outputs, frame_count);
+        if (!is_aligned)
+            uph_note_queue_copy_scratch(queue, queue.outputs64, queue.scratch64, frame_count);
+    }
+    else
+    {
+        float *inputs[UPH_ENGINE_MAX_CHANNELS];
+        float *outputs[UPH_ENGINE_MAX_CHANNELS];
+        const bool is_aligned = uph_note_queue_channels(queue, queue.inputs, queue.outputs, queue.scratch, frame_count, inputs, outputs);
+        plugin->process(plugin, inputs, outputs, frame_count);
+        if (!is_aligned)
+            uph_note_queue_copy_scratch(queue, queue.outputs, queue.scratch, frame_count);
+    }
+    queue.plugin_ns += uph_profiler_now_ns() - plugin_start;
+    queue.is_silent = queue.is_silent && plugin->is_silent;
+    queue.rendered = end;
+}
+
+// Renders up to the event about to be queued, and at least far enough to
+// deliver the earliest queued one, so a full buffer never drops notes.
+static void uph_note_queue_flush(UphNoteQueue &queue, int sample_offset)
+{
+    const UviEventBuffer &events = queue.plugin->events;
+    const int first_due = queue.rendered + events.events[0].frame + 1;
+    uph_note_queue_render(queue, std::min(std::max(sample_offset, first_due), queue.frame_count));
+}
+
+// Beat to frame conversions can land a hair below a whole frame, don't let
+// the floor push such events one frame early.
+static constexpr double k_frame_epsilon = 1e-6;
+
+static void uph_note_queue_push(UphNoteQueue &queue, bool note_on, int pitch, int velocity, double event_beat)
+{
+    int sample_offset = (int)std::floor((event_beat - queue.block_beat) * queue.frames_per_beat + k_frame_epsilon);
+    sample_offset = std::clamp(sample_offset, 0, queue.frame_count - 1);
+
+    UviPlugin *plugin = queue.plugin;
+    if (plugin->events.capacity > 0 && plugin->events.count >= plugin->events.capacity)
+        uph_note_queue_flush(queue, sample_offset);
+
+    if (note_on)
+    {
+        if (sample_offset == queue.last_note_on_sample)
+        {
+            queue.note_on_micro_offset++;
+            sample_offset = std::clamp(sample_offset + queue.note_on_micro_offset, 0, queue.frame_count - 1);
+        } else {
+            queue.note_on_micro_offset = 0;
+            queue.last_note_on_sample = sample_offset;
+        }
+        plugin->play_note(plugin, pitch, velocity, std::max(sample_offset - queue.rendered, 0));
+    }
+    else
+    {
+        if (sample_offset == queue.last_note_off_sample)
+        {
+            queue.note_off_micro_offset++;
+            sample_offset = std::clamp(sample_offset + queue.note_off_micro_offset, 0, queue.frame_count - 1);
+        } else {
+            queue.note_off_micro_offset = 0;
+            queue.last_note_off_sample = sample_offset;
+        }
+        plugin->stop_note(plugin, pitch, std::max(sample_offset - queue.rendered, 0));
+    }
+}
+
+// Notes are looked up in pattern-local beats with a little slack, the exact
+// clamped times below decide whether an event really lands in the block.
+static constexpr double k_note_search_margin = 0.02;
+
+static uint32_t uph_render_notes_first_start(const UphRenderNotes &pattern, double beat)
+{
+    auto it = std::lower_bound(pattern.by_start.begin(), pattern.by_start.end(), beat,
+        [&](uint32_t index, double value) { return pattern.notes[index].start < value; });
+    return (uint32_t)(it - pattern.by_start.begin());
+}
+
+static uint32_t uph_render_notes_first_end(const UphRenderNotes &pattern, double beat)
+{
+    auto it = std::lower_bound(pattern.by_end.begin(), pattern.by_end.end(), beat,
+        [&](uint32_t index, double value) { return pattern.notes[index].start + pattern.notes[index].length < value; });
+    return (uint32_t)(it - pattern.by_end.begin());
+}
+
+static void uph_midi_pattern_process_playback_for_block(
+    UphNoteQueue &queue, const UphRenderNotes &pattern,
+    double prev_beat, double new_beat,
+    double start_time = 0.0,
+    double start_offset = 0.0,
+    double length = INT32_MAX
+)
+{
+    auto queue_event = [&](bool note_on, int pitch, int velocity, double event_beat)
+    {
+        uph_note_queue_push(queue, note_on, pitch, velocity, event_beat);
+    };
+
+    const std::vector<UphNote> &notes = pattern.notes;
+    const double instance_end = start_time + length;
+
+    auto note_start_of = [&](const UphNote &note)
+    {
+        const double original_start = note.start + start_time;
+        return std::clamp<double>(original_start - start_offset, start_time, instance_end);
+    };
+
+    auto note_end_unclamped = [&](const UphNote &note)
+    {
+        const double original_end = note.start + start_time + note.length - 0.01;
+        return original_end - start_offset;
+    };
+
+    // Block window in pattern-local beats.
+    const double local_begin = prev_beat - start_time + start_offset;
+    const double local_end = new_beat - start_time + start_offset;
+
+    const bool starts_in_block = start_time >= prev_beat - k_note_search_margin && start_time < new_beat + k_note_search_margin;
+    const bool ends_in_block = instance_end >= prev_beat - k_note_search_margin && instance_end < new_beat + k_note_search_margin;
+
+    // Note offs inside the instance.
+    const uint32_t end_first = uph_render_notes_first_end(pattern, local_begin - k_note_search_margin);
+    const uint32_t end_last = uph_render_notes_first_end(pattern, local_end + k_note_search_margin);
+    for (uint32_t i = end_first; i < end_last; ++i)
+    {
+        const UphNote &note = notes[pattern.by_end[i]];
+        const double note_end_raw = note_end_unclamped(note);
+        if (note_end_raw >= instance_end)
+            continue;
+
+        const double note_start = note_start_of(note);
+        const double note_end = std::max(note_end_raw, 0.0);
+        if (note_end <= note_start)
+            continue;
+
+        if (note_end >= prev_beat && note_end < new_beat)
+            queue_event(false, note.key, 0, note_end);
+    }
+
+    // Notes still sounding when the instance ends are cut at its end.
+    if (ends_in_block)
+    {
+        const double cut = start_offset + length;
+        const uint32_t first = uph_render_notes_first_start(pattern, cut - pattern.max_length - k_note_search_margin);
+        const uint32_t last = uph_render_notes_first_start(pattern, cut + k_note_search_margin);
+        for (uint32_t i = first; i < last; ++i)
+        {
+            const UphNote &note = notes[pattern.by_start[i]];
+            if (note_end_unclamped(note) < instance_end)
+                continue;
+
+            const double note_start = note_start_of(note);
+            if (instance_end <= note_start)
+                continue;
+
+            if (instance_end >= prev_beat && instance_end < new_beat)
+                queue_event(false, note.key, 0, instance_end);
+        }
+    }
+
+    // Note ons, including notes already sounding at start_offset which are
+    // triggered at the start of the instance.
+    uint32_t start_first = uph_render_notes_first_start(pattern, local_begin - k_note_search_margin);
+    if (starts_in_block)
+        start_first = std::min(start_first, uph_render_notes_first_start(pattern, start_offset - pattern.max_length - k_note_search_margin));
+    const uint32_t start_last = uph_render_notes_first_start(pattern, std::min(local_end, start_offset + length) + k_note_search_margin);
+    for (uint32_t i = start_first; i < start_last; ++i)
+    {
+        const UphNote &note = notes[pattern.by_start[i]];
+        const double note_start = note_start_of(note);
+        const double note_end = std::clamp<double>(note_end_unclamped(note), 0.0, instance_end);
+        if (note_end <= note_start)
+            continue;
+
+        if (note_start >= prev_beat && note_start < new_beat)
+            queue_event(true, note.key, note.velocity, note_start);
+    }
+}
+
+// Tracks are scheduled compensation frames ahead of the transport. The
+// window carries on from what the previous block queued, after a seek it
+// reaches back to the transport so events right at the start still play,
+// just late. Returns false for such a jump.
+static bool uph_engine_schedule_window(const UphEngineBlock &block, UphTrackRuntime *runtime, double *begin, double *end)
+{
+    const bool continues = runtime->scheduled_block_end == block.prev_beat;
+    *begin = continues ? runtime->scheduled_beat : block.prev_beat;
+    *end = std::max(*begin, block.ahead_new_beat);
+
+    runtime->scheduled_beat = *end;
+    runtime->scheduled_block_end = block.new_beat;
+    return continues;
+}
+
+// After a jump the plugin may hold keys that no longer sound and miss notes
+// that started before the window. Releases the former and starts the
+// latter, leaving keys that are held and should be alone.
+static void uph_note_queue_chase(UphNoteQueue &queue, const uint8_t (&velocities)[128])
+{
+    const UviPlugin *plugin = queue.plugin;
+    for (int key = 0; key < 128; ++key)
+    {
+        const bool is_active = uvi_plugin_is_note_active(plugin, 0, key);
+        if (is_active && !velocities[key])
+            uph_note_queue_push(queue, false, key, 0, queue.block_beat);
+        else if (!is_active && velocities[key])
+            uph_note_queue_push(queue, true, key, velocities[key], queue.block_beat);
+    }
+}
+
+static void uph_engine_schedule_editor(const UphEngineBlock &block, uint32_t track_index, UphNoteQueue &queue)
+{
+    const UphRenderSnapshot *snapshot = block.snapshot;
+    if (track_index != snapshot->current_track_index || snapshot->current_pattern_index >= snapshot->patterns.size())
+        return;
+
+    const UphRenderNotes &pattern = *snapshot->patterns[snapshot->current_pattern_index].notes;
+
+    double begin, end;
+    if (!uph_engine_schedule_window(block, snapshot->tracks[track_index].runtime.get(), &begin, &end))
+    {
+        uint8_t velocities[128] = {};
+        for (const UphNote &note : pattern.notes)
+        {
+            if (note.start < begin && note.start + note.length > begin)
+                velocities[note.key & 127] = std::max<uint8_t>(note.velocity, 1);
+        }
+        uph_note_queue_chase(queue, velocities);
+    }
+
+    uph_midi_pattern_process_playback_for_block(queue, pattern, begin, end);
+}
+
+static void uph_engine_schedule_song(const UphEngineBlock &block, const UphRenderTrack &track, UphNoteQueue &queue)
+{
+    if (!track.events)
+        return;
+
+    const std::vector<UphTrackEvent> &events = track.events->events;
+    UphTrackRuntime *runtime = track.runtime.get();
+
+    double begin, end;
+    const bool continues = uph_engine_schedule_window(block, runtime, &begin, &end);
+
+    // Playback moves forward block by block, so the cursor left by the
+    // previous block is usually still right. After a seek or a rebuilt
+    // event list, search for it again.
+    uint32_t cursor = runtime->event_cursor;
+    const bool cursor_valid = cursor <= events.size()
+        && (cursor == 0 || events[cursor - 1].beat < begin)
+        && (cursor == events.size() || events[cursor].beat >= begin);
+    if (!cursor_valid)
+    {
+        auto it = std::lower_bound(events.begin(), events.end(), begin,
+            [](const UphTrackEvent &event, double beat) { return event.beat < beat; });
+        cursor = (uint32_t)(it - events.begin());
+    }
+
+    // Replaying everything before the window is linear, but only happens
+    // on a jump.
+    if (!continues)
+    {
+        uint8_t velocities[128] = {};
+        for (uint32_t i = 0; i < cursor; ++i)
+            velocities[events[i].key & 127] = events[i].note_on ? std::max<uint8_t>(events[i].velocity, 1) : 0;
+        uph_note_queue_chase(queue, velocities);
+    }
+
+    for (; cursor < events.size() && events[cursor].beat < end; ++cursor)
+    {
+        const UphTrackEvent &event = events[cursor];
+        uph_note_queue_push(queue, event.note_on, event.key, event.velocity, event.beat);
+    }
+
+    runtime->event_cursor = cursor;
+}
+
+// Sample positions are 32.32 fixed point frames.
+static constexpr double k_position_scale = 4294967296.0;
+
+template <typename T>
+static void uph_engine_render_samples(const UphEngineBlock &block, const UphRenderTrack &track, T *left, T *right)
+{
+    const UphRenderSnapshot *snapshot = block.snapshot;
+    const float sample_rate = block.sample_rate;
+    const double frames_per_beat = block.frames_per_beat;
+    const double prev_beat = block.prev_beat;
+    const UphInterpolation interpolation = block.is_exporting ? snapshot->export_interpolation : track.interpolation;
+
+    for (auto &sample_instance : *track.timeline_blocks)
+    {
+        if (sample_instance.sample_index >= snapshot->samples.size())
+            continue;
+
+        const UphRenderSample &sample = snapshot->samples[sample_instance.sample_index];
+        if (!sample.frames || sample.frame_count == 0)
+            continue;
+
+        float sample_rate_ratio = sample.sample_rate / sample_rate;
+        float playback_speed = sample_rate_ratio / sample_instance.stretch_scale;
+
+        float playback_rate = (playback_speed > 0.0f) ? playback_speed : 1.0f;
+
+        double instance_start_beat = sample_instance.start_time;
+
+        double instance_length_beats = (sample_instance.length > 0.0f)
+            ? sample_instance.length
+            : (sample.frame_count / frames_per_beat) / playback_rate;
+
+        double instance_end_beat = instance_start_beat + instance_length_beats;
+
+        if (instance_end_beat <= prev_beat || instance_start_beat >= block.new_beat)
+            continue;
+
+        int block_start_sample = int(std::round((instance_start_beat - prev_beat) * frames_per_beat));
+        int sample_read_start  = int(std::round(sample_instance.start_offset * frames_per_beat * playback_rate));
+        if (sample_read_start < 0) sample_read_start = 0;
+
+        int write_i = std::max<int>(0, block_start_sample);
+
+        double read_index = (double)sample_read_start + (double)(write_i - block_start_sample) * playback_rate;
+        if (read_index >= (double)sample.frame_count)
+            continue;
+
+        uint64_t available_in_sample = (uint64_t)std::ceil(((double)sample.frame_count - read_index) / playback_rate);
+        int available_in_block = (int)block.frame_count - write_i;
+        int frames_to_copy = (int)std::min<uint64_t>(available_in_sample, (uint64_t)std::max(0, available_in_block));
+        if (frames_to_copy <= 0) continue;
+
+        // The kernels read past either end into the padding, so the window
+        // only has to start inside the sample.
+        const uint32_t channels = (sample.type == UphSampleType_Mono) ? 1 : 2;
+        const uint64_t position = (uint64_t)std::llround(read_index * k_position_scale);
+        const uint64_t step = (uint64_t)std::llround((double)playback_rate * k_position_scale);
+
+        alignas(64) float scratch[2][UPH_ENGINE_BLOCK_SIZE];
+        uph_interpolate(interpolation, sample.frames, channels, position, step, (uint32_t)frames_to_copy, scratch[0], scratch[1]);
+
+        for (int i = 0; i < frames_to_copy; ++i)
+        {
+            left[write_i + i] += scratch[0][i];
+            right[write_i + i] += scratch[1][i];
+        }
+    }
+}
+
+// Plugins are put to sleep once they hold no notes, have nothing queued and
+// stayed below the threshold for a while. Those reporting silence themselves
+// or declaring they make no sound when idle don't need the wait. The
+// selected track stays awake, its editor may make sound of its own.
+static constexpr float k_silence_threshold = 1e-5f;     // -100 dB
+static constexpr double k_sleep_after_seconds = 1.0;
+
+static bool uph_note_queue_is_quiet(const UphNoteQueue &queue)
+{
+    const UphDspKernels *dsp = uph_dsp_kernels();
+    for (uint32_t c = 0; c < 2; ++c)
+    {
+        if (queue.outputs64)
+        {
+            for (int i = 0; i < queue.frame_count; ++i)
+            {
+                if (std::abs(queue.outputs64[c][i]) >= k_silence_threshold)
+                    return false;
+            }
+        }
+        else
+        {
+            float min, max;
+            dsp->min_max(queue.outputs[c], (uint32_t)queue.frame_count, &min, &max);
+            if (std::max(-min, max) >= k_silence_threshold)
+                return false;
+        }
+    }
+    return true;
+}
+
+static void uph_engine_update_sleep(const UphEngineBlock &block, bool is_selected, UphTrackRuntime *runtime, const UphNoteQueue &queue)
+{
+    const UviPlugin *plugin = queue.plugin;
+    const bool is_idle = !is_selected && !uvi_plugin_has_active_notes(plugin) && plugin->events.count == 0;
+    if (!is_idle || !(queue.is_silent || uph_note_queue_is_quiet(queue)))
+    {
+        runtime->quiet_frames = 0;
+        runtime->is_sleeping.store(false, std::memory_order_relaxed);
+        return;
+    }
+
+    const uint32_t sleep_after = (uint32_t)(block.sample_rate * k_sleep_after_seconds);
+    runtime->quiet_frames = std::min(runtime->quiet_frames + block.frame_count, sleep_after);
+    const bool is_sleeping = queue.is_silent || plugin->no_sound_when_idle || runtime->quiet_frames >= sleep_after;
+    runtime->is_sleeping.store(is_sleeping, std::memory_order_relaxed);
+}
+
+static void uph_track_runtime_clear(UphTrackRuntime *runtime, bool is_double, uint32_t frame_count)
+{
+    for (uint32_t c = 0; c < 2; ++c)
+    {
+        if (is_double)
+            memset(runtime->output64[c], 0, frame_count * sizeof(double));
+        else
+            memset(runtime->output[c], 0, frame_count * sizeof(float));
+    }
+}
+
+// Schedules and renders a single track into its runtime buffers, returns
+// the time spent inside the plugin. Runs on any pool participant, so it
+// must only touch state owned by this track.
+static uint64_t uph_engine_process_track(const UphEngineBlock &block, uint32_t track_index, uint32_t worker_index)
+{
+    const UphRenderTrack &track = block.snapshot->tracks[track_index];
+    UphTrackRuntime *runtime = track.runtime.get();
+    const bool is_double = block.snapshot->double_precision;
+    runtime->has_output = false;
+
+    if (track.track_type == UphTrackType_Midi)
+    {
+        // Plugins with more channels than can be bound would write through
+        // pointers they were never given. The loader rejects them already,
+        // this only guards against counts changing afterwards.
+        UviPlugin *plugin = track.plugin;
+        if (!plugin || plugin->num_inputs > UPH_ENGINE_MAX_CHANNELS || plugin->num_outputs > UPH_ENGINE_MAX_CHANNELS)
+            return 0;
+
+        // Inaudible plugins aren't scheduled, or processed once they hold
+        // nothing. Held keys are released first so nothing hangs when they
+        // come back, and coming back counts as a jump, which chases the
+        // notes in progress.
+        if (!track.is_audible)
+        {
+            runtime->scheduled_block_end = -1.0;
+            if (!uvi_plugin_has_active_notes(plugin))
+                return 0;
+            plugin->stop_all_notes(plugin);
+        }
+
+        UphNoteQueue queue{ plugin, block.ahead_prev_beat, block.frames_per_beat, (int)block.frame_count };
+        queue.num_inputs = (uint32_t)std::clamp(plugin->num_inputs, 0, UPH_ENGINE_MAX_CHANNELS);
+        queue.num_outputs = (uint32_t)std::clamp(plugin->num_outputs, 2, UPH_ENGINE_MAX_CHANNELS);
+
+        // The first two outputs are the ones that get mixed, render them
+        // straight into the track buffers. The pool channels they replace
+        // are the scratch for pieces that start off a cache line.
+        const bool renders_double = is_double && plugin->process_double;
+        float *inputs[UPH_ENGINE_MAX_CHANNELS];
+        float *outputs[UPH_ENGINE_MAX_CHANNELS];
+        double *inputs64[UPH_ENGINE_MAX_CHANNELS];
+        double *outputs64[UPH_ENGINE_MAX_CHANNELS];
+        if (renders_double)
+        {
+            uph_buffer_pool_bind_double(engine.buffer_pools[worker_index], &queue.num_inputs, &queue.num_outputs, block.frame_count, inputs64, outputs64);
+            queue.scratch64[0] = outputs64[0];
+            queue.scratch64[1] = outputs64[1];
+            outputs64[0] = runtime->output64[0];
+            outputs64[1] = runtime->output64[1];
+            queue.inputs64 = inputs64;
+            queue.outputs64 = outputs64;
+        }
+        else
+        {
+            uph_buffer_pool_bind(engine.buffer_pools[worker_index], &queue.num_inputs, &queue.num_outputs, block.frame_count, inputs, outputs);
+            queue.scratch[0] = outputs[0];
+            queue.scratch[1] = outputs[1];
+            outputs[0] = runtime->output[0];
+            outputs[1] = runtime->output[1];
+            queue.inputs = inputs;
+            queue.outputs = outputs;
+        }
+
+        if (track.is_audible)
+        {
+            if (block.schedule_editor)
+                uph_engine_schedule_editor(block, track_index, queue);
+            else if (block.schedule_song)
+                uph_engine_schedule_song(block, track, queue);
+            else
+                runtime->scheduled_block_end = -1.0;
+        }
+
+        // Nothing to wake up for, selecting the track wakes it as well.
+        const bool is_selected = track_index == block.snapshot->current_track_index;
+        if (runtime->is_sleeping.load(std::memory_order_relaxed) && !is_selected && queue.rendered == 0 && plugin->events.count == 0)
+            return 0;
+
+        uph_note_queue_render(queue, (int)block.frame_count);
+        uph_engine_update_sleep(block, is_selected, runtime, queue);
+        runtime->has_output = track.is_audible && !queue.is_silent;
+
+        // Float plugins in a double precision project are widened once the
+        // whole block is in.
+        if (is_double && !renders_double && runtime->has_output)
+        {
+            for (uint32_t c = 0; c < 2; ++c)
+                std::copy(runtime->output[c], runtime->output[c] + block.frame_count, runtime->output64[c]);
+        }
+        return queue.plugin_ns;
+    }
+    else if (track.track_type == UphTrackType_Sample && block.render_samples && track.is_audible)
+    {
+        UphEngineBlock ahead = block;
+        ahead.prev_beat = block.ahead_prev_beat;
+        ahead.new_beat = block.ahead_new_beat;
+
+        uph_track_runtime_clear(runtime, is_double, block.frame_count);
+        if (is_double)
+            uph_engine_render_samples(ahead, track, runtime->output64[0], runtime->output64[1]);
+        else
+            uph_engine_render_samples(ahead, track, runtime->output[0], runtime->output[1]);
+        runtime->has_output = true;
+    }
+    return 0;
+}
+
+template <typename T>
+static void uph_track_delay_run(T *line, T *io, uint32_t write, uint32_t read, uint32_t mask, uint32_t frame_count)
+{
+    for (uint32_t i = 0; i < frame_count; ++i)
+    {
+        line[(write + i) & mask] = io[i];
+        io[i] = line[(read + i) & mask];
+    }
+}
+
+// Holds the track back by track.delay frames. A silent track keeps running
+// the line until everything it still holds has been read out.
+static void uph_engine_delay_track(const UphEngineBlock &block, const UphRenderTrack &track)
+{
+    UphTrackDelay *delay = track.delay_line.get();
+    if (!delay || track.delay == 0)
+        return;
+
+    UphTrackRuntime *runtime = track.runtime.get();
+    const uint32_t frame_count = block.frame_count;
+
+    // Audio from before a seek would play out at the new position.
+    if (block.is_seek)
+        uph_track_delay_clear(delay);
+
+    // Whatever sits behind a changed read position is stale, flush it all.
+    if (delay->delay != track.delay)
+    {
+        delay->delay = track.delay;
+        delay->pending = delay->capacity;
+    }
+
+    if (runtime->has_output)
+    {
+        delay->pending = std::max(delay->pending, track.delay);
+    }
+    else
+    {
+        // The line ends in at least delay frames of silence, which is all
+        // the next block reads before its own input.
+        if (delay->pending == 0)
+            return;
+
+        uph_track_runtime_clear(runtime, delay->is_double, frame_count);
+        delay->pending = delay->pending > frame_count ? delay->pending - frame_count : 0;
+    }
+
+    const uint32_t mask = delay->capacity - 1;
+    const uint32_t write = delay->write_pos;
+    const uint32_t read = (write - track.delay) & mask;
+    for (uint32_t c = 0; c < 2; ++c)
+    {
+        if (delay->is_double)
+            uph_track_delay_run(delay->buffer64[c].get(), runtime->output64[c], write, read, mask, frame_count);
+        else
+            uph_track_delay_run(delay->buffer[c].get(), runtime->output[c], write, read, mask, frame_count);
+    }
+
+    delay->write_pos = (write + frame_count) & mask;
+    runtime->has_output = true;
+}
+
+static void uph_engine_render_track(void *user, uint32_t track_index, uint32_t worker_index)
+{
+    const UphEngineBlock &block = *(const UphEngineBlock*)user;
+
+    const uint64_t start = uph_profiler_now_ns();
+    const uint64_t plugin_ns = uph_engine_process_track(block, track_index, worker_index);
+    uph_engine_delay_track(block, block.snapshot->tracks[track_index]);
+    uph_profiler_record_track(track_index, uph_profiler_now_ns() - start, plugin_ns);
+}
+
+static void uph_engine_stop_all_notes(const UphRenderSnapshot *snapshot)
+{
+    for (auto &track : snapshot->tracks)
+    {
+        if (track.track_type == UphTrackType_Midi && track.plugin)
+            track.plugin->stop_all_notes(track.plugin);
+    }
+}
+
+// The kernels are float only, double precision mixes with plain loops and
+// only rounds to float when writing the device buffer.
+static float uph_accumulate_peak_double(double *dst, const double *src, uint32_t count, double gain)
+{
+    double peak = 0.0;
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        const double value = src[i] * gain;
+        dst[i] += value;
+        peak = std::max(peak, std::abs(value));
+    }
+    return (float)peak;
+}
+
+static void uph_interleave_add_double(float *output, const double *left, const double *right, uint32_t count, double gain)
+{
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        output[i * 2] += (float)(left[i] * gain);
+        output[i * 2 + 1] += (float)(right[i] * gain);
+    }
+}
+
+static void uph_engine_mix_tracks(const UphRenderSnapshot *snapshot, float *output, uint32_t frame_count)
+{
+    const UphDspKernels *dsp = uph_dsp_kernels();
+    const bool is_double = snapshot->double_precision;
+
+    for (uint32_t c = 0; c < 2; ++c)
+    {
+        if (is_double)
+            memset(engine.bus64[c], 0, frame_count * sizeof(double));
+        else
+            memset(engine.bus[c], 0, frame_count * sizeof(float));
+    }
+
+    for (auto &track : snapshot->tracks)
+    {
+        UphTrackRuntime *runtime = track.runtime.get();
+        if (!runtime->has_output)
+        {
+            runtime->peak_left.store(0.0f, std::memory_order_relaxed);
+            runtime->peak_right.store(0.0f, std::memory_order_relaxed);
+            continue;
+        }
+
+        float panNorm = (track.pan + 1.0f) * 0.5f;
+        float gainL = cosf(panNorm * HALF_PI);
+        float gainR = sinf(panNorm * HALF_PI);
+
+        float peakL, peakR;
+        if (is_double)
+        {
+            peakL = uph_accumulate_peak_double(engine.bus64[0], runtime->output64[0], frame_count, (double)track.volume * gainL);
+            peakR = uph_accumulate_peak_double(engine.bus64[1], runtime->output64[1], frame_count, (double)track.volume * gainR);
+        }
+        else
+        {
+            peakL = dsp->accumulate_peak(engine.bus[0], runtime->output[0], frame_count, track.volume * gainL);
+            peakR = dsp->accumulate_peak(engine.bus[1], runtime->output[1], frame_count, track.volume * gainR);
+        }
+
+        runtime->peak_left.store(peakL, std::memory_order_relaxed);
+        runtime->peak_right.store(peakR, std::memory_order_relaxed);
+    }
+
+    if (is_double)
+        uph_interleave_add_double(output, engine.bus64[0], engine.bus64[1], frame_count, snapshot->volume);
+    else
+        dsp->interleave_add(output, engine.bus[0], engine.bus[1], frame_count, snapshot->volume);
+}
+
+uint32_t uph_engine_default_worker_count(void)
+{
+    const uint32_t cores = std::thread::hardware_concurrency();
+    return cores > 1 ? cores - 1 : 0;
+}
+
+struct UphEnginePluginTasks
+{
+    UviTaskFunc task;
+    void *task_user;
+};
+
+static void uph_engine_plugin_task_job(void *user, uint32_t job_index, uint32_t)
+{
+    const UphEnginePluginTasks *tasks = (const UphEnginePluginTasks*)user;
+    tasks->task(tasks->task_user, job_index);
+}
+
+// Plugins that split their own processing, like CLAP's thread-pool, run
+// on the same workers as the tracks instead of spawning threads of their own.
+static void uph_engine_run_plugin_tasks(UviTaskFunc task, void *task_user, uint32_t task_count)
+{
+    UphEnginePluginTasks tasks = { task, task_user };
+    uph_worker_pool_run(uph_engine_plugin_task_job, &tasks, task_count);
+}
+
+void uph_engine_initialize(uint32_t worker_count)
+{
+    uph_engine_shutdown();
+    uph_dsp_select(uph_dsp_detect_isa());
+    uph_interpolation_initialize();
+    uph_worker_pool_initialize(worker_count);
+    uvi_set_thread_pool(uph_engine_run_plugin_tasks);
+
+    for (uint32_t i = 0; i < uph_worker_pool_participant_count(); ++i)
+        engine.buffer_pools.push_back(uph_buffer_pool_create(UPH_ENGINE_MAX_CHANNELS, UPH_ENGINE_BLOCK_SIZE));
+}
+
+void uph_engine_shutdown(void)
+{
+    uvi_set_thread_pool(nullptr);
+    uph_worker_pool_shutdown();
+
+    for (UphBufferPool *pool : engine.buffer_pools)
+        uph_buffer_pool_destroy(pool);
+    engine.buffer_pools.clear();
+}
+
+static void uph_engine_render_block(const UphRenderSnapshot *snapshot, float *output, uint32_t frame_count, float sample_rate)
+{
+    UphEngineBlock block{};
+    block.snapshot = snapshot;
+    block.sample_rate = sample_rate;
+    block.frame_count = frame_count;
+    block.render_samples = app->is_song_timeline_playing || app->is_exporting;
+    block.is_exporting = app->is_exporting;
+
+    if (!app->is_exporting && app->should_stop_all_notes.load())
+    {
+        uph_engine_stop_all_notes(snapshot);
+        app->should_stop_all_notes.store(false);
+    }
+    else if (!app->is_exporting && app->is_midi_editor_playing)
+    {
+        block.schedule_editor = true;
+    }
+    else if (app->is_exporting || app->is_song_timeline_playing)
+    {
+        block.schedule_song = true;
+    }
+
+    UphTransport *transport = block.schedule_editor ? &app->midi_editor_transport : &app->song_timeline_transport;
+    block.is_seek = uph_transport_begin_block(transport, snapshot->bpm, snapshot->pulse_per_quarter, sample_rate);
+
+    const uint64_t frame = transport->frame.load(std::memory_order_relaxed);
+    block.frames_per_beat = transport->frames_per_beat;
+    block.prev_beat = uph_transport_beat_at(transport, frame);
+    block.new_beat = uph_transport_beat_at(transport, frame + frame_count);
+    block.ahead_prev_beat = uph_transport_beat_at(transport, frame + snapshot->compensation);
+    block.ahead_new_beat = uph_transport_beat_at(transport, frame + frame_count + snapshot->compensation);
+
+    if (block.schedule_editor || block.schedule_song)
+        uph_transport_advance(transport, frame_count);
+
+    uph_worker_pool_run(uph_engine_render_track, &block, (uint32_t)snapshot->tracks.size());
+    uph_engine_mix_tracks(snapshot, output, frame_count);
+}
+
+void uph_engine_render(float *output, uint32_t frame_count, float sample_rate)
+{
+    const UphRenderSnapshot *snapshot = uph_render_snapshot_acquire();
+    if (!snapshot)
+    {
+        uph_render_snapshot_release();
+        return;
+    }
+
+    // Devices may hand us any period size, plugins and track buffers only
+    // ever see sub-blocks of at most UPH_ENGINE_BLOCK_SIZE frames.
+    for (uint32_t offset = 0; offset < frame_count; offset += UPH_ENGINE_BLOCK_SIZE)
+    {
+        const uint32_t sub_block = std::min<uint32_t>(UPH_ENGINE_BLOCK_SIZE, frame_count - offset);
+        uph_engine_render_block(snapshot, output + offset * 2, sub_block, sample_rate);
+    }
+
+    uph_render_snapshot_release();
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+#include <cstdint>
+
+#define UPH_ENGINE_BLOCK_SIZE   512
+#define UPH_ENGINE_MAX_CHANNELS 64
+
+uint32_t uph_engine_default_worker_count(void);
+
+// worker_count extra threads render tracks alongside the audio thread,
+// 0 renders every track serially for deterministic debugging.
+void uph_engine_initialize(uint32_t worker_count);
+void uph_engine_shutdown(void);
+
+// Renders frame_count frames of interleaved stereo into output, adding to
+// whatever is already there. Any frame_count is accepted, it is split into
+// sub-blocks of at most UPH_ENGINE_BLOCK_SIZE internally.
+void uph_engine_render(float *output, uint32_t frame_count, float sample_rate);
@@ -0,0 +1,250 @@
+#include "interpolation.h"
+#include "dsp_kernels.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+
+// Sinc bands a quarter octave apart, three octaves down, as far as the
+// padding lets the window grow. Playing faster than the sample rate the
+// cutoff has to drop with it or everything above folds back, the window
+// grows so the transition stays as steep. Past the last band it aliases.
+static constexpr uint32_t k_band_count = 13;
+static constexpr uint32_t k_bands_per_octave = 4;
+static constexpr uint32_t k_unity_taps = 64;
+static constexpr uint32_t k_phase_bits = 5;
+static constexpr double k_kaiser_beta = 8.0;
+static constexpr double k_cutoff = 0.45;
+// Where the unity band is down 80 dB, it moves with the cutoff.
+static constexpr double k_stopband = 0.49;
+static constexpr double k_pi = 3.14159265358979323846;
+
+static constexpr uint32_t k_fraction_bits = 32;
+static constexpr float k_fraction_scale = 1.0f / (float)(1u << 24);
+
+// The window reaches half its taps past the frame read, the widest one has
+// to stay inside the padding.
+static constexpr uint32_t k_widest_taps = k_unity_taps << ((k_band_count - 1) / k_bands_per_octave);
+static_assert(k_widest_taps / 2 <= UPH_SAMPLE_PADDING, "sample padding too small for the sinc window");
+
+// Mono and stereo copies of every band.
+static UphSincTable sinc_bands[k_band_count][2];
+
+static double uph_bessel_i0(double x)
+{
+    double sum = 1.0, term = 1.0;
+    for (int k = 1; k < 32; ++k)
+    {
+        const double half = x / (2.0 * k);
+        term *= half * half;
+        sum += term;
+    }
+    return sum;
+}
+
+void uph_sinc_table_build(UphSincTable *table, uint32_t tap_count, uint32_t phase_count,
+    double cutoff, double kaiser_beta, uint32_t channels)
+{
+    const double half = tap_count / 2;
+    const double window_norm = 1.0 / uph_bessel_i0(kaiser_beta);
+    const size_t row_size = (size_t)tap_count * channels;
+
+    table->tap_count = tap_count;
+    table->phase_count = phase_count;
+    table->channels = channels;
+    table->taps = std::make_unique<float[]>((phase_count + 1) * row_size);
+    table->deltas = std::make_unique<float[]>(phase_count * row_size);
+
+    std::unique_ptr<double[]> row = std::make_unique<double[]>(tap_count);
+    for (uint32_t phase = 0; phase <= phase_count; ++phase)
+    {
+        const double offset = half - 1.0 + (double)phase / phase_count;
+        double sum = 0.0;
+        for (uint32_t j = 0; j < tap_count; ++j)
+        {
+            const double t = j - offset;
+            const double x = t / half;
+            const double window = std::abs(x) < 1.0 ? uph_bessel_i0(kaiser_beta * std::sqrt(1.0 - x * x)) * window_norm : 0.0;
+            const double arg = 2.0 * k_pi * cutoff * t;
+            const double sinc = t == 0.0 ? 1.0 : std::sin(arg) / arg;
+            row[j] = sinc * window;
+            sum += row[j];
+        }
+
+        // Unity gain at DC on every phase, otherwise the gain ripples with it.
+        float *taps = table->taps.get() + phase * row_size;
+        for (uint32_t j = 0; j < tap_count; ++j)
+        {
+            for (uint32_t c = 0; c < channels; ++c)
+                taps[j * channels + c] = (float)(row[j] / sum);
+        }
+    }
+
+    for (size_t i = 0; i < phase_count * row_size; ++i)
+        table->deltas[i] = table->taps[i + row_size] - table->taps[i];
+}
+
+void uph_interpolation_initialize(void)
+{
+    if (sinc_bands[0][0].taps)
+        return;
+
+    for (uint32_t band = 0; band < k_band_count; ++band)
+    {
+        // Mono convolves pairs of frames as if they were stereo, so its
+        // tap count is a multiple of 16.
+        const double scale = std::exp2(-(double)band / k_bands_per_octave);
+        const uint32_t tap_count = ((uint32_t)std::ceil(k_unity_taps / scale) + 15) & ~15u;
+        for (uint32_t c = 0; c < 2; ++c)
+            uph_sinc_table_build(&sinc_bands[band][c], tap_count, 1u << k_phase_bits, k_cutoff * scale, k_kaiser_beta, c + 1);
+    }
+}
+
+static inline float uph_interpolation_fraction(uint64_t position)
+{
+    return (float)(int32_t)((uint32_t)position >> 8) * k_fraction_scale;
+}
+
+static inline const float *uph_interpolation_frame(const float *frames, uint64_t position, int64_t offset, uint32_t channels)
+{
+    return frames + ((int64_t)(position >> k_fraction_bits) + offset) * (int64_t)channels;
+}
+
+template <uint32_t C>
+static void uph_interpolate_linear(const float *frames, uint64_t position, uint64_t step, uint32_t count, float *left, float *right)
+{
+    for (uint32_t i = 0; i < count; ++i, position += step)
+    {
+        const float *p = uph_interpolation_frame(frames, position, 0, C);
+        const float t = uph_interpolation_fraction(position);
+        left[i] = p[0] + (p[C] - p[0]) * t;
+        right[i] = p[C - 1] + (p[2 * C - 1] - p[C - 1]) * t;
+    }
+}
+
+// Catmull-Rom, the Hermite spline through the two frames around the
+// position with tangents from their neighbours. The weights of a chunk are
+// worked out first, in a loop the compiler vectorises, then gathered.
+static constexpr uint32_t k_cubic_chunk = 64;
+
+template <uint32_t C>
+static void uph_interpolate_cubic(const float *frames, uint64_t position, uint64_t step, uint32_t count, float *left, float *right)
+{
+    alignas(64) float w[4][k_cubic_chunk];
+
+    for (uint32_t done = 0; done < count; done += k_cubic_chunk)
+    {
+        const uint32_t n = std::min(count - done, k_cubic_chunk);
+        const uint32_t fraction = (uint32_t)position;
+        const uint32_t fraction_step = (uint32_t)step;
+        for (uint32_t i = 0; i < k_cubic_chunk; ++i)
+        {
+            const float t = (float)(int32_t)((fraction + i * fraction_step) >> 8) * k_fraction_scale;
+            const float t2 = t * t;
+            w[0][i] = ((-0.5f * t + 1.0f) * t - 0.5f) * t;
+            w[1][i] = (1.5f * t - 2.5f) * t2 + 1.0f;
+            w[2][i] = ((-1.5f * t + 2.0f) * t + 0.5f) * t;
+            w[3][i] = (0.5f * t - 0.5f) * t2;
+        }
+
+        for (uint32_t i = 0; i < n; ++i, position += step)
+        {
+            const float *p = uph_interpolation_frame(frames, position, -1, C);
+            left[done + i] = w[0][i] * p[0] + w[1][i] * p[C] + w[2][i] * p[2 * C] + w[3][i] * p[3 * C];
+            right[done + i] = w[0][i] * p[C - 1] + w[1][i] * p[2 * C - 1] + w[2][i] * p[3 * C - 1] + w[3][i] * p[4 * C - 1];
+        }
+    }
+}
+
+// The widest band whose stopband stays under the output's Nyquist, so a
+// rate just above unity keeps the unity band rather than dropping a whole
+// band of treble for aliasing it wouldn't have.
+static uint32_t uph_sinc_band(uint64_t step)
+{
+    const double rate = (double)step / (double)(1ull << k_fraction_bits);
+    const double bands = std::ceil(k_bands_per_octave * std::log2(rate * k_stopband / 0.5));
+    return bands > 0.0 ? std::min((uint32_t)bands, k_band_count - 1) : 0;
+}
+
+// The phase is the top bits of the fraction, the rest blends to the next one.
+template <uint32_t C>
+static void uph_interpolate_sinc(const float *frames, uint64_t position, uint64_t step, uint32_t count, float *left, float *right)
+{
+    const UphDspKernels *dsp = uph_dsp_kernels();
+
+    const UphSincTable &table = sinc_bands[uph_sinc_band(step)][C - 1];
+    const uint32_t row_size = table.tap_count * C;
+    const int64_t window_offset = 1 - (int64_t)(table.tap_count / 2);
+
+    constexpr uint32_t phase_shift = k_fraction_bits - k_phase_bits;
+    constexpr float phase_scale = 1.0f / (float)(1u << phase_shift);
+
+    for (uint32_t i = 0; i < count; ++i, position += step)
+    {
+        const float *window = uph_interpolation_frame(frames, position, window_offset, C);
+        const uint32_t fraction = (uint32_t)position;
+        const size_t offset = (size_t)(fraction >> phase_shift) * row_size;
+        const float blend = (float)(int32_t)(fraction & ((1u << phase_shift) - 1)) * phase_scale;
+
+        float l, r;
+        dsp->convolve_stereo(window, table.taps.get() + offset, table.deltas.get() + offset, blend, row_size / 2, &l, &r);
+
+        // Mono went through as pairs of frames, even and odd taps summed apart.
+        left[i] = C == 1 ? l + r : l;
+        right[i] = C == 1 ? l + r : r;
+    }
+}
+
+void uph_interpolate(UphInterpolation interpolation, const float *frames, uint32_t channels,
+    uint64_t position, uint64_t step, uint32_t count, float *left, float *right)
+{
+    const bool is_mono = channels == 1;
+    switch (interpolation)
+    {
+    case UphInterpolation_Sinc:
+        if (is_mono)
+            uph_interpolate_sinc<1>(frames, position, step, count, left, right);
+        else
+            uph_interpolate_sinc<2>(frames, position, step, count, left, right);
+        break;
+    case UphInterpolation_Cubic:
+        if (is_mono)
+            uph_interpolate_cubic<1>(frames, position, step, count, left, right);
+        else
+            uph_interpolate_cubic<2>(frames, position, step, count, left, right);
+        break;
+    default:
+        if (is_mono)
+            uph_interpolate_linear<1>(frames, position, step, count, left, right);
+        else
+            uph_interpolate_linear<2>(frames, position, step, count, left, right);
+        break;
+    }
+}
+
+// Sized for stereo on both sides whatever the layout, so freeing doesn't
+// need to know it.
+static constexpr size_t k_padding_floats = (size_t)UPH_SAMPLE_PADDING * 2;
+
+float *uph_sample_frames_alloc(uint64_t frame_count, uint32_t channels)
+{
+    float *base = (float*)calloc((size_t)frame_count * channels + k_padding_floats * 2, sizeof(float));
+    return base ? base + k_padding_floats : nullptr;
+}
+
+void uph_sample_frames_free(void *frames)
+{
+    if (frames)
+        free((float*)frames - k_padding_floats);
+}
+
+const char *uph_interpolation_name(UphInterpolation interpolation)
+{
+    switch (interpolation)
+    {
+    case UphInterpolation_Linear: return "Linear";
+    case UphInterpolation_Cubic:  return "Cubic";
+    case UphInterpolation_Sinc:   return "Sinc";
+    default:                      return "Unknown";
+    }
+}
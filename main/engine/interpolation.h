@@ -0,0 +1,43 @@
+#pragma once
+
+#include "types.h"
+
+#include <cstdint>
+#include <memory>
+
+// Reads samples at any rate for the sample tracks. Positions are 32.32
+// fixed point frames, so nothing in the loops converts from double or
+// checks bounds, the padding around every sample covers the widest window.
+
+// Kaiser windowed sinc, one row of coefficients per phase. Each one is
+// stored channels times in a row, the layout the dsp convolution reads.
+struct UphSincTable
+{
+    uint32_t tap_count;     // a multiple of 8
+    uint32_t phase_count;
+    uint32_t channels;
+    std::unique_ptr<float[]> taps;      // phase_count + 1 rows
+    std::unique_ptr<float[]> deltas;    // phase_count rows, the next row minus this one
+};
+
+// Tap j of phase p sits at tap_count / 2 - 1 + p / phase_count frames into
+// the window. cutoff is in cycles per input frame, every row has unity gain
+// at DC.
+void uph_sinc_table_build(UphSincTable *table, uint32_t tap_count, uint32_t phase_count,
+    double cutoff, double kaiser_beta, uint32_t channels);
+
+// Builds the sinc tables, before any audio renders.
+void uph_interpolation_initialize(void);
+
+// Writes count frames read from frames, mono or interleaved stereo, starting
+// at position and advancing by step. Mono lands on both outputs. Sinc stays
+// alias free up to a step of about 8 frames, what the padding allows, past
+// that it aliases like the others.
+void uph_interpolate(UphInterpolation interpolation, const float *frames, uint32_t channels,
+    uint64_t position, uint64_t step, uint32_t count, float *left, float *right);
+
+// Zeroed frames with UPH_SAMPLE_PADDING frames of silence on both sides.
+float *uph_sample_frames_alloc(uint64_t frame_count, uint32_t channels);
+void uph_sample_frames_free(void *frames);
+
+const char *uph_interpolation_name(UphInterpolation interpolation);
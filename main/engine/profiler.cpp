@@ -0,0 +1,238 @@
+#include "profiler.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <vector>
+
+struct UphProfilerCallback
+{
+    float elapsed_us;
+    float budget_us;
+};
+
+struct UphProfilerBlock
+{
+    float render_us;
+    float plugin_us;
+};
+
+static constexpr uint32_t k_ring_capacity = 1024;
+static constexpr uint32_t k_track_ring_capacity = 256;
+
+struct alignas(64) UphProfilerTrack
+{
+    std::atomic<uint64_t> render_ns = 0;
+    std::atomic<uint64_t> plugin_ns = 0;
+
+    // Render participant -> UI, one entry per block.
+    UphProfilerBlock ring[k_track_ring_capacity];
+    alignas(64) std::atomic<uint32_t> ring_head = 0;
+    alignas(64) std::atomic<uint32_t> ring_tail = 0;
+};
+
+// The last UPH_PROFILER_WINDOW values, the oldest is overwritten first.
+struct UphProfilerWindow
+{
+    std::vector<float> values;
+    uint32_t next = 0;
+};
+
+struct UphProfilerTrackWindows
+{
+    UphProfilerWindow render;
+    UphProfilerWindow plugin;
+};
+
+struct UphProfiler
+{
+    // Audio thread -> UI
+    UphProfilerCallback ring[k_ring_capacity];
+    alignas(64) std::atomic<uint32_t> ring_head = 0;
+    alignas(64) std::atomic<uint32_t> ring_tail = 0;
+
+    std::atomic<uint64_t> callbacks = 0;
+    std::atomic<uint64_t> xruns = 0;
+
+    UphProfilerTrack tracks[UPH_PROFILER_MAX_TRACKS];
+
+    // UI thread only
+    UphProfilerWindow window;
+    UphProfilerTrackWindows track_windows[UPH_PROFILER_MAX_TRACKS];
+    std::vector<float> sorted;
+    float budget_us = 0.0f;
+    uint64_t last_update_ns = 0;
+    uint64_t last_render_ns[UPH_PROFILER_MAX_TRACKS] = {};
+    uint64_t last_plugin_ns[UPH_PROFILER_MAX_TRACKS] = {};
+    uint64_t xrun_base = 0;
+    UphProfilerStats stats = {};
+};
+
+static UphProfiler profiler;
+
+uint64_t uph_profiler_now_ns(void)
+{
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void uph_profiler_record_callback(uint64_t elapsed_ns, uint32_t frame_count, float sample_rate)
+{
+    const float elapsed_us = (float)elapsed_ns * 1e-3f;
+    const float budget_us = (float)frame_count / sample_rate * 1e6f;
+
+    profiler.callbacks.fetch_add(1, std::memory_order_relaxed);
+    if (elapsed_us > budget_us)
+        profiler.xruns.fetch_add(1, std::memory_order_relaxed);
+
+    // Drop the sample rather than block when the UI falls behind.
+    const uint32_t head = profiler.ring_head.load(std::memory_order_relaxed);
+    if (head - profiler.ring_tail.load(std::memory_order_acquire) >= k_ring_capacity)
+        return;
+
+    profiler.ring[head % k_ring_capacity] = { elapsed_us, budget_us };
+    profiler.ring_head.store(head + 1, std::memory_order_release);
+}
+
+void uph_profiler_record_track(uint32_t track_index, uint64_t render_ns, uint64_t plugin_ns)
+{
+    if (track_index >= UPH_PROFILER_MAX_TRACKS)
+        return;
+
+    // Each track is rendered by one participant at a time, so plain
+    // load/store pairs are enough.
+    UphProfilerTrack &track = profiler.tracks[track_index];
+    track.render_ns.store(track.render_ns.load(std::memory_order_relaxed) + render_ns, std::memory_order_relaxed);
+    track.plugin_ns.store(track.plugin_ns.load(std::memory_order_relaxed) + plugin_ns, std::memory_order_relaxed);
+
+    const uint32_t head = track.ring_head.load(std::memory_order_relaxed);
+    if (head - track.ring_tail.load(std::memory_order_acquire) >= k_track_ring_capacity)
+        return;
+
+    track.ring[head % k_track_ring_capacity] = { (float)render_ns * 1e-3f, (float)plugin_ns * 1e-3f };
+    track.ring_head.store(head + 1, std::memory_order_release);
+}
+
+static void uph_profiler_window_push(UphProfilerWindow &window, float value)
+{
+    if (window.values.size() < UPH_PROFILER_WINDOW)
+        window.values.push_back(value);
+    else
+        window.values[window.next] = value;
+    window.next = (window.next + 1) % UPH_PROFILER_WINDOW;
+}
+
+static void uph_profiler_window_clear(UphProfilerWindow &window)
+{
+    window.values.clear();
+    window.next = 0;
+}
+
+static float uph_profiler_percentile(std::vector<float> &values, float percentile)
+{
+    const size_t index = std::min(values.size() - 1, (size_t)(percentile * (float)values.size()));
+    std::nth_element(values.begin(), values.begin() + index, values.end());
+    return values[index];
+}
+
+static void uph_profiler_window_stats(const UphProfilerWindow &window, float *p50_us, float *p99_us, float *max_us)
+{
+    if (window.values.empty())
+    {
+        *p50_us = *p99_us = *max_us = 0.0f;
+        return;
+    }
+
+    std::vector<float> &sorted = profiler.sorted;
+    sorted.assign(window.values.begin(), window.values.end());
+    *max_us = *std::max_element(sorted.begin(), sorted.end());
+    *p99_us = uph_profiler_percentile(sorted, 0.99f);
+    *p50_us = uph_profiler_percentile(sorted, 0.50f);
+}
+
+void uph_profiler_update(uint32_t track_count)
+{
+    UphProfilerStats &stats = profiler.stats;
+
+    uint32_t tail = profiler.ring_tail.load(std::memory_order_relaxed);
+    const uint32_t head = profiler.ring_head.load(std::memory_order_acquire);
+    for (; tail != head; ++tail)
+    {
+        const UphProfilerCallback &callback = profiler.ring[tail % k_ring_capacity];
+        uph_profiler_window_push(profiler.window, callback.elapsed_us);
+        profiler.budget_us = callback.budget_us;
+    }
+    profiler.ring_tail.store(tail, std::memory_order_release);
+
+    uph_profiler_window_stats(profiler.window, &stats.p50_us, &stats.p99_us, &stats.max_us);
+    stats.budget_us = profiler.budget_us;
+    stats.load = stats.budget_us > 0.0f ? stats.p50_us / stats.budget_us : 0.0f;
+    stats.callbacks = profiler.callbacks.load(std::memory_order_relaxed);
+    stats.xruns = profiler.xruns.load(std::memory_order_relaxed) - profiler.xrun_base;
+
+    // Track load is time spent rendering over wall time elapsed, smoothed
+    // so the ranking doesn't flicker between frames.
+    const uint64_t now = uph_profiler_now_ns();
+    const uint64_t elapsed_ns = profiler.last_update_ns ? now - profiler.last_update_ns : 0;
+    profiler.last_update_ns = now;
+
+    stats.track_count = std::min<uint32_t>(track_count, UPH_PROFILER_MAX_TRACKS);
+    for (uint32_t i = 0; i < stats.track_count; ++i)
+    {
+        UphProfilerTrack &track = profiler.tracks[i];
+        UphProfilerTrackStats &track_stats = stats.tracks[i];
+
+        const uint64_t render_ns = track.render_ns.load(std::memory_order_relaxed);
+        const uint64_t plugin_ns = track.plugin_ns.load(std::memory_order_relaxed);
+
+        if (elapsed_ns > 0)
+        {
+            const float load = (float)(render_ns - profiler.last_render_ns[i]) / (float)elapsed_ns;
+            const float plugin_load = (float)(plugin_ns - profiler.last_plugin_ns[i]) / (float)elapsed_ns;
+            track_stats.load += (load - track_stats.load) * 0.1f;
+            track_stats.plugin_load += (plugin_load - track_stats.plugin_load) * 0.1f;
+        }
+
+        profiler.last_render_ns[i] = render_ns;
+        profiler.last_plugin_ns[i] = plugin_ns;
+
+        // Only sorted again when the track rendered since the last update.
+        UphProfilerTrackWindows &windows = profiler.track_windows[i];
+        uint32_t track_tail = track.ring_tail.load(std::memory_order_relaxed);
+        const uint32_t track_head = track.ring_head.load(std::memory_order_acquire);
+        if (track_tail == track_head)
+            continue;
+        for (; track_tail != track_head; ++track_tail)
+        {
+            const UphProfilerBlock &block = track.ring[track_tail % k_track_ring_capacity];
+            uph_profiler_window_push(windows.render, block.render_us);
+            uph_profiler_window_push(windows.plugin, block.plugin_us);
+        }
+        track.ring_tail.store(track_tail, std::memory_order_release);
+
+        uph_profiler_window_stats(windows.render, &track_stats.p50_us, &track_stats.p99_us, &track_stats.max_us);
+        uph_profiler_window_stats(windows.plugin, &track_stats.plugin_p50_us, &track_stats.plugin_p99_us, &track_stats.plugin_max_us);
+    }
+}
+
+void uph_profiler_reset(void)
+{
+    uph_profiler_window_clear(profiler.window);
+    profiler.xrun_base = profiler.xruns.load(std::memory_order_relaxed);
+    profiler.stats.p50_us = profiler.stats.p99_us = profiler.stats.max_us = 0.0f;
+
+    for (uint32_t i = 0; i < UPH_PROFILER_MAX_TRACKS; ++i)
+    {
+        uph_profiler_window_clear(profiler.track_windows[i].render);
+        uph_profiler_window_clear(profiler.track_windows[i].plugin);
+
+        UphProfilerTrackStats &track_stats = profiler.stats.tracks[i];
+        track_stats.p50_us = track_stats.p99_us = track_stats.max_us = 0.0f;
+        track_stats.plugin_p50_us = track_stats.plugin_p99_us = track_stats.plugin_max_us = 0.0f;
+    }
+}
+
+const UphProfilerStats *uph_profiler_stats(void)
+{
+    return &profiler.stats;
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstdint>
+
+// Audio thread timing. The audio thread and the render workers only ever
+// store into atomics and single-producer rings, the UI thread folds those
+// into rolling statistics once per frame.
+
+#define UPH_PROFILER_MAX_TRACKS 256
+#define UPH_PROFILER_WINDOW     2048
+
+struct UphProfilerTrackStats
+{
+    float load;         // share of the real-time budget spent on the track
+    float plugin_load;  // part of load spent inside plugin->process
+
+    // Over the last UPH_PROFILER_WINDOW blocks the track rendered, the
+    // whole track and the time inside plugin->process.
+    float p50_us, p99_us, max_us;
+    float plugin_p50_us, plugin_p99_us, plugin_max_us;
+};
+
+struct UphProfilerStats
+{
+    // Over the last UPH_PROFILER_WINDOW callbacks.
+    float p50_us, p99_us, max_us;
+    float budget_us;
+    float load;
+
+    uint64_t callbacks;
+    uint64_t xruns;
+
+    uint32_t track_count;
+    UphProfilerTrackStats tracks[UPH_PROFILER_MAX_TRACKS];
+};
+
+uint64_t uph_profiler_now_ns(void);
+
+// Audio thread, the callback is an xrun when it took longer than the
+// frames it produced last in real time.
+void uph_profiler_record_callback(uint64_t elapsed_ns, uint32_t frame_count, float sample_rate);
+
+// Any render participant, only ever for the track it is rendering.
+void uph_profiler_record_track(uint32_t track_index, uint64_t render_ns, uint64_t plugin_ns);
+
+// UI thread
+void uph_profiler_update(uint32_t track_count);
+void uph_profiler_reset(void);
+const UphProfilerStats *uph_profiler_stats(void);
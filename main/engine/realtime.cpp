@@ -0,0 +1,334 @@
+#include "realtime.h"
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstring>
+#include <thread>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <sched.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#if defined(_M_X64) || defined(__x86_64__) || defined(_M_IX86) || defined(__i386__)
+#include <xmmintrin.h>
+#define UPH_REALTIME_HAS_MXCSR 1
+#else
+#define UPH_REALTIME_HAS_MXCSR 0
+#endif
+
+// Workers share the audio thread's priority. The audio thread yields while
+// it waits on them, which under SCHED_FIFO only ever hands the core to
+// threads of the same priority.
+static constexpr int k_fifo_priority = 70;
+static constexpr int k_raised_nice = -10;
+
+static constexpr uint32_t k_mxcsr_ftz_daz = 0x8040;
+
+// A seqlock, so the settings can read a record while its thread rewrites it
+// and the thread never waits on the UI. One writer at a time, the thread
+// itself or whoever stops it once it's gone.
+struct UphRealtimeSlot
+{
+    std::atomic<uint32_t> sequence = 0;     // odd while it's written
+    std::atomic<uint64_t> words[2] = {};
+};
+
+static_assert(sizeof(UphRealtimeThreadInfo) <= sizeof(uint64_t) * 2, "thread record doesn't fit its slot");
+
+// The config is only written by the UI thread. Its fields are stored before
+// the generation is bumped, a thread that reads them halfway through an
+// update sees the generation move again and sets itself up once more.
+struct UphRealtime
+{
+    std::atomic<uint32_t> generation = 1;
+    std::atomic<bool> request_realtime = true;
+    std::atomic<uint64_t> worker_cores = 0;
+    std::atomic<uint64_t> process_cores = 0;
+    UphRealtimeSlot threads[UPH_REALTIME_MAX_THREADS];
+};
+
+static UphRealtime realtime;
+
+static thread_local uint32_t tls_generation = 0;
+
+#if defined(_WIN32)
+
+typedef HANDLE (WINAPI *UphAvSetMmThreadCharacteristicsFunc)(LPCWSTR task_name, LPDWORD task_index);
+typedef BOOL (WINAPI *UphAvRevertMmThreadCharacteristicsFunc)(HANDLE handle);
+
+static thread_local HANDLE tls_mmcss = nullptr;
+
+static uint64_t uph_realtime_query_process_cores(void)
+{
+    DWORD_PTR process_mask = 0, system_mask = 0;
+    GetProcessAffinityMask(GetCurrentProcess(), &process_mask, &system_mask);
+    return (uint64_t)process_mask;
+}
+
+static UphRealtimeScheduling uph_realtime_set_priority(bool request_realtime)
+{
+    // avrt isn't linked, MMCSS is optional on older systems anyway.
+    static HMODULE avrt = LoadLibraryW(L"avrt.dll");
+    auto set_characteristics = avrt ? (UphAvSetMmThreadCharacteristicsFunc)GetProcAddress(avrt, "AvSetMmThreadCharacteristicsW") : nullptr;
+    auto revert_characteristics = avrt ? (UphAvRevertMmThreadCharacteristicsFunc)GetProcAddress(avrt, "AvRevertMmThreadCharacteristics") : nullptr;
+
+    if (tls_mmcss && revert_characteristics)
+        revert_characteristics(tls_mmcss);
+    tls_mmcss = nullptr;
+
+    if (!request_realtime)
+    {
+        SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_NORMAL);
+        return UphRealtimeScheduling_Normal;
+    }
+
+    DWORD task_index = 0;
+    if (set_characteristics)
+        tls_mmcss = set_characteristics(L"Pro Audio", &task_index);
+
+    const bool is_raised = SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_TIME_CRITICAL) != 0;
+    if (tls_mmcss)
+        return UphRealtimeScheduling_Realtime;
+    return is_raised ? UphRealtimeScheduling_Raised : UphRealtimeScheduling_Normal;
+}
+
+static int32_t uph_realtime_current_priority(void)
+{
+    return GetThreadPriority(GetCurrentThread());
+}
+
+static bool uph_realtime_set_affinity(uint64_t cores)
+{
+    return SetThreadAffinityMask(GetCurrentThread(), (DWORD_PTR)cores) != 0;
+}
+
+#else
+
+static uint64_t uph_realtime_query_process_cores(void)
+{
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (sched_getaffinity(0, sizeof(set), &set) != 0)
+        return ~0ull;
+
+    uint64_t cores = 0;
+    for (uint32_t core = 0; core < 64; ++core)
+    {
+        if (CPU_ISSET(core, &set))
+            cores |= 1ull << core;
+    }
+    return cores;
+}
+
+static bool uph_realtime_set_nice(int nice)
+{
+    return setpriority(PRIO_PROCESS, (id_t)syscall(SYS_gettid), nice) == 0;
+}
+
+// No D-Bus here, so no rtkit either. SCHED_FIFO works wherever rtprio is
+// granted through limits.conf, otherwise a lower nice value is the next
+// best thing.
+static UphRealtimeScheduling uph_realtime_set_priority(bool request_realtime)
+{
+    sched_param param{};
+    if (!request_realtime)
+    {
+        pthread_setschedparam(pthread_self(), SCHED_OTHER, &param);
+        uph_realtime_set_nice(0);
+        return UphRealtimeScheduling_Normal;
+    }
+
+    param.sched_priority = std::clamp(k_fifo_priority, sched_get_priority_min(SCHED_FIFO), sched_get_priority_max(SCHED_FIFO));
+    if (pthread_setschedparam(pthread_self(), SCHED_FIFO, &param) == 0)
+        return UphRealtimeScheduling_Realtime;
+
+    return uph_realtime_set_nice(k_raised_nice) ? UphRealtimeScheduling_Raised : UphRealtimeScheduling_Normal;
+}
+
+static int32_t uph_realtime_current_priority(void)
+{
+    int policy = SCHED_OTHER;
+    sched_param param{};
+    pthread_getschedparam(pthread_self(), &policy, &param);
+    if (policy == SCHED_FIFO || policy == SCHED_RR)
+        return param.sched_priority;
+    return -getpriority(PRIO_PROCESS, (id_t)syscall(SYS_gettid));
+}
+
+static bool uph_realtime_set_affinity(uint64_t cores)
+{
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (uint32_t core = 0; core < 64; ++core)
+    {
+        if (cores & (1ull << core))
+            CPU_SET(core, &set);
+    }
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+}
+
+#endif
+
+static bool uph_realtime_flushes_denormals(void)
+{
+#if UPH_REALTIME_HAS_MXCSR
+    return (_mm_getcsr() & k_mxcsr_ftz_daz) == k_mxcsr_ftz_daz;
+#else
+    return false;
+#endif
+}
+
+static void uph_realtime_slot_write(UphRealtimeSlot *slot, const UphRealtimeThreadInfo &info)
+{
+    uint64_t words[2] = {};
+    memcpy(words, &info, sizeof(info));
+
+    const uint32_t sequence = slot->sequence.load(std::memory_order_relaxed);
+    slot->sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot->words[0].store(words[0], std::memory_order_relaxed);
+    slot->words[1].store(words[1], std::memory_order_relaxed);
+    slot->sequence.store(sequence + 2, std::memory_order_release);
+}
+
+static UphRealtimeThreadInfo uph_realtime_slot_read(const UphRealtimeSlot *slot)
+{
+    uint64_t words[2];
+    for (;;)
+    {
+        const uint32_t sequence = slot->sequence.load(std::memory_order_acquire);
+        words[0] = slot->words[0].load(std::memory_order_relaxed);
+        words[1] = slot->words[1].load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if ((sequence & 1) == 0 && slot->sequence.load(std::memory_order_relaxed) == sequence)
+            break;
+        std::this_thread::yield();
+    }
+
+    UphRealtimeThreadInfo info;
+    memcpy(&info, words, sizeof(info));
+    return info;
+}
+
+// The n-th core of the mask, wrapping around.
+static int32_t uph_realtime_pick_core(uint64_t cores, uint32_t n)
+{
+    const uint32_t count = (uint32_t)std::popcount(cores);
+    if (count == 0)
+        return -1;
+
+    n %= count;
+    for (; n > 0; --n)
+        cores &= cores - 1;
+    return std::countr_zero(cores);
+}
+
+void uph_realtime_configure(const UphRealtimeConfig *config)
+{
+    if (realtime.process_cores.load(std::memory_order_relaxed) == 0)
+        realtime.process_cores.store(uph_realtime_query_process_cores(), std::memory_order_relaxed);
+
+    realtime.request_realtime.store(config->request_realtime, std::memory_order_relaxed);
+    realtime.worker_cores.store(config->worker_cores, std::memory_order_relaxed);
+    realtime.generation.fetch_add(1, std::memory_order_release);
+}
+
+UphRealtimeConfig uph_realtime_config(void)
+{
+    UphRealtimeConfig config;
+    config.request_realtime = realtime.request_realtime.load(std::memory_order_relaxed);
+    config.worker_cores = realtime.worker_cores.load(std::memory_order_relaxed);
+    return config;
+}
+
+void uph_realtime_setup_thread(UphRealtimeRole role, uint32_t index)
+{
+    const uint32_t generation = realtime.generation.load(std::memory_order_acquire);
+    if (tls_generation == generation)
+        return;
+    tls_generation = generation;
+
+    const UphRealtimeConfig config = uph_realtime_config();
+    const uint64_t process_cores = realtime.process_cores.load(std::memory_order_relaxed);
+
+    UphRealtimeThreadInfo info{};
+    info.is_active = true;
+    info.role = role;
+    info.scheduling = uph_realtime_set_priority(config.request_realtime);
+    info.priority = uph_realtime_current_priority();
+    info.core = -1;
+
+    if (role == UphRealtimeRole_Worker)
+    {
+        const int32_t core = uph_realtime_pick_core(config.worker_cores, index > 0 ? index - 1 : 0);
+        if (core >= 0 && uph_realtime_set_affinity(1ull << core))
+            info.core = core;
+        else if (process_cores != 0)
+            uph_realtime_set_affinity(process_cores);
+    }
+
+    uph_realtime_flush_denormals();
+    info.flushes_denormals = uph_realtime_flushes_denormals();
+
+    if (index < UPH_REALTIME_MAX_THREADS)
+        uph_realtime_slot_write(&realtime.threads[index], info);
+}
+
+void uph_realtime_flush_denormals(void)
+{
+#if UPH_REALTIME_HAS_MXCSR
+    _mm_setcsr(_mm_getcsr() | k_mxcsr_ftz_daz);
+#endif
+}
+
+uint32_t uph_realtime_float_mode(void)
+{
+#if UPH_REALTIME_HAS_MXCSR
+    return _mm_getcsr();
+#else
+    return 0;
+#endif
+}
+
+void uph_realtime_restore_float_mode(uint32_t mode)
+{
+#if UPH_REALTIME_HAS_MXCSR
+    _mm_setcsr(mode);
+#else
+    (void)mode;
+#endif
+}
+
+void uph_realtime_thread_stopped(uint32_t index)
+{
+    if (index >= UPH_REALTIME_MAX_THREADS)
+        return;
+
+    UphRealtimeThreadInfo info = uph_realtime_slot_read(&realtime.threads[index]);
+    info.is_active = false;
+    uph_realtime_slot_write(&realtime.threads[index], info);
+}
+
+uint32_t uph_realtime_threads(UphRealtimeThreadInfo *infos, uint32_t max_count)
+{
+    uint32_t count = 0;
+    for (const UphRealtimeSlot &slot : realtime.threads)
+    {
+        const UphRealtimeThreadInfo info = uph_realtime_slot_read(&slot);
+        if (info.is_active && count < max_count)
+            infos[count++] = info;
+    }
+    return count;
+}
+
+uint32_t uph_realtime_core_count(void)
+{
+    return std::clamp<uint32_t>(std::thread::hardware_concurrency(), 1, 64);
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstdint>
+
+// Scheduling of the threads that render audio. Each of them sets itself up
+// on its own, the first time it renders and again whenever the config
+// changed, and records what the OS actually granted so the settings can
+// show it. Denormals are flushed to zero on every block since plugins are
+// free to reset the mode.
+
+#define UPH_REALTIME_MAX_THREADS 64
+
+enum UphRealtimeRole : uint8_t
+{
+    UphRealtimeRole_Audio,
+    UphRealtimeRole_Worker
+};
+
+enum UphRealtimeScheduling : uint8_t
+{
+    UphRealtimeScheduling_Normal,   // nothing was granted
+    UphRealtimeScheduling_Raised,   // higher priority, still time shared
+    UphRealtimeScheduling_Realtime  // SCHED_FIFO or MMCSS Pro Audio
+};
+
+struct UphRealtimeConfig
+{
+    bool request_realtime = true;
+    uint64_t worker_cores = 0;  // workers are pinned round robin to these, 0 leaves them floating
+};
+
+struct UphRealtimeThreadInfo
+{
+    bool is_active;
+    UphRealtimeRole role;
+    UphRealtimeScheduling scheduling;
+    int32_t priority;   // as the OS reports it
+    int32_t core;       // -1 when not pinned
+    bool flushes_denormals;
+};
+
+// UI thread, picked up by every rendering thread before its next block.
+void uph_realtime_configure(const UphRealtimeConfig *config);
+UphRealtimeConfig uph_realtime_config(void);
+
+// Rendering threads, index is the worker index and 0 for the audio thread.
+// Only does any work the first time and after a config change, and never
+// waits on the UI.
+void uph_realtime_setup_thread(UphRealtimeRole role, uint32_t index);
+void uph_realtime_flush_denormals(void);
+
+// The calling thread's floating point mode, for a thread that renders for a
+// while and then goes back to other work.
+uint32_t uph_realtime_float_mode(void);
+void uph_realtime_restore_float_mode(uint32_t mode);
+
+// Marks a thread that is gone, from the thread itself or once it's joined.
+void uph_realtime_thread_stopped(uint32_t index);
+
+// Copies the record of every thread that was set up, returns the count.
+uint32_t uph_realtime_threads(UphRealtimeThreadInfo *infos, uint32_t max_count);
+
+uint32_t uph_realtime_core_count(void);
@@ -0,0 +1,616 @@
+#include "render_snapshot.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+struct UphDeferredFree
+{
+    uint64_t generation;
+    UphDeferredFreeFunc free_func;
+    void *data;
+};
+
+// The audio thread announces the snapshot it is reading in audio_snapshot
+// (a single hazard pointer) and re-validates it against published_snapshot,
+// so the UI can free anything that is neither published nor announced.
+static std::atomic<UphRenderSnapshot*> published_snapshot = nullptr;
+static std::atomic<UphRenderSnapshot*> audio_snapshot = nullptr;
+
+static std::vector<UphRenderSnapshot*> retired_snapshots;
+static std::vector<UphDeferredFree> deferred_frees;
+static std::vector<std::shared_ptr<UphTrackRuntime>> track_runtimes;
+static std::vector<std::shared_ptr<UphTrackDelay>> track_delays;
+static uint64_t next_generation = 1;
+
+// Set when the published snapshot has to be replaced even though the
+// project didn't change, to drop references it holds.
+static bool is_publish_forced = false;
+
+// Tracks referencing fewer notes than this compile their events inline, a
+// background round trip would only delay them.
+static constexpr size_t k_inline_compile_notes = 4096;
+
+struct UphEventCompileJob
+{
+    uint32_t track_index;
+    std::shared_ptr<UphTrackEvents> events;     // inputs set, events filled in by the compiler
+};
+
+// One thread compiling the events of large tracks. Only the latest job of a
+// track is kept, a drag replaces it every frame.
+struct UphEventCompiler
+{
+    std::thread thread;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::deque<UphEventCompileJob> jobs;
+    std::vector<UphEventCompileJob> finished;
+    bool stop = false;
+};
+
+static UphEventCompiler event_compiler;
+
+// UI thread, per track. The events last queued and the ones compiled but
+// not picked up yet.
+static std::vector<std::shared_ptr<const UphTrackEvents>> queued_events;
+static std::vector<std::shared_ptr<const UphTrackEvents>> compiled_events;
+
+// Set until the next build, which then compiles every track inline.
+static bool is_inline_compile_forced = false;
+
+static std::shared_ptr<const UphRenderNotes> uph_render_notes_create(const std::vector<UphNote> &notes)
+{
+    auto render_notes = std::make_shared<UphRenderNotes>();
+    render_notes->notes = notes;
+    render_notes->max_length = 0.0f;
+
+    const uint32_t count = (uint32_t)notes.size();
+    render_notes->by_start.resize(count);
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        render_notes->by_start[i] = i;
+        render_notes->max_length = std::max(render_notes->max_length, notes[i].length);
+    }
+    render_notes->by_end = render_notes->by_start;
+
+    std::stable_sort(render_notes->by_start.begin(), render_notes->by_start.end(), [&](uint32_t a, uint32_t b)
+    {
+        return notes[a].start < notes[b].start;
+    });
+    std::stable_sort(render_notes->by_end.begin(), render_notes->by_end.end(), [&](uint32_t a, uint32_t b)
+    {
+        return notes[a].start + notes[a].length < notes[b].start + notes[b].length;
+    });
+
+    return render_notes;
+}
+
+static std::shared_ptr<const UphRenderNotes> uph_render_snapshot_share_notes(
+    const UphMidiPattern &pattern, const UphRenderSnapshot *previous, size_t index)
+{
+    if (previous && index < previous->patterns.size())
+    {
+        const UphRenderPattern &previous_pattern = previous->patterns[index];
+        if (previous_pattern.notes && previous_pattern.version == pattern.notes_version)
+            return previous_pattern.notes;
+    }
+
+    return uph_render_notes_create(pattern.notes);
+}
+
+static std::shared_ptr<const std::vector<UphTimelineBlock>> uph_render_snapshot_share_blocks(
+    const UphTrack &track, const UphRenderSnapshot *previous, size_t index)
+{
+    if (previous && index < previous->tracks.size())
+    {
+        const UphRenderTrack &previous_track = previous->tracks[index];
+        if (previous_track.timeline_blocks && previous_track.blocks_version == track.blocks_version)
+            return previous_track.timeline_blocks;
+    }
+
+    return std::make_shared<const std::vector<UphTimelineBlock>>(track.timeline_blocks);
+}
+
+static bool uph_track_is_audible(const UphTrack &track)
+{
+    return !track.muted && (app->solo_track_index == -1 || track.solo);
+}
+
+static UviPlugin *uph_track_render_plugin(const UphTrack &track)
+{
+    UviPlugin *plugin = track.instrument.plugin;
+    return (track.track_type == UphTrackType_Midi && plugin && plugin->is_loaded && !track.instrument.is_restarting) ? plugin : nullptr;
+}
+
+static uint32_t uph_track_latency(const UphTrack &track)
+{
+    const UviPlugin *plugin = track.instrument.plugin;
+    if (track.track_type != UphTrackType_Midi || !plugin || !plugin->is_loaded)
+        return 0;
+    return (uint32_t)std::max(0, plugin->latency);
+}
+
+static std::shared_ptr<UphTrackDelay> uph_track_delay_create(uint32_t min_capacity, bool is_double)
+{
+    uint32_t capacity = 1;
+    while (capacity < min_capacity)
+        capacity <<= 1;
+
+    auto delay = std::make_shared<UphTrackDelay>();
+    delay->capacity = capacity;
+    delay->is_double = is_double;
+    for (uint32_t c = 0; c < 2; ++c)
+    {
+        if (is_double)
+            delay->buffer64[c] = std::make_unique<double[]>(capacity);
+        else
+            delay->buffer[c] = std::make_unique<float[]>(capacity);
+    }
+    return delay;
+}
+
+// The compiled events only depend on the track's blocks and the patterns
+// they reference, they still fit while none of those changed.
+static bool uph_track_events_match(const UphTrackEvents *events, const UphRenderTrack &track, const UphRenderSnapshot *snapshot)
+{
+    if (!events || events->timeline_blocks != track.timeline_blocks)
+        return false;
+
+    for (const UphTimelineBlock &block : *track.timeline_blocks)
+    {
+        const bool in_current = block.pattern_index < snapshot->patterns.size();
+        const bool in_compiled = block.pattern_index < events->patterns.size();
+        if (in_current != in_compiled)
+            return false;
+        if (in_current && snapshot->patterns[block.pattern_index].notes != events->patterns[block.pattern_index])
+            return false;
+    }
+    return true;
+}
+
+static std::shared_ptr<UphTrackEvents> uph_track_events_create(const UphRenderTrack &track, const UphRenderSnapshot *snapshot)
+{
+    auto events = std::make_shared<UphTrackEvents>();
+    events->timeline_blocks = track.timeline_blocks;
+    events->patterns.reserve(snapshot->patterns.size());
+    for (const UphRenderPattern &pattern : snapshot->patterns)
+        events->patterns.push_back(pattern.notes);
+    return events;
+}
+
+static size_t uph_track_note_count(const UphRenderTrack &track, const UphRenderSnapshot *snapshot)
+{
+    size_t count = 0;
+    for (const UphTimelineBlock &block : *track.timeline_blocks)
+    {
+        if (block.pattern_index < snapshot->patterns.size())
+            count += snapshot->patterns[block.pattern_index].notes->notes.size();
+    }
+    return count;
+}
+
+// Only reads the inputs held by compiled, so it runs on any thread.
+static void uph_track_events_compile(UphTrackEvents *compiled)
+{
+    std::vector<UphTrackEvent> &events = compiled->events;
+
+    for (const UphTimelineBlock &block : *compiled->timeline_blocks)
+    {
+        if (block.pattern_index >= compiled->patterns.size())
+            continue;
+
+        const double start_time = block.start_time;
+        const double start_offset = block.start_offset;
+        const double instance_end = start_time + block.length;
+
+        for (const UphNote &note : compiled->patterns[block.pattern_index]->notes)
+        {
+            const double original_start = note.start + start_time;
+            const double original_end = original_start + note.length - 0.01;
+
+            const double note_start = std::clamp<double>(original_start - start_offset, start_time, instance_end);
+            const double note_end = std::clamp<double>(original_end - start_offset, 0.0, instance_end);
+            if (note_end <= note_start)
+                continue;
+
+            events.push_back({ note_end, note.key, 0, false });
+            events.push_back({ note_start, note.key, note.velocity, true });
+        }
+    }
+
+    std::stable_sort(events.begin(), events.end(), [](const UphTrackEvent &a, const UphTrackEvent &b)
+    {
+        if (a.beat != b.beat)
+            return a.beat < b.beat;
+        return !a.note_on && b.note_on;
+    });
+}
+
+static void uph_event_compiler_thread(void)
+{
+    std::unique_lock<std::mutex> lock(event_compiler.mutex);
+    for (;;)
+    {
+        event_compiler.wake.wait(lock, [] { return event_compiler.stop || !event_compiler.jobs.empty(); });
+        if (event_compiler.stop)
+            return;
+
+        UphEventCompileJob job = std::move(event_compiler.jobs.front());
+        event_compiler.jobs.pop_front();
+        lock.unlock();
+
+        uph_track_events_compile(job.events.get());
+
+        lock.lock();
+        event_compiler.finished.push_back(std::move(job));
+    }
+}
+
+static void uph_event_compiler_queue(uint32_t track_index, std::shared_ptr<UphTrackEvents> events)
+{
+    std::lock_guard<std::mutex> lock(event_compiler.mutex);
+    if (!event_compiler.thread.joinable())
+        event_compiler.thread = std::thread(uph_event_compiler_thread);
+
+    auto queued = std::find_if(event_compiler.jobs.begin(), event_compiler.jobs.end(),
+        [track_index](const UphEventCompileJob &job) { return job.track_index == track_index; });
+    if (queued != event_compiler.jobs.end())
+        queued->events = std::move(events);
+    else
+        event_compiler.jobs.push_back({ track_index, std::move(events) });
+    event_compiler.wake.notify_one();
+}
+
+// Moves what the compiler finished into compiled_events, returns whether
+// there was anything.
+static bool uph_event_compiler_collect(void)
+{
+    std::lock_guard<std::mutex> lock(event_compiler.mutex);
+    for (UphEventCompileJob &job : event_compiler.finished)
+    {
+        if (job.track_index < compiled_events.size())
+            compiled_events[job.track_index] = std::move(job.events);
+    }
+
+    const bool has_finished = !event_compiler.finished.empty();
+    event_compiler.finished.clear();
+    return has_finished;
+}
+
+static void uph_event_compiler_shutdown(void)
+{
+    {
+        std::lock_guard<std::mutex> lock(event_compiler.mutex);
+        event_compiler.stop = true;
+        event_compiler.wake.notify_one();
+    }
+    if (event_compiler.thread.joinable())
+        event_compiler.thread.join();
+
+    event_compiler.jobs.clear();
+    event_compiler.finished.clear();
+    event_compiler.stop = false;
+    queued_events.clear();
+    compiled_events.clear();
+}
+
+// Events that fit the track, from the previous snapshot, the compiler or
+// compiled here. A large track otherwise gets queued and keeps playing its
+// previous events meanwhile, unless tracks were added or removed and those
+// could belong to another one.
+static std::shared_ptr<const UphTrackEvents> uph_track_events_get(uint32_t track_index, const UphRenderTrack &track,
+    const UphRenderSnapshot *snapshot, const UphRenderSnapshot *previous)
+{
+    std::shared_ptr<const UphTrackEvents> previous_events;
+    if (previous && track_index < previous->tracks.size())
+        previous_events = previous->tracks[track_index].events;
+    if (uph_track_events_match(previous_events.get(), track, snapshot))
+        return previous_events;
+
+    const bool has_previous = previous && previous->tracks.size() == snapshot->tracks.size();
+
+    std::shared_ptr<const UphTrackEvents> &compiled = compiled_events[track_index];
+    if (uph_track_events_match(compiled.get(), track, snapshot))
+        return std::move(compiled);
+    compiled.reset();
+
+    if (!has_previous || is_inline_compile_forced || uph_track_note_count(track, snapshot) < k_inline_compile_notes)
+    {
+        std::shared_ptr<UphTrackEvents> events = uph_track_events_create(track, snapshot);
+        uph_track_events_compile(events.get());
+        return events;
+    }
+
+    std::shared_ptr<const UphTrackEvents> &queued = queued_events[track_index];
+    if (!uph_track_events_match(queued.get(), track, snapshot))
+    {
+        std::shared_ptr<UphTrackEvents> events = uph_track_events_create(track, snapshot);
+        queued = events;
+        uph_event_compiler_queue(track_index, std::move(events));
+    }
+    return previous_events;
+}
+
+// Everything the build reads, notes and timeline blocks by version. Cheap
+// enough to run every frame, unlike the build.
+static bool uph_render_snapshot_is_current(const UphRenderSnapshot *snapshot)
+{
+    const UphProject &project = app->project;
+
+    if (snapshot->volume != project.volume || snapshot->bpm != project.bpm
+        || snapshot->pulse_per_quarter != project.pulse_per_quarter
+        || snapshot->double_precision != project.double_precision
+        || snapshot->export_interpolation != project.export_interpolation
+        || snapshot->current_track_index != app->current_track_index
+        || snapshot->current_pattern_index != app->current_pattern_index
+        || snapshot->patterns.size() != project.patterns.size()
+        || snapshot->samples.size() != project.samples.size()
+        || snapshot->tracks.size() != project.tracks.size())
+        return false;
+
+    for (size_t i = 0; i < project.patterns.size(); ++i)
+    {
+        if (snapshot->patterns[i].version != project.patterns[i].notes_version)
+            return false;
+    }
+
+    for (size_t i = 0; i < project.samples.size(); ++i)
+    {
+        const UphSample &sample = project.samples[i];
+        const UphRenderSample &render_sample = snapshot->samples[i];
+        if (render_sample.type != sample.type || render_sample.sample_rate != sample.sample_rate
+            || render_sample.frames != sample.frames || render_sample.frame_count != sample.frame_count)
+            return false;
+    }
+
+    for (size_t i = 0; i < project.tracks.size(); ++i)
+    {
+        const UphTrack &track = project.tracks[i];
+        const UphRenderTrack &render_track = snapshot->tracks[i];
+        if (render_track.track_type != track.track_type || render_track.is_audible != uph_track_is_audible(track)
+            || render_track.volume != track.volume || render_track.pan != track.pan
+            || render_track.interpolation != track.interpolation
+            || render_track.plugin != uph_track_render_plugin(track)
+            || render_track.latency != uph_track_latency(track)
+            || render_track.blocks_version != track.blocks_version)
+            return false;
+    }
+
+    return true;
+}
+
+static UphRenderSnapshot *uph_render_snapshot_build(const UphRenderSnapshot *previous)
+{
+    const UphProject &project = app->project;
+
+    UphRenderSnapshot *snapshot = new UphRenderSnapshot;
+    snapshot->generation = next_generation++;
+    snapshot->volume = project.volume;
+    snapshot->bpm = project.bpm;
+    snapshot->pulse_per_quarter = project.pulse_per_quarter;
+    snapshot->double_precision = project.double_precision;
+    snapshot->export_interpolation = project.export_interpolation;
+    snapshot->current_track_index = app->current_track_index;
+    snapshot->current_pattern_index = app->current_pattern_index;
+
+    snapshot->patterns.resize(project.patterns.size());
+    for (size_t i = 0; i < project.patterns.size(); ++i)
+    {
+        snapshot->patterns[i].version = project.patterns[i].notes_version;
+        snapshot->patterns[i].notes = uph_render_snapshot_share_notes(project.patterns[i], previous, i);
+    }
+
+    snapshot->samples.reserve(project.samples.size());
+    for (const UphSample &sample : project.samples)
+        snapshot->samples.push_back({ sample.type, sample.sample_rate, sample.frames, sample.frame_count });
+
+    snapshot->compensation = 0;
+    for (const UphTrack &track : project.tracks)
+        snapshot->compensation = std::max(snapshot->compensation, uph_track_latency(track));
+    app->delay_compensation = snapshot->compensation;
+
+    track_runtimes.resize(project.tracks.size());
+    track_delays.resize(project.tracks.size());
+    queued_events.resize(project.tracks.size());
+    compiled_events.resize(project.tracks.size());
+    snapshot->tracks.resize(project.tracks.size());
+    for (size_t i = 0; i < project.tracks.size(); ++i)
+    {
+        const UphTrack &track = project.tracks[i];
+        UphRenderTrack &render_track = snapshot->tracks[i];
+
+        if (!track_runtimes[i])
+            track_runtimes[i] = std::make_shared<UphTrackRuntime>();
+
+        render_track.track_type = track.track_type;
+        render_track.is_audible = uph_track_is_audible(track);
+        render_track.volume = track.volume;
+        render_track.pan = track.pan;
+        render_track.interpolation = track.interpolation;
+        render_track.plugin = uph_track_render_plugin(track);
+        render_track.blocks_version = track.blocks_version;
+        render_track.timeline_blocks = uph_render_snapshot_share_blocks(track, previous, i);
+        render_track.runtime = track_runtimes[i];
+
+        render_track.latency = uph_track_latency(track);
+        render_track.delay = snapshot->compensation - render_track.latency;
+        if (render_track.delay > 0)
+        {
+            const std::shared_ptr<UphTrackDelay> &delay = track_delays[i];
+            if (!delay || delay->capacity < render_track.delay + UPH_ENGINE_BLOCK_SIZE || delay->is_double != snapshot->double_precision)
+                track_delays[i] = uph_track_delay_create(render_track.delay + UPH_ENGINE_BLOCK_SIZE, snapshot->double_precision);
+            render_track.delay_line = track_delays[i];
+        }
+        else
+        {
+            track_delays[i].reset();
+        }
+
+        if (track.track_type == UphTrackType_Midi)
+            render_track.events = uph_track_events_get((uint32_t)i, render_track, snapshot, previous);
+    }
+
+    is_inline_compile_forced = false;
+    return snapshot;
+}
+
+static void uph_render_snapshot_reclaim(void)
+{
+    UphRenderSnapshot *published = published_snapshot.load();
+    UphRenderSnapshot *in_use = audio_snapshot.load();
+
+    retired_snapshots.erase(std::remove_if(retired_snapshots.begin(), retired_snapshots.end(),
+        [in_use](UphRenderSnapshot *snapshot)
+        {
+            if (snapshot == in_use)
+                return false;
+            delete snapshot;
+            return true;
+        }),
+        retired_snapshots.end());
+
+    // Anything deferred while generation G was published may still be
+    // referenced by G, so it waits until the audio thread is past it.
+    const uint64_t oldest_live = in_use ? in_use->generation : published ? published->generation : UINT64_MAX;
+
+    size_t kept = 0;
+    for (size_t i = 0; i < deferred_frees.size(); ++i)
+    {
+        UphDeferredFree &deferred = deferred_frees[i];
+        if (deferred.generation < oldest_live)
+            deferred.free_func(deferred.data);
+        else
+            deferred_frees[kept++] = deferred;
+    }
+    deferred_frees.resize(kept);
+}
+
+static void uph_render_snapshot_sync_meters(const UphRenderSnapshot *snapshot)
+{
+    std::vector<UphTrack> &tracks = app->project.tracks;
+    const size_t count = std::min(tracks.size(), snapshot->tracks.size());
+    for (size_t i = 0; i < count; ++i)
+    {
+        const UphTrackRuntime *runtime = snapshot->tracks[i].runtime.get();
+        tracks[i].peak_left = runtime->peak_left.load(std::memory_order_relaxed);
+        tracks[i].peak_right = runtime->peak_right.load(std::memory_order_relaxed);
+        tracks[i].is_sleeping = runtime->is_sleeping.load(std::memory_order_relaxed);
+    }
+}
+
+void uph_render_snapshot_publish(void)
+{
+    UphRenderSnapshot *previous = published_snapshot.load();
+    if (previous)
+        uph_render_snapshot_sync_meters(previous);
+
+    if (uph_event_compiler_collect())
+        is_publish_forced = true;
+
+    if (!previous || is_publish_forced || !uph_render_snapshot_is_current(previous))
+    {
+        is_publish_forced = false;
+        UphRenderSnapshot *snapshot = uph_render_snapshot_build(previous);
+        previous = published_snapshot.exchange(snapshot);
+        if (previous)
+            retired_snapshots.push_back(previous);
+    }
+
+    uph_render_snapshot_reclaim();
+}
+
+void uph_render_snapshot_publish_complete(void)
+{
+    is_inline_compile_forced = true;
+    is_publish_forced = true;
+    uph_render_snapshot_publish();
+}
+
+void uph_render_snapshot_defer_free(UphDeferredFreeFunc free_func, void *data)
+{
+    const UphRenderSnapshot *published = published_snapshot.load();
+    deferred_frees.push_back({ published ? published->generation : 0, free_func, data });
+
+    // Freed once the audio thread is past that generation, so there has to
+    // be a newer one.
+    is_publish_forced = true;
+}
+
+// Only valid once the audio device is stopped.
+void uph_render_snapshot_shutdown(void)
+{
+    uph_event_compiler_shutdown();
+
+    for (UphDeferredFree &deferred : deferred_frees)
+        deferred.free_func(deferred.data);
+    deferred_frees.clear();
+
+    for (UphRenderSnapshot *snapshot : retired_snapshots)
+        delete snapshot;
+    retired_snapshots.clear();
+
+    delete published_snapshot.exchange(nullptr);
+    track_runtimes.clear();
+    track_delays.clear();
+}
+
+void uph_render_snapshot_forget_tracks(void)
+{
+    track_runtimes.clear();
+    track_delays.clear();
+    is_publish_forced = true;
+    is_inline_compile_forced = true;
+}
+
+void uph_render_snapshot_reset_tracks(void)
+{
+    for (const std::shared_ptr<UphTrackRuntime> &runtime : track_runtimes)
+    {
+        if (!runtime)
+            continue;
+        runtime->scheduled_block_end = -1.0;
+        runtime->quiet_frames = 0;
+        runtime->is_sleeping.store(false);
+    }
+
+    for (const std::shared_ptr<UphTrackDelay> &delay : track_delays)
+    {
+        if (delay)
+            uph_track_delay_clear(delay.get());
+    }
+}
+
+void uph_track_delay_clear(UphTrackDelay *delay)
+{
+    for (uint32_t c = 0; c < 2; ++c)
+    {
+        if (delay->is_double)
+            std::fill_n(delay->buffer64[c].get(), delay->capacity, 0.0);
+        else
+            std::fill_n(delay->buffer[c].get(), delay->capacity, 0.0f);
+    }
+    delay->write_pos = 0;
+    delay->pending = 0;
+}
+
+const UphRenderSnapshot *uph_render_snapshot_acquire(void)
+{
+    UphRenderSnapshot *snapshot = published_snapshot.load();
+    for (;;)
+    {
+        audio_snapshot.store(snapshot);
+        UphRenderSnapshot *latest = published_snapshot.load();
+        if (latest == snapshot)
+            return snapshot;
+        snapshot = latest;
+    }
+}
+
+void uph_render_snapshot_release(void)
+{
+    audio_snapshot.store(nullptr);
+}
@@ -0,0 +1,163 @@
+#pragma once
+
+#include "types.h"
+#include "engine.h"
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+// Immutable copy of everything the audio thread needs from the project.
+// The UI thread builds a new snapshot whenever the project changed and
+// publishes it with a single pointer swap, the audio thread only ever reads
+// the published one.
+
+// Per-track state written by the audio thread. It outlives individual
+// snapshots so meters don't reset on every publish.
+struct UphTrackRuntime
+{
+    std::atomic<float> peak_left = 0.0f;
+    std::atomic<float> peak_right = 0.0f;
+
+    // Set once the plugin has been idle and quiet for long enough, it is
+    // skipped until something gets queued for it.
+    std::atomic<bool> is_sleeping = false;
+    uint32_t quiet_frames = 0;
+
+    bool has_output = false;
+    uint32_t event_cursor = 0;
+
+    // Events up to scheduled_beat are already queued. It only carries over
+    // when the next block starts where scheduled_block_end left off.
+    double scheduled_beat = 0.0;
+    double scheduled_block_end = -1.0;
+
+    // Only the buffers matching the snapshot's precision hold the block.
+    alignas(64) float output[2][UPH_ENGINE_BLOCK_SIZE];
+    alignas(64) double output64[2][UPH_ENGINE_BLOCK_SIZE];
+};
+
+// Ring buffer holding a track back so it lines up with the most latent
+// track. Replaced rather than resized when it needs to grow, the contents
+// are only touched by the audio thread.
+struct UphTrackDelay
+{
+    uint32_t capacity;      // power of two, at least delay + one block
+    uint32_t write_pos = 0;
+    uint32_t delay = 0;     // delay the line was last run with
+    uint32_t pending = 0;   // frames until everything written so far has been read out
+    bool is_double;         // which of the buffer pairs is allocated
+    std::unique_ptr<float[]> buffer[2];
+    std::unique_ptr<double[]> buffer64[2];
+};
+
+// Notes keep the project order, the index arrays let the scheduler binary
+// search the notes of a block.
+struct UphRenderNotes
+{
+    std::vector<UphNote> notes;
+    std::vector<uint32_t> by_start; // sorted by start
+    std::vector<uint32_t> by_end;   // sorted by start + length
+    float max_length;
+};
+
+struct UphRenderPattern
+{
+    uint64_t version;   // the pattern's notes_version
+    std::shared_ptr<const UphRenderNotes> notes;
+};
+
+// Every pattern instance on a track flattened into absolute song beats,
+// sorted by beat with note offs ahead of note ons on the same beat.
+struct UphTrackEvent
+{
+    double beat;
+    uint8_t key;
+    uint8_t velocity;
+    bool note_on;
+};
+
+struct UphTrackEvents
+{
+    std::vector<UphTrackEvent> events;
+
+    // What they were compiled from, held so comparing pointers stays valid.
+    std::shared_ptr<const std::vector<UphTimelineBlock>> timeline_blocks;
+    std::vector<std::shared_ptr<const UphRenderNotes>> patterns;
+};
+
+struct UphRenderSample
+{
+    UphSampleType type;
+    float sample_rate;
+    const float *frames;
+    uint64_t frame_count;
+};
+
+struct UphRenderTrack
+{
+    UphTrackType track_type;
+    bool is_audible;
+    float volume, pan;
+    UphInterpolation interpolation;
+    UviPlugin *plugin;
+    uint64_t blocks_version;
+    std::shared_ptr<const std::vector<UphTimelineBlock>> timeline_blocks;
+    std::shared_ptr<const UphTrackEvents> events;
+    std::shared_ptr<UphTrackRuntime> runtime;
+
+    // Frames of plugin latency, and how far the output is held back so it
+    // lands together with the most latent track.
+    uint32_t latency;
+    uint32_t delay;
+    std::shared_ptr<UphTrackDelay> delay_line;
+};
+
+struct UphRenderSnapshot
+{
+    uint64_t generation;
+    float volume, bpm;
+    int pulse_per_quarter;
+    bool double_precision;
+    UphInterpolation export_interpolation;
+    uint32_t current_track_index;
+    uint32_t current_pattern_index;
+
+    // Largest track latency. Tracks are scheduled this many frames ahead
+    // of the transport and delayed back, so every output lines up with it.
+    uint32_t compensation;
+
+    std::vector<UphRenderTrack> tracks;
+    std::vector<UphRenderPattern> patterns;
+    std::vector<UphRenderSample> samples;
+};
+
+typedef void (*UphDeferredFreeFunc)(void *data);
+
+// UI thread. Publishing is skipped while the project matches the published
+// snapshot, unchanged patterns and tracks are shared with it otherwise.
+// Tracks with many notes compile their events on a background thread and
+// keep the previous ones until a later publish picks the result up.
+void uph_render_snapshot_publish(void);
+
+// Publishes with every track's events compiled on the spot, for renders
+// that can't wait for the background, such as an export.
+void uph_render_snapshot_publish_complete(void);
+void uph_render_snapshot_defer_free(UphDeferredFreeFunc free_func, void *data);
+void uph_render_snapshot_shutdown(void);
+
+// Only valid while the audio device is stopped. Empties the delay lines and
+// makes the next block a jump for every track, which chases held notes.
+void uph_render_snapshot_reset_tracks(void);
+
+// Silences a delay line and starts it over, by whichever thread owns it.
+void uph_track_delay_clear(UphTrackDelay *delay);
+
+// Drops the per-track runtimes and delay lines when the project is replaced,
+// the next snapshot starts every track from scratch. Snapshots already
+// published keep their own references, so the device can stay running.
+void uph_render_snapshot_forget_tracks(void);
+
+// Audio thread, the snapshot stays valid until the matching release.
+const UphRenderSnapshot *uph_render_snapshot_acquire(void);
+void uph_render_snapshot_release(void);
@@ -0,0 +1,124 @@
+#include "resampler.h"
+#include "dsp_kernels.h"
+#include "interpolation.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <memory>
+#include <numeric>
+
+// Flat to about 0.45 of the lower rate, down by about 100 dB from its
+// Nyquist frequency on.
+static constexpr uint32_t k_phase_count = 128;
+static constexpr uint32_t k_unity_taps = 96;   // grows as the cutoff drops below the input Nyquist
+static constexpr double k_kaiser_beta = 9.0;
+static constexpr double k_cutoff = 0.48;       // of the lower rate
+
+struct UphResampler
+{
+    uint32_t input_rate, output_rate;   // reduced by their gcd
+    uint32_t step_int, step_num;        // input frames per output frame
+    uint32_t tap_count;
+    uint32_t max_output_frames, max_render;
+
+    UphSincTable table;                 // stereo, k_phase_count phases
+
+    // Interleaved. The next output's window starts at frame pos_int and is
+    // pos_num / output_rate of a frame past it.
+    std::unique_ptr<float[]> input;
+    uint32_t input_frames;
+    uint32_t pos_int, pos_num;
+};
+
+UphResampler *uph_resampler_create(uint32_t input_rate, uint32_t output_rate, uint32_t max_output_frames)
+{
+    if (input_rate == 0 || output_rate == 0)
+        return nullptr;
+
+    UphResampler *resampler = new UphResampler{};
+    const uint32_t divisor = std::gcd(input_rate, output_rate);
+    resampler->input_rate = input_rate / divisor;
+    resampler->output_rate = output_rate / divisor;
+    resampler->step_int = resampler->input_rate / resampler->output_rate;
+    resampler->step_num = resampler->input_rate % resampler->output_rate;
+
+    // The cutoff is in cycles per input frame, below the output's Nyquist
+    // when going down so nothing folds back.
+    const double scale = std::min(1.0, (double)output_rate / input_rate);
+    resampler->tap_count = ((uint32_t)std::ceil(k_unity_taps / scale) + 7) & ~7u;
+    uph_sinc_table_build(&resampler->table, resampler->tap_count, k_phase_count, k_cutoff * scale, k_kaiser_beta, 2);
+
+    resampler->max_output_frames = std::max<uint32_t>(max_output_frames, 1);
+    resampler->max_render = (uint32_t)((uint64_t)(resampler->max_output_frames - 1) * resampler->input_rate / resampler->output_rate)
+        + 1 + resampler->tap_count;
+    resampler->input = std::make_unique<float[]>((size_t)(resampler->max_render + resampler->tap_count) * 2);
+
+    // Half a window of silence ahead of the first rendered frame.
+    resampler->input_frames = resampler->tap_count / 2 - 1;
+    return resampler;
+}
+
+void uph_resampler_destroy(UphResampler *resampler)
+{
+    delete resampler;
+}
+
+void uph_resampler_process(UphResampler *resampler, float *output, uint32_t frame_count,
+    UphResamplerRenderFunc render, void *user)
+{
+    const UphDspKernels *dsp = uph_dsp_kernels();
+    const uint32_t tap_count = resampler->tap_count;
+    const float phase_scale = (float)k_phase_count / (float)resampler->output_rate;
+    float *input = resampler->input.get();
+
+    while (frame_count > 0)
+    {
+        const uint32_t count = std::min(frame_count, resampler->max_output_frames);
+
+        // The last output's window has to be there in full.
+        const uint64_t last_num = resampler->pos_num + (uint64_t)(count - 1) * resampler->step_num;
+        const uint64_t last_start = resampler->pos_int + (uint64_t)(count - 1) * resampler->step_int
+            + last_num / resampler->output_rate;
+        const uint32_t needed = (uint32_t)(last_start + tap_count);
+        if (needed > resampler->input_frames)
+        {
+            const uint32_t render_count = needed - resampler->input_frames;
+            float *render_output = input + (size_t)resampler->input_frames * 2;
+            memset(render_output, 0, (size_t)render_count * 2 * sizeof(float));
+            render(render_output, render_count, user);
+            resampler->input_frames = needed;
+        }
+
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            const float phase = (float)resampler->pos_num * phase_scale;
+            const uint32_t row = std::min((uint32_t)phase, k_phase_count - 1);
+            const size_t offset = (size_t)row * tap_count * 2;
+            dsp->convolve_stereo(input + (size_t)resampler->pos_int * 2, resampler->table.taps.get() + offset,
+                resampler->table.deltas.get() + offset, phase - (float)row, tap_count, &output[i * 2], &output[i * 2 + 1]);
+
+            resampler->pos_int += resampler->step_int;
+            resampler->pos_num += resampler->step_num;
+            if (resampler->pos_num >= resampler->output_rate)
+            {
+                resampler->pos_num -= resampler->output_rate;
+                ++resampler->pos_int;
+            }
+        }
+
+        // Less than a window is left, keep it at the front.
+        const uint32_t consumed = std::min(resampler->pos_int, resampler->input_frames);
+        memmove(input, input + (size_t)consumed * 2, (size_t)(resampler->input_frames - consumed) * 2 * sizeof(float));
+        resampler->input_frames -= consumed;
+        resampler->pos_int -= consumed;
+
+        output += (size_t)count * 2;
+        frame_count -= count;
+    }
+}
+
+uint32_t uph_resampler_max_render(const UphResampler *resampler)
+{
+    return resampler->max_render;
+}
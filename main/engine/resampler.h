@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstdint>
+
+// Streaming stereo sample rate converter between the engine and the device.
+// Kaiser windowed sinc, polyphase with linear interpolation between phases,
+// convolved by the dsp kernels. The position is kept as an exact fraction
+// of the two rates, so it never drifts however long it runs.
+
+struct UphResampler;
+
+// Fills frame_count interleaved stereo frames of zeroed output at the input
+// rate, for the resampler to pull from.
+typedef void (*UphResamplerRenderFunc)(float *output, uint32_t frame_count, void *user);
+
+// Calls for more than max_output_frames are split, so nothing is allocated
+// after creation.
+UphResampler *uph_resampler_create(uint32_t input_rate, uint32_t output_rate, uint32_t max_output_frames);
+void uph_resampler_destroy(UphResampler *resampler);
+
+// Writes frame_count interleaved stereo frames at the output rate.
+void uph_resampler_process(UphResampler *resampler, float *output, uint32_t frame_count,
+    UphResamplerRenderFunc render, void *user);
+
+// Most frames a single render call asks for.
+uint32_t uph_resampler_max_render(const UphResampler *resampler);
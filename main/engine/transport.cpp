@@ -0,0 +1,69 @@
+#include "transport.h"
+
+#include <cmath>
+
+void uph_transport_seek(UphTransport *transport, double beat)
+{
+    transport->seek_beat.store(beat, std::memory_order_relaxed);
+    transport->seek_pending.store(true, std::memory_order_release);
+    transport->beat.store(beat, std::memory_order_relaxed);
+}
+
+double uph_transport_beat(const UphTransport *transport)
+{
+    return transport->beat.load(std::memory_order_relaxed);
+}
+
+int64_t uph_transport_tick(const UphTransport *transport)
+{
+    return transport->tick.load(std::memory_order_relaxed);
+}
+
+static void uph_transport_publish(UphTransport *transport, uint64_t frame)
+{
+    const double beat = uph_transport_beat_at(transport, frame);
+    transport->beat.store(beat, std::memory_order_relaxed);
+    transport->tick.store((int64_t)std::floor(beat * transport->pulse_per_quarter), std::memory_order_relaxed);
+}
+
+bool uph_transport_begin_block(UphTransport *transport, float bpm, int pulse_per_quarter, float sample_rate)
+{
+    const uint64_t frame = transport->frame.load(std::memory_order_relaxed);
+    const double frames_per_beat = 60.0 * (double)sample_rate / (double)bpm;
+
+    const bool is_seek = transport->seek_pending.exchange(false, std::memory_order_acquire);
+    if (is_seek)
+    {
+        transport->frame.store(0, std::memory_order_relaxed);
+        transport->anchor_frame = 0;
+        transport->anchor_beat = transport->seek_beat.load(std::memory_order_relaxed);
+    }
+    else if (transport->frames_per_beat > 0.0 && frames_per_beat != transport->frames_per_beat)
+    {
+        transport->anchor_beat = uph_transport_beat_at(transport, frame);
+        transport->anchor_frame = frame;
+    }
+
+    transport->frames_per_beat = frames_per_beat;
+
+    // Published here too so a stopped transport follows seeks and a
+    // changed pulse_per_quarter.
+    if (is_seek || pulse_per_quarter != transport->pulse_per_quarter)
+    {
+        transport->pulse_per_quarter = pulse_per_quarter;
+        uph_transport_publish(transport, transport->frame.load(std::memory_order_relaxed));
+    }
+    return is_seek;
+}
+
+double uph_transport_beat_at(const UphTransport *transport, uint64_t frame)
+{
+    return transport->anchor_beat + (double)(frame - transport->anchor_frame) / transport->frames_per_beat;
+}
+
+void uph_transport_advance(UphTransport *transport, uint32_t frame_count)
+{
+    const uint64_t frame = transport->frame.load(std::memory_order_relaxed) + frame_count;
+    transport->frame.store(frame, std::memory_order_relaxed);
+    uph_transport_publish(transport, frame);
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+// Playback position counted in whole sample frames. Beats and ticks, at the
+// project's pulse_per_quarter, are derived from the frame count in double
+// precision, so event placement
+// doesn't drift no matter how long playback runs and a render of the same
+// project always lands every event on the same frame.
+
+struct UphTransport
+{
+    // Published by the audio thread after every block, read by the UI.
+    std::atomic<uint64_t> frame = 0;
+    std::atomic<double> beat = 0.0;
+    std::atomic<int64_t> tick = 0;
+
+    // Requested by the UI, applied at the start of the next block.
+    std::atomic<double> seek_beat = 0.0;
+    std::atomic<bool> seek_pending = false;
+
+    // Tempo anchor, only touched by the audio thread. Tempo changes move
+    // the anchor so the beat position stays continuous.
+    uint64_t anchor_frame = 0;
+    double anchor_beat = 0.0;
+    double frames_per_beat = 0.0;
+    int pulse_per_quarter = 0;
+};
+
+// UI thread
+void uph_transport_seek(UphTransport *transport, double beat);
+double uph_transport_beat(const UphTransport *transport);
+int64_t uph_transport_tick(const UphTransport *transport);
+
+// Audio thread. Returns true when the block starts at a seek.
+bool uph_transport_begin_block(UphTransport *transport, float bpm, int pulse_per_quarter, float sample_rate);
+double uph_transport_beat_at(const UphTransport *transport, uint64_t frame);
+void uph_transport_advance(UphTransport *transport, uint32_t frame_count);
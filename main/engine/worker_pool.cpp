@@ -0,0 +1,280 @@
+#include "worker_pool.h"
+#include "realtime.h"
+
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#if defined(_M_X64) || defined(__x86_64__) || defined(_M_IX86) || defined(__i386__)
+#include <immintrin.h>
+#define UPH_CPU_RELAX() _mm_pause()
+#else
+#define UPH_CPU_RELAX() std::this_thread::yield()
+#endif
+
+static constexpr uint32_t k_spin_iterations = 4096;
+
+// next job in the high half, end in the low half so a claim is a single CAS
+// and a stale claim can never pair a new index with an old bound.
+struct alignas(64) UphWorkerRange
+{
+    std::atomic<uint64_t> range = 0;
+};
+
+struct UphWorkerPool
+{
+    std::vector<std::thread> threads;
+    std::unique_ptr<UphWorkerRange[]> ranges;
+    uint32_t participant_count = 1;
+
+    UphWorkerJobFunc func = nullptr;
+    void *user = nullptr;
+
+    alignas(64) std::atomic<uint32_t> epoch = 0;
+    alignas(64) std::atomic<uint32_t> remaining = 0;
+    std::atomic<uint32_t> sleeping = 0;
+    std::atomic<bool> running = false;
+
+    // One nested run at a time, started by a job that fans out further.
+    // Generation in the high half, job count and next job in the low half
+    // so a claim can never pair a new index with an old run.
+    alignas(64) std::atomic<uint64_t> nested = 0;
+    std::atomic<UphWorkerJobFunc> nested_func = nullptr;
+    std::atomic<void*> nested_user = nullptr;
+    std::atomic<uint32_t> nested_remaining = 0;
+    std::atomic<bool> nested_busy = false;
+};
+
+static UphWorkerPool pool;
+
+static thread_local uint32_t tls_worker_index = 0;
+static thread_local uint32_t tls_job_depth = 0;
+
+static void uph_worker_pool_call(UphWorkerJobFunc func, void *user, uint32_t job_index, uint32_t worker_index)
+{
+    ++tls_job_depth;
+    func(user, job_index, worker_index);
+    --tls_job_depth;
+}
+
+static bool uph_worker_pool_claim(UphWorkerRange &range, uint32_t *job_index)
+{
+    uint64_t value = range.range.load(std::memory_order_acquire);
+    for (;;)
+    {
+        const uint32_t next = (uint32_t)(value >> 32);
+        const uint32_t end = (uint32_t)value;
+        if (next >= end)
+            return false;
+
+        if (range.range.compare_exchange_weak(value, value + (1ull << 32), std::memory_order_acq_rel))
+        {
+            *job_index = next;
+            return true;
+        }
+    }
+}
+
+static void uph_worker_pool_drain(uint32_t worker_index)
+{
+    uint32_t job_index;
+    for (uint32_t i = 0; i < pool.participant_count; ++i)
+    {
+        UphWorkerRange &range = pool.ranges[(worker_index + i) % pool.participant_count];
+        while (uph_worker_pool_claim(range, &job_index))
+        {
+            uph_worker_pool_call(pool.func, pool.user, job_index, worker_index);
+            pool.remaining.fetch_sub(1, std::memory_order_acq_rel);
+        }
+    }
+}
+
+// Runs one job of the nested run if there is one left, returns false
+// otherwise.
+static bool uph_worker_pool_help_nested(uint32_t worker_index)
+{
+    uint64_t value = pool.nested.load(std::memory_order_acquire);
+    for (;;)
+    {
+        const uint32_t next = (uint32_t)(value & 0xFFFF);
+        const uint32_t count = (uint32_t)((value >> 16) & 0xFFFF);
+        if (next >= count)
+            return false;
+
+        // Only used when the claim succeeds, which proves the run they
+        // were published with is still the current one.
+        UphWorkerJobFunc func = pool.nested_func.load(std::memory_order_relaxed);
+        void *user = pool.nested_user.load(std::memory_order_relaxed);
+
+        if (pool.nested.compare_exchange_weak(value, value + 1, std::memory_order_acq_rel))
+        {
+            uph_worker_pool_call(func, user, next, worker_index);
+            pool.nested_remaining.fetch_sub(1, std::memory_order_acq_rel);
+            return true;
+        }
+    }
+}
+
+static void uph_worker_pool_wake(void)
+{
+    pool.epoch.fetch_add(1, std::memory_order_acq_rel);
+    if (pool.sleeping.load(std::memory_order_acquire) > 0)
+        pool.epoch.notify_all();
+}
+
+// A job asked to fan out while the pool is already running its own
+// dispatch. Idle workers and the waiting dispatcher pick the jobs up, if
+// another nested run is in flight the jobs run serially instead.
+static void uph_worker_pool_run_nested(UphWorkerJobFunc func, void *user, uint32_t job_count)
+{
+    if (job_count > 0xFFFF || pool.nested_busy.exchange(true, std::memory_order_acquire))
+    {
+        for (uint32_t i = 0; i < job_count; ++i)
+            uph_worker_pool_call(func, user, i, tls_worker_index);
+        return;
+    }
+
+    pool.nested_func.store(func, std::memory_order_relaxed);
+    pool.nested_user.store(user, std::memory_order_relaxed);
+    pool.nested_remaining.store(job_count, std::memory_order_relaxed);
+
+    const uint64_t generation = (pool.nested.load(std::memory_order_relaxed) >> 32) + 1;
+    pool.nested.store((generation << 32) | ((uint64_t)job_count << 16), std::memory_order_release);
+    uph_worker_pool_wake();
+
+    while (uph_worker_pool_help_nested(tls_worker_index))
+        ;
+
+    uint32_t spins = 0;
+    while (pool.nested_remaining.load(std::memory_order_acquire) != 0)
+    {
+        if (++spins < k_spin_iterations)
+            UPH_CPU_RELAX();
+        else
+            std::this_thread::yield();
+    }
+
+    pool.nested_busy.store(false, std::memory_order_release);
+}
+
+static void uph_worker_pool_thread(uint32_t worker_index)
+{
+    tls_worker_index = worker_index;
+    uph_realtime_setup_thread(UphRealtimeRole_Worker, worker_index);
+
+    uint32_t seen = pool.epoch.load(std::memory_order_acquire);
+    while (pool.running.load(std::memory_order_acquire))
+    {
+        uint32_t spins = 0;
+        while (pool.epoch.load(std::memory_order_acquire) == seen && spins < k_spin_iterations)
+        {
+            if (uph_worker_pool_help_nested(worker_index))
+                spins = 0;
+            else
+                UPH_CPU_RELAX();
+            ++spins;
+        }
+
+        if (pool.epoch.load(std::memory_order_acquire) == seen)
+        {
+            pool.sleeping.fetch_add(1, std::memory_order_acq_rel);
+            pool.epoch.wait(seen, std::memory_order_acquire);
+            pool.sleeping.fetch_sub(1, std::memory_order_acq_rel);
+        }
+
+        seen = pool.epoch.load(std::memory_order_acquire);
+        if (!pool.running.load(std::memory_order_acquire))
+            break;
+
+        uph_realtime_setup_thread(UphRealtimeRole_Worker, worker_index);
+        uph_realtime_flush_denormals();
+        uph_worker_pool_drain(worker_index);
+        while (uph_worker_pool_help_nested(worker_index))
+            ;
+    }
+
+    uph_realtime_thread_stopped(worker_index);
+}
+
+void uph_worker_pool_initialize(uint32_t thread_count)
+{
+    uph_worker_pool_shutdown();
+
+    pool.participant_count = thread_count + 1;
+    pool.ranges = std::make_unique<UphWorkerRange[]>(pool.participant_count);
+    pool.running.store(true);
+
+    for (uint32_t i = 0; i < thread_count; ++i)
+        pool.threads.emplace_back(uph_worker_pool_thread, i + 1);
+}
+
+void uph_worker_pool_shutdown(void)
+{
+    if (pool.threads.empty())
+        return;
+
+    pool.running.store(false);
+    pool.epoch.fetch_add(1, std::memory_order_acq_rel);
+    pool.epoch.notify_all();
+
+    for (std::thread &thread : pool.threads)
+        thread.join();
+    pool.threads.clear();
+    pool.participant_count = 1;
+}
+
+uint32_t uph_worker_pool_thread_count(void)
+{
+    return (uint32_t)pool.threads.size();
+}
+
+uint32_t uph_worker_pool_participant_count(void)
+{
+    return pool.participant_count;
+}
+
+void uph_worker_pool_run(UphWorkerJobFunc func, void *user, uint32_t job_count)
+{
+    if (pool.threads.empty() || job_count <= 1)
+    {
+        for (uint32_t i = 0; i < job_count; ++i)
+            uph_worker_pool_call(func, user, i, tls_worker_index);
+        return;
+    }
+
+    if (tls_job_depth > 0)
+    {
+        uph_worker_pool_run_nested(func, user, job_count);
+        return;
+    }
+
+    pool.func = func;
+    pool.user = user;
+    pool.remaining.store(job_count, std::memory_order_relaxed);
+
+    const uint32_t participants = pool.participant_count;
+    for (uint32_t i = 0; i < participants; ++i)
+    {
+        const uint64_t begin = (uint64_t)job_count * i / participants;
+        const uint64_t end = (uint64_t)job_count * (i + 1) / participants;
+        pool.ranges[i].range.store((begin << 32) | end, std::memory_order_release);
+    }
+
+    uph_worker_pool_wake();
+
+    uph_worker_pool_drain(0);
+
+    // Jobs still running elsewhere, give the core away if they take long
+    // so an oversubscribed machine doesn't starve the workers we wait on.
+    uint32_t spins = 0;
+    while (pool.remaining.load(std::memory_order_acquire) != 0)
+    {
+        if (uph_worker_pool_help_nested(0))
+            spins = 0;
+        else if (++spins < k_spin_iterations)
+            UPH_CPU_RELAX();
+        else
+            std::this_thread::yield();
+    }
+}
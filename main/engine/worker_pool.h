@@ -0,0 +1,22 @@
+#pragma once
+
+#include <cstdint>
+
+// Pre-spawned pool for fanning independent jobs out from the audio thread.
+// uph_worker_pool_run never allocates or locks, the calling thread takes
+// part in the work and steals from the other workers once its own share
+// is done. A job may call uph_worker_pool_run again, those jobs are picked
+// up by whichever participants are idle.
+
+typedef void (*UphWorkerJobFunc)(void *user, uint32_t job_index, uint32_t worker_index);
+
+// A thread count of 0 runs every job serially, in order, on the caller.
+void uph_worker_pool_initialize(uint32_t thread_count);
+void uph_worker_pool_shutdown(void);
+
+uint32_t uph_worker_pool_thread_count(void);
+
+// Number of distinct worker_index values a job can observe.
+uint32_t uph_worker_pool_participant_count(void);
+
+void uph_worker_pool_run(UphWorkerJobFunc func, void *user, uint32_t job_count);
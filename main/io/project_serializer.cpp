@@ -1,5 +1,8 @@
 #include "../types.h"
+#include "../plugin_loader.h"
+#include "../engine/render_snapshot.h"
 #include <nlohmann/json.hpp>
+#include <algorithm>
 #include <fstream>
 #include <iostream>
 
@@ -53,6 +56,7 @@ static json serialize_track(const UphTrack& t) {
     j["pan"]    = t.pan;
     j["pitch"]  = t.pitch;
     j["muted"]  = t.muted;
+    j["interpolation"] = t.interpolation;
     j["color"]  = t.color;
     j["track_type"] = (t.track_type == UphTrackType_Midi ? "midi" : "sample");
     j["instrument_path"] = t.instrument.path;
@@ -68,6 +72,9 @@ static json serialize_project(const UphProject& p)
     json j;
     j["volume"] = p.volume;
     j["bpm"]    = p.bpm;
+    j["double_precision"] = p.double_precision;
+    j["processing_rate"] = p.processing_rate;
+    j["export_interpolation"] = p.export_interpolation;
 
     for (auto& pat : p.patterns)
         j["patterns"].push_back(serialize_pattern(pat));
@@ -141,6 +148,7 @@ static UphTrack deserialize_track(const json& jt) {
     t.pan        = jt.value("pan", 0.0f);
     t.pitch      = jt.value("pitch", 0.0f);
     t.muted      = jt.value("muted", false);
+    t.interpolation = (UphInterpolation)std::clamp<int>(jt.value("interpolation", (int)UphInterpolation_Cubic), 0, UphInterpolation_Count - 1);
     t.color      = jt.value("color", 0xFFFFFFFF);
     t.track_type = (jt.value("track_type", "midi") == "midi") ? UphTrackType_Midi : UphTrackType_Sample;
 
@@ -159,11 +167,27 @@ static UphTrack deserialize_track(const json& jt) {
     return t;
 }
 
+// Anything not offered in the settings would open the device at a rate it
+// may not support, so it falls back to the device's.
+static uint32_t deserialize_processing_rate(const json& j)
+{
+    const uint32_t rate = j.value("processing_rate", 0u);
+    for (uint32_t supported : uph_processing_rates)
+    {
+        if (rate == supported)
+            return rate;
+    }
+    return 0;
+}
+
 static UphProject deserialize_project(const json& j) 
 {
     UphProject p{};
     p.volume = j.value("volume", 0.5f);
     p.bpm    = j.value("bpm", 120.0f);
+    p.double_precision = j.value("double_precision", false);
+    p.processing_rate = deserialize_processing_rate(j);
+    p.export_interpolation = (UphInterpolation)std::clamp<int>(j.value("export_interpolation", (int)UphInterpolation_Sinc), 0, UphInterpolation_Count - 1);
 
 	p.tracks.clear();
 	p.patterns.clear();
@@ -212,6 +236,14 @@ void uph_project_serializer_save_json(const std::filesystem::path& path, const c
 	out.close();
 }
 
+// Anything keyed by track position belongs to the outgoing project.
+static void uph_project_replace(UphProject &&project)
+{
+    uph_plugin_loader_release_project();
+    uph_render_snapshot_forget_tracks();
+    app->project = std::move(project);
+}
+
 void uph_project_serializer_load_json(const std::filesystem::path& path) {
     if (!std::filesystem::exists(path)) {
         std::cerr << "No file found at " << path << "\n";
@@ -227,12 +259,11 @@ void uph_project_serializer_load_json(const std::filesystem::path& path) {
     json j;
     in >> j;
 
-    app->project = deserialize_project(j);
+    uph_project_replace(deserialize_project(j));
 }
 
 
 void uph_project_clear()
 {
-	UphProject p{};
-	app->project = p;
+	uph_project_replace(UphProject{});
 }
\ No newline at end of file
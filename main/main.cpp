@@ -6,9 +6,16 @@
 
 #include <iostream>
 #include <filesystem>
+#include <cstring>
+#include <cstdlib>
 
 #include "sound_device.h"
 #include "plugin_loader.h"
+#include "plugin_scanner.h"
+#include "engine/engine.h"
+#include "engine/profiler.h"
+#include "engine/realtime.h"
+#include "engine/render_snapshot.h"
 
 #include "panels/panel_manager.h"
 #include "io/layout_manager.h"
@@ -35,6 +42,10 @@ static void uph_render(void)
 
 int main(const int argc, const char **argv)
 {
+    // Started by the plugin scanner, see plugin_scanner.h.
+    if (argc > 2 && strcmp(argv[1], UPH_PLUGIN_PROBE_ARG) == 0)
+        return uph_plugin_scanner_probe(argv[2]);
+
     UphPlatformCreateInfo create_info = { 1920, 1080, "Uphonic" };
 
     ImGui::CreateContext();
@@ -70,7 +81,42 @@ int main(const int argc, const char **argv)
     app = new UphApplication;
     app->project.patterns.push_back(UphMidiPattern{ "Pattern 1" });
 
-    uph_sound_device_initialize();
+    uint32_t audio_worker_count = uph_engine_default_worker_count();
+    UphSoundDeviceConfig sound_device_config{};
+    UphRealtimeConfig realtime_config{};
+    for (int i = 1; i + 1 < argc; ++i)
+    {
+        if (strcmp(argv[i], "--audio-threads") == 0)
+            audio_worker_count = (uint32_t)atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "--period") == 0)
+            sound_device_config.period_size = (uint32_t)atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "--rate") == 0)
+            sound_device_config.sample_rate = (uint32_t)atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "--device") == 0)
+            strncpy_s(sound_device_config.device_name, argv[i + 1], sizeof(sound_device_config.device_name));
+        else if (strcmp(argv[i], "--realtime") == 0)
+            realtime_config.request_realtime = atoi(argv[i + 1]) != 0;
+        else if (strcmp(argv[i], "--worker-cores") == 0)
+        {
+            // Comma separated core indices, e.g. 2,3,4,5.
+            for (const char *core = argv[i + 1]; *core; ++core)
+            {
+                const int index = atoi(core);
+                if (index >= 0 && index < 64)
+                    realtime_config.worker_cores |= 1ull << index;
+                while (*core && *core != ',')
+                    ++core;
+                if (!*core)
+                    break;
+            }
+        }
+    }
+
+    uph_realtime_configure(&realtime_config);
+    uph_engine_initialize(audio_worker_count);
+    uph_sound_device_initialize(&sound_device_config);
+    uph_plugin_scanner_start();
+    uph_plugin_loader_start();
 	uph_panel_init_all();
 
     uph_event_connect(UphSystemEventCode::Resize, [&](void *data) {
@@ -82,21 +128,30 @@ int main(const int argc, const char **argv)
         uph_render();
 		uph_layout_process_requests();
         uph_process_plugin_loader();
+        uph_sound_device_update();
+        uph_render_snapshot_publish();
+        uph_profiler_update((uint32_t)app->project.tracks.size());
     }
 
+    uph_plugin_scanner_shutdown();
+    uph_plugin_loader_shutdown();
+    uph_sound_device_shutdown();
+    uph_engine_shutdown();
+
     for (auto &track : app->project.tracks)
     {
         if (track.track_type == UphTrackType_Midi)
         {
-            if (!track.instrument.plugin.is_loaded)
+            UviPlugin *plugin = track.instrument.plugin;
+            if (!plugin)
                 continue;
-            UviPlugin *plugin = &track.instrument.plugin;
             uvi_plugin_unload(plugin);
             uph_destroy_child_window(&track.instrument.window);
+            delete plugin;
         }
     }
 
-    uph_sound_device_shutdown();
+    uph_render_snapshot_shutdown();
 	uph_project_shutdown();
     uph_platform_shutdown();
     ImGui::DestroyContext();
@@ -1,8 +1,10 @@
 #include "panel_manager.h"
 #include "types.h"
+#include "engine/interpolation.h"
 
 #include <imgui_internal.h>
 #include <imgui-knobs.h>
+#include <algorithm>
 #include <cmath>
 
 struct UphAudioMixer
@@ -159,6 +161,33 @@ static void DrawChannelStrip(int idx, bool isSelected)
     // Volume dB display
     float db = track.volume > 0.0f ? 20.0f * log10f(track.volume) : -60.0f;
     ImGui::Text(" %.1f dB", db);
+
+    // Plugin latency, and how far the track is held back to line up
+    // with the most latent one.
+    const UviPlugin *plugin = track.instrument.plugin;
+    const uint32_t latency = (track.track_type == UphTrackType_Midi && plugin && plugin->is_loaded) ? (uint32_t)std::max(0, plugin->latency) : 0;
+    const uint32_t delay = app->delay_compensation - std::min(latency, app->delay_compensation);
+    ImGui::TextDisabled(" %u / +%u", latency, delay);
+    if (ImGui::IsItemHovered())
+        ImGui::SetTooltip("Latency %u samples, delayed by %u samples", latency, delay);
+
+    // Exports read with the project's own choice instead.
+    if (track.track_type == UphTrackType_Sample)
+    {
+        ImGui::SetNextItemWidth(-1);
+        if (ImGui::BeginCombo("##interpolation", uph_interpolation_name(track.interpolation)))
+        {
+            for (int i = 0; i < UphInterpolation_Count; ++i)
+            {
+                const UphInterpolation interpolation = (UphInterpolation)i;
+                if (ImGui::Selectable(uph_interpolation_name(interpolation), interpolation == track.interpolation))
+                    track.interpolation = interpolation;
+            }
+            ImGui::EndCombo();
+        }
+        if (ImGui::IsItemHovered())
+            ImGui::SetTooltip("Sample interpolation while playing");
+    }
     
     ImGui::Spacing();
     ImGui::Separator();
@@ -218,6 +247,8 @@ static void DrawChannelStrip(int idx, bool isSelected)
 
 static void uph_mixer_render(UphPanel* panel)
 {
+    ImGui::Text("Delay compensation: %u samples", app->delay_compensation);
+
     ImGui::BeginChild("MixerStrips", ImVec2(0, 0), false, 
         ImGuiWindowFlags_HorizontalScrollbar);
     
@@ -4,6 +4,7 @@
 #include "../io/record_manager.h"
 #include "../io/layout_manager.h"
 #include "../sound_device.h"
+#include "../engine/interpolation.h"
 #include <map>
 #include <string>
 #include <algorithm>
@@ -220,6 +221,17 @@ static void uph_menu_bar_file_menu()
         if (ImGui::MenuItem("FLAC file...", nullptr, nullptr, false)) {}
         if (ImGui::MenuItem("M4A file...", nullptr, nullptr, false)) {}
         if (ImGui::MenuItem("MIDI file...", nullptr, nullptr, false)) {}
+        ImGui::Separator();
+        if (ImGui::BeginMenu("Sample interpolation"))
+        {
+            for (int i = 0; i < UphInterpolation_Count; ++i)
+            {
+                const UphInterpolation interpolation = (UphInterpolation)i;
+                if (ImGui::MenuItem(uph_interpolation_name(interpolation), nullptr, app->project.export_interpolation == interpolation))
+                    app->project.export_interpolation = interpolation;
+            }
+            ImGui::EndMenu();
+        }
         ImGui::EndMenu();
     }
 
@@ -240,7 +252,7 @@ static void uph_menu_bar_edit_menu()
 static void uph_menu_bar_options_menu()
 {
     if (ImGui::MenuItem("MIDI Settings")) {}
-    if (ImGui::MenuItem("Audio Settings")) {}
+    if (ImGui::MenuItem("Audio Settings")) { uph_panel_show("Settings"); }
     if (ImGui::MenuItem("General Settings")) {}
 }
 
@@ -101,7 +101,7 @@ static void midi_editor_draw_transport(void)
         {
             app->is_midi_editor_playing = true;
             app->is_song_timeline_playing = false;
-            app->midi_editor_song_position = 0.0f;
+            uph_transport_seek(&app->midi_editor_transport, 0.0);
         }
         uph_sound_device_all_notes_off();
     }
@@ -111,7 +111,7 @@ static void midi_editor_draw_transport(void)
 
 void midi_editor_draw_and_handle_playhead(ImDrawList* draw_list, ImVec2 canvas_pos, ImVec2 canvas_size, float key_width)
 {
-    float x = canvas_pos.x + key_width + app->midi_editor_song_position * editor_data.smooth_zoom_x - editor_data.smooth_scroll_x;
+    float x = canvas_pos.x + key_width + (float)uph_transport_beat(&app->midi_editor_transport) * editor_data.smooth_zoom_x - editor_data.smooth_scroll_x;
     draw_list->AddLine(ImVec2(x, canvas_pos.y), ImVec2(x, canvas_pos.y + canvas_size.y),
         IM_COL32(0, 255, 0, 255), 2.0f);
 }
@@ -283,8 +283,8 @@ static void uph_update_cursor_feedback(const std::vector<UphNote>& notes, const
     if (over_edge) ImGui::SetMouseCursor(ImGuiMouseCursor_ResizeEW);
 }
 
-// Left click: select or create note
-static void uph_handle_left_click(UphMidiEditor& ed, std::vector<UphNote>& notes, const ImVec2& mouse_pos, const ImVec2& canvas_pos, float key_width, float key_height)
+// Left click: select or create note, true when a note was created
+static bool uph_handle_left_click(UphMidiEditor& ed, std::vector<UphNote>& notes, const ImVec2& mouse_pos, const ImVec2& canvas_pos, float key_width, float key_height)
 {
     ed.selected_note_index = -1;
     for (size_t i = 0; i < notes.size(); ++i) {
@@ -297,7 +297,7 @@ static void uph_handle_left_click(UphMidiEditor& ed, std::vector<UphNote>& notes
             ed.drag_start_note_pitch = notes[i].key;
             if (uph_point_on_right_edge(mouse_pos, r)) ed.resizing_note = true;
             else { ed.dragging_note = true; ed.prev_length = notes[i].length; }
-            return;
+            return false;
         }
     }
 
@@ -317,10 +317,11 @@ static void uph_handle_left_click(UphMidiEditor& ed, std::vector<UphNote>& notes
         ed.dragging_note = true;
         ed.prev_length = n.length;
     }
+    return true;
 }
 
-// Right click: delete notes
-static void uph_handle_right_click(UphMidiEditor& ed, std::vector<UphNote>& notes, const ImVec2& mouse_pos, const ImVec2& canvas_pos, float key_width, float key_height)
+// Right click: delete notes, true when any were
+static bool uph_handle_right_click(UphMidiEditor& ed, std::vector<UphNote>& notes, const ImVec2& mouse_pos, const ImVec2& canvas_pos, float key_width, float key_height)
 {
     std::vector<size_t> remove_index;
     for (size_t i = 0; i < notes.size(); ++i) {
@@ -331,15 +332,17 @@ static void uph_handle_right_click(UphMidiEditor& ed, std::vector<UphNote>& note
     }
     std::sort(remove_index.rbegin(), remove_index.rend());
     for (size_t idx : remove_index) notes.erase(notes.begin() + idx);
+    return !remove_index.empty();
 }
 
-// Dragging/resizing
-static void uph_handle_drag(UphMidiEditor& ed, std::vector<UphNote>& notes, const ImVec2& mouse_pos, float key_height)
+// Dragging/resizing, true when the selected note changed
+static bool uph_handle_drag(UphMidiEditor& ed, std::vector<UphNote>& notes, const ImVec2& mouse_pos, float key_height)
 {
     if (ed.selected_note_index < 0 || ed.selected_note_index >= (int)notes.size())
-        return;
+        return false;
 
     UphNote& sel = notes[ed.selected_note_index];
+    const UphNote before = sel;
 
     // Dragging a note (move in time and pitch)
     if (ed.dragging_note && ImGui::IsMouseDragging(ImGuiMouseButton_Left)) {
@@ -373,6 +376,8 @@ static void uph_handle_drag(UphMidiEditor& ed, std::vector<UphNote>& notes, cons
         ed.resizing_note = false;
         ed.selected_note_index = -1;
     }
+
+    return sel.start != before.start || sel.length != before.length || sel.key != before.key;
 }
 
 static void uph_midi_editor_draw_grid(ImDrawList* dl, const ImVec2& canvas_pos, const ImVec2& canvas_size, float key_width, float key_height, const UphMidiEditor& ed, int time_sig_num, int time_sig_den, int steps_per_beat)
@@ -439,7 +444,9 @@ static void uph_midi_editor_render(UphPanel* panel)
     ImGui::BeginChild("MidiEditorCanvas", child_size);
 
     const UphTrack& track = app->project.tracks[app->current_track_index];
-    std::vector<UphNote>& notes = app->project.patterns[app->current_pattern_index].notes;
+    UphMidiPattern& pattern = app->project.patterns[app->current_pattern_index];
+    std::vector<UphNote>& notes = pattern.notes;
+    bool edited = false;
 
     ImVec2 canvas_size = ImGui::GetContentRegionAvail();
     ImVec2 canvas_pos = ImGui::GetCursorScreenPos();
@@ -465,13 +472,16 @@ static void uph_midi_editor_render(UphPanel* panel)
 
     if (click_inside && ImGui::IsWindowHovered()) {
         if (ImGui::IsMouseClicked(ImGuiMouseButton_Left))
-            uph_handle_left_click(editor_data, notes, mouse_pos, canvas_pos, key_width, key_height);
+            edited |= uph_handle_left_click(editor_data, notes, mouse_pos, canvas_pos, key_width, key_height);
 
         if (ImGui::IsMouseClicked(ImGuiMouseButton_Right))
-            uph_handle_right_click(editor_data, notes, mouse_pos, canvas_pos, key_width, key_height);
+            edited |= uph_handle_right_click(editor_data, notes, mouse_pos, canvas_pos, key_width, key_height);
     }
 
-    uph_handle_drag(editor_data, notes, mouse_pos, key_height);
+    edited |= uph_handle_drag(editor_data, notes, mouse_pos, key_height);
+    if (edited) {
+        pattern.notes_version = uph_next_version();
+    }
 	float grid_note_height = editor_data.fancy_piano_keys ? key_height * editor_data.black_key_scale : key_height;
 	uph_midi_editor_draw_grid(draw_list, canvas_pos, canvas_size, key_width, grid_note_height, editor_data, app->project.time_sig_numerator, app->project.time_sig_denominator, app->project.steps_per_beat);
 
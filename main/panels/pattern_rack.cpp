@@ -126,6 +126,7 @@ static void uph_pattern_rack_render(UphPanel* panel)
                             blocks.end());
                         for (auto &block : blocks)
                             if (block.track_type == UphTrackType_Midi && block.sample_index > i) block.sample_index--;
+                        track.blocks_version = uph_next_version();
                     }
                     app->project.patterns.erase(app->project.patterns.begin() + i);
                     if (pattern_data.renaming_index == (int)i) pattern_data.renaming_index = -1;
@@ -0,0 +1,99 @@
+#include "panel_manager.h"
+#include "types.h"
+#include "engine/dsp_kernels.h"
+#include "engine/profiler.h"
+#include "engine/worker_pool.h"
+
+#include <algorithm>
+
+struct UphPerformance
+{
+    uint32_t order[UPH_PROFILER_MAX_TRACKS];
+};
+
+static UphPerformance performance_data {};
+
+static void uph_performance_init(UphPanel* panel)
+{
+	panel->category = UPH_CATEGORY_METER;
+}
+
+static void uph_performance_draw_load_bar(float load)
+{
+    ImVec4 color = ImVec4(0.2f, 0.8f, 0.4f, 1.0f);
+    if (load > 0.9f)
+        color = ImVec4(1.0f, 0.2f, 0.2f, 1.0f);
+    else if (load > 0.6f)
+        color = ImVec4(1.0f, 0.8f, 0.2f, 1.0f);
+
+    ImGui::PushStyleColor(ImGuiCol_PlotHistogram, color);
+    ImGui::ProgressBar(std::min(load, 1.0f), ImVec2(-1, 0));
+    ImGui::PopStyleColor();
+}
+
+static void uph_performance_render(UphPanel* panel)
+{
+    const UphProfilerStats *stats = uph_profiler_stats();
+
+    ImGui::Text("DSP: %s, %u worker threads", uph_dsp_kernels()->name, uph_worker_pool_thread_count());
+    ImGui::Text("Callback p50 %.0f us  p99 %.0f us  max %.0f us  (budget %.0f us)",
+        stats->p50_us, stats->p99_us, stats->max_us, stats->budget_us);
+    uph_performance_draw_load_bar(stats->budget_us > 0.0f ? stats->p99_us / stats->budget_us : 0.0f);
+
+    ImGui::Text("Xruns: %llu of %llu callbacks", (unsigned long long)stats->xruns, (unsigned long long)stats->callbacks);
+    ImGui::SameLine();
+    if (ImGui::SmallButton("Reset"))
+        uph_profiler_reset();
+
+    ImGui::Separator();
+
+    const uint32_t track_count = std::min<uint32_t>(stats->track_count, (uint32_t)app->project.tracks.size());
+    for (uint32_t i = 0; i < track_count; ++i)
+        performance_data.order[i] = i;
+    std::sort(performance_data.order, performance_data.order + track_count, [stats](uint32_t a, uint32_t b)
+    {
+        return stats->tracks[a].load > stats->tracks[b].load;
+    });
+
+    if (ImGui::BeginTable("PerformanceTracks", 6, ImGuiTableFlags_RowBg | ImGuiTableFlags_BordersInnerV | ImGuiTableFlags_ScrollY))
+    {
+        ImGui::TableSetupColumn("Track");
+        ImGui::TableSetupColumn("Load", ImGuiTableColumnFlags_WidthStretch);
+        ImGui::TableSetupColumn("Plugin");
+        ImGui::TableSetupColumn("p50");
+        ImGui::TableSetupColumn("p99");
+        ImGui::TableSetupColumn("Max");
+        ImGui::TableHeadersRow();
+
+        for (uint32_t i = 0; i < track_count; ++i)
+        {
+            const uint32_t index = performance_data.order[i];
+            const UphProfilerTrackStats &track = stats->tracks[index];
+
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn();
+            ImGui::Text("%s", app->project.tracks[index].name);
+            if (app->project.tracks[index].is_sleeping)
+            {
+                ImGui::SameLine();
+                ImGui::TextDisabled("(asleep)");
+            }
+            ImGui::TableNextColumn();
+            uph_performance_draw_load_bar(track.load);
+            ImGui::TableNextColumn();
+            ImGui::Text("%.1f%%", track.plugin_load * 100.0f);
+            if (ImGui::IsItemHovered())
+                ImGui::SetTooltip("process p50 %.0f us  p99 %.0f us  max %.0f us",
+                    track.plugin_p50_us, track.plugin_p99_us, track.plugin_max_us);
+            ImGui::TableNextColumn();
+            ImGui::Text("%.0f us", track.p50_us);
+            ImGui::TableNextColumn();
+            ImGui::Text("%.0f us", track.p99_us);
+            ImGui::TableNextColumn();
+            ImGui::Text("%.0f us", track.max_us);
+        }
+        ImGui::EndTable();
+    }
+}
+
+UPH_REGISTER_PANEL("Performance", UphPanelFlags_Panel, uph_performance_render, uph_performance_init);
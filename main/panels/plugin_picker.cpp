@@ -1,15 +1,17 @@
 #include "panel_manager.h"
 #include "plugin_loader.h"
+#include "plugin_scanner.h"
 #include "types.h"
 
+#include <uvi_synth.h>
+
 #include <string>
-#include <filesystem>
-#include <unordered_set>
-#include <set>
+#include <vector>
 
 struct UphPluginPicker
 {
-    std::set<std::filesystem::path> paths;
+    std::vector<UphPluginInfo> plugins;
+    uint32_t generation = 0;
 };
 
 static UphPluginPicker plugin_picker;
@@ -18,45 +20,45 @@ static void uph_plugin_picker_init(UphPanel* panel)
 {
     panel->panel_flags |= UphPanelFlags_HiddenFromMenu;
 	panel->window_flags = ImGuiWindowFlags_NoSavedSettings;
+}
 
-    const std::unordered_set<std::filesystem::path> default_directories = {
-        "C:\\Program Files\\Steinberg\\VstPlugins",
-        "C:\\Program Files\\VstPlugins"
-    };
-
-    for (const auto& directory : default_directories)
-    {
-        if (!std::filesystem::exists(directory))
-            continue;
-        for (const auto& entry : std::filesystem::recursive_directory_iterator(directory))
-        {
-            if (!entry.is_regular_file())
-                continue;
-            
-            std::filesystem::path path = entry.path();
-            std::filesystem::path extension = path.extension();
-
-            if (extension == ".dll" || extension == ".so" || extension == ".dylib" ||
-                extension == ".vst3" || extension == ".vst2" || extension == ".vst")
-                plugin_picker.paths.insert(entry.path());
-        }
-    }
+static void uph_plugin_picker_select(UphPanel* panel, const char* path)
+{
+    UphInstrument *instrument = &app->project.tracks[app->current_instrument_track_index].instrument;
+    if (instrument->plugin)
+        uph_queue_instrument_unload(app->current_instrument_track_index);
+    uph_queue_instrument_load(path, app->current_instrument_track_index);
+    panel->is_visible = false;
 }
 
 static void uph_plugin_picker_render(UphPanel* panel)
 {
-    for (const auto& path : plugin_picker.paths)
+    if (ImGui::Selectable("Uphonic Synth (built-in)"))
+        uph_plugin_picker_select(panel, UVI_SYNTH_PATH);
+    ImGui::Separator();
+
+    uph_plugin_scanner_poll(&plugin_picker.plugins, &plugin_picker.generation);
+    for (const UphPluginInfo &plugin : plugin_picker.plugins)
     {
-        if (ImGui::Selectable(path.filename().string().c_str()))
+        if (!plugin.is_valid)
+            continue;
+
+        ImGui::PushID(plugin.path.c_str());
+        if (ImGui::Selectable(plugin.name.c_str()))
+            uph_plugin_picker_select(panel, plugin.path.c_str());
+        if (!plugin.vendor.empty() || plugin.is_synth)
         {
-            UphInstrument *instrument = &app->project.tracks[app->current_instrument_track_index].instrument;
-            if (instrument->plugin.is_loaded)
-                uph_queue_instrument_unload(app->current_instrument_track_index);
-            uph_queue_instrument_load(path.string().c_str(), app->current_instrument_track_index);
-            panel->is_visible = false;
+            ImGui::SameLine();
+            ImGui::TextDisabled("%s%s", plugin.vendor.c_str(), plugin.is_synth ? " (synth)" : "");
         }
+        ImGui::PopID();
     }
 
+    uint32_t probed, to_probe;
+    uph_plugin_scanner_progress(&probed, &to_probe);
+    if (probed < to_probe)
+        ImGui::TextDisabled("Scanning plugins %u/%u...", probed, to_probe);
+
     if (!ImGui::IsAnyItemHovered() && ImGui::IsAnyMouseDown() || ImGui::IsKeyPressed(ImGuiKey_Escape))
         panel->is_visible = false;
 }
@@ -1,6 +1,8 @@
 #include "panel_manager.h"
 #include "../types.h"
 
+#include <cstdio>
+
 static void uph_rhythm_settings_init(UphPanel* panel)
 {
 
@@ -49,6 +51,47 @@ static void uph_rhythm_settings_render(UphPanel* panel)
     ImGui::SetNextItemWidth(70);
     ImGui::InputInt("##steps", &app->project.steps_per_beat);
     app->project.steps_per_beat = std::max<int>(1, app->project.steps_per_beat);
+
+    ImGui::SameLine(0, 20);
+
+    // --- Processing precision ---
+    ImGui::Checkbox("64-bit", &app->project.double_precision);
+    if (ImGui::IsItemHovered())
+        ImGui::SetTooltip("Render and mix tracks in double precision");
+
+    ImGui::SameLine(0, 20);
+
+    // --- Processing rate, the device reopens once it changed ---
+    char rate_label[32];
+    const uint32_t processing_rate = app->project.processing_rate;
+    snprintf(rate_label, sizeof(rate_label), processing_rate ? "%u Hz" : "Device", processing_rate);
+
+    ImGui::Text("Rate:");
+    ImGui::SameLine();
+    ImGui::SetNextItemWidth(100);
+    if (ImGui::BeginCombo("##processing_rate", rate_label))
+    {
+        for (uint32_t rate : uph_processing_rates)
+        {
+            snprintf(rate_label, sizeof(rate_label), rate ? "%u Hz" : "Device", rate);
+            if (ImGui::Selectable(rate_label, rate == processing_rate))
+                app->project.processing_rate = rate;
+        }
+        ImGui::EndCombo();
+    }
+    if (ImGui::IsItemHovered())
+        ImGui::SetTooltip("Rate every track and plugin runs at, converted to the device rate on output");
+
+    ImGui::SameLine(0, 20);
+
+    // --- Position of whichever transport plays, bar.beat.tick ---
+    const UphProject &project = app->project;
+    const UphTransport *transport = app->is_midi_editor_playing ? &app->midi_editor_transport : &app->song_timeline_transport;
+    const int64_t ticks_per_beat = std::max<int64_t>(1, (int64_t)project.pulse_per_quarter * 4 / std::max(1, project.time_sig_denominator));
+    const int64_t ticks_per_bar = ticks_per_beat * std::max(1, project.time_sig_numerator);
+    const int64_t tick = std::max<int64_t>(0, uph_transport_tick(transport));
+    ImGui::Text("Position: %lld.%lld.%03lld", (long long)(tick / ticks_per_bar + 1),
+        (long long)(tick % ticks_per_bar / ticks_per_beat + 1), (long long)(tick % ticks_per_beat));
 }
 
 UPH_REGISTER_PANEL("Rhythm Settings", UphPanelFlags_Panel, uph_rhythm_settings_render, uph_rhythm_settings_init);
\ No newline at end of file
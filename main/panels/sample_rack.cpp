@@ -124,6 +124,7 @@ static void uph_sample_rack_render(UphPanel* panel)
                             blocks.end());
                         for (auto &block : blocks)
                             if (block.track_type == UphTrackType_Sample && block.sample_index > i) block.sample_index--;
+                        track.blocks_version = uph_next_version();
                     }
 
                     app->project.samples.erase(app->project.samples.begin() + i);
@@ -1,37 +1,195 @@
 #include "panel_manager.h"
+#include "../sound_device.h"
+#include "../engine/realtime.h"
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+static const uint32_t k_sample_rates[] = { 44100, 48000, 88200, 96000, 176400, 192000 };
+static const uint32_t k_period_sizes[] = { 0, 64, 128, 256, 512, 1024, 2048 };
 
 struct UphSettings
 {
-    
+    UphSoundDeviceConfig device;
+    std::vector<std::string> device_names;
+    UphRealtimeConfig realtime;
+    UphRealtimeThreadInfo threads[UPH_REALTIME_MAX_THREADS];
 };
 
 static UphSettings settings_data {};
 
 static void uph_settings_init(UphPanel* panel)
 {
-	
 	panel->window_flags = ImGuiWindowFlags_NoSavedSettings;
+    settings_data.device = uph_sound_device_config();
+    settings_data.device_names = uph_sound_device_list();
+    settings_data.realtime = uph_realtime_config();
 }
 
-static void uph_settings_render(UphPanel* panel)
+static void uph_settings_period_label(uint32_t period_size, uint32_t sample_rate, char *label, size_t label_size)
 {
-    ImGui::TextWrapped("An unsaved project was found. Would you like to restore or discard it?");
-    ImGui::Spacing();
-    ImGui::Separator();
-    ImGui::Spacing();
+    if (period_size == 0)
+        snprintf(label, label_size, "Auto");
+    else
+        snprintf(label, label_size, "%u frames (%.1f ms)", period_size, 1000.0f * period_size / sample_rate);
+}
 
-    if (ImGui::Button("Restore", ImVec2(120, 0))) 
-	{
-        panel->is_visible = false;
-    }
+static void uph_settings_render_device(void)
+{
+    ImGui::SeparatorText("Audio device");
 
+    UphSoundDeviceConfig &config = settings_data.device;
+    if (ImGui::BeginCombo("Device", config.device_name[0] ? config.device_name : "Default"))
+    {
+        if (ImGui::Selectable("Default", config.device_name[0] == '\0'))
+            config.device_name[0] = '\0';
+        for (const std::string &name : settings_data.device_names)
+        {
+            if (ImGui::Selectable(name.c_str(), name == config.device_name))
+                strncpy_s(config.device_name, name.c_str(), sizeof(config.device_name));
+        }
+        ImGui::EndCombo();
+    }
     ImGui::SameLine();
+    if (ImGui::Button("Refresh"))
+        settings_data.device_names = uph_sound_device_list();
+
+    char label[64];
+    snprintf(label, sizeof(label), "%u Hz", config.sample_rate);
+    if (ImGui::BeginCombo("Sample rate", label))
+    {
+        for (uint32_t sample_rate : k_sample_rates)
+        {
+            snprintf(label, sizeof(label), "%u Hz", sample_rate);
+            if (ImGui::Selectable(label, sample_rate == config.sample_rate))
+                config.sample_rate = sample_rate;
+        }
+        ImGui::EndCombo();
+    }
 
-    if (ImGui::Button("Discard", ImVec2(120, 0))) 
-	{
-        panel->is_visible = false;
+    // Smaller periods lower the latency and raise the CPU spent per frame.
+    uph_settings_period_label(config.period_size, config.sample_rate, label, sizeof(label));
+    if (ImGui::BeginCombo("Period", label))
+    {
+        for (uint32_t period_size : k_period_sizes)
+        {
+            uph_settings_period_label(period_size, config.sample_rate, label, sizeof(label));
+            if (ImGui::Selectable(label, period_size == config.period_size))
+                config.period_size = period_size;
+        }
+        ImGui::EndCombo();
     }
 
+    const UphSoundDeviceConfig current = uph_sound_device_config();
+    const bool is_changed = strcmp(config.device_name, current.device_name) != 0
+        || config.sample_rate != current.sample_rate
+        || config.period_size != current.period_size;
+
+    ImGui::BeginDisabled(!is_changed);
+    if (ImGui::Button("Apply"))
+        uph_sound_device_reconfigure(&config);
+    ImGui::EndDisabled();
+
+    const UphSoundDeviceStatus status = uph_sound_device_status();
+    if (!status.is_running)
+    {
+        ImGui::TextDisabled("Audio device not running");
+        return;
+    }
+
+    uph_settings_period_label(status.period_size, status.sample_rate, label, sizeof(label));
+    ImGui::Text("%s, %u Hz, %s", status.device_name, status.sample_rate, label);
+    if (status.engine_rate != status.sample_rate)
+        ImGui::Text("Project runs at %u Hz, resampled on output", status.engine_rate);
+}
+
+static const char *uph_settings_scheduling_name(UphRealtimeScheduling scheduling)
+{
+    switch (scheduling)
+    {
+    case UphRealtimeScheduling_Realtime: return "Real-time";
+    case UphRealtimeScheduling_Raised:   return "Raised";
+    default:                             return "Normal";
+    }
+}
+
+static void uph_settings_render_realtime(void)
+{
+    ImGui::SeparatorText("Real-time");
+
+    UphRealtimeConfig &config = settings_data.realtime;
+    bool is_changed = ImGui::Checkbox("Request real-time priority", &config.request_realtime);
+
+    ImGui::TextUnformatted("Pin workers to cores");
+    const uint32_t core_count = uph_realtime_core_count();
+    for (uint32_t core = 0; core < core_count; ++core)
+    {
+        if (core % 8 != 0)
+            ImGui::SameLine();
+
+        char label[16];
+        snprintf(label, sizeof(label), "%u##core", core);
+        bool is_pinned = (config.worker_cores >> core) & 1;
+        if (ImGui::Checkbox(label, &is_pinned))
+        {
+            config.worker_cores ^= 1ull << core;
+            is_changed = true;
+        }
+    }
+
+    if (is_changed)
+        uph_realtime_configure(&config);
+
+    // What the threads actually got, which may be less than requested.
+    const uint32_t thread_count = uph_realtime_threads(settings_data.threads, UPH_REALTIME_MAX_THREADS);
+    if (thread_count == 0)
+    {
+        ImGui::TextDisabled("No audio thread running");
+        return;
+    }
+
+    if (ImGui::BeginTable("RealtimeThreads", 5, ImGuiTableFlags_RowBg | ImGuiTableFlags_BordersInnerV))
+    {
+        ImGui::TableSetupColumn("Thread");
+        ImGui::TableSetupColumn("Scheduling");
+        ImGui::TableSetupColumn("Priority");
+        ImGui::TableSetupColumn("Core");
+        ImGui::TableSetupColumn("Denormals");
+        ImGui::TableHeadersRow();
+
+        uint32_t worker = 0;
+        for (uint32_t i = 0; i < thread_count; ++i)
+        {
+            const UphRealtimeThreadInfo &info = settings_data.threads[i];
+
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn();
+            if (info.role == UphRealtimeRole_Audio)
+                ImGui::TextUnformatted("Audio");
+            else
+                ImGui::Text("Worker %u", ++worker);
+            ImGui::TableNextColumn();
+            ImGui::TextUnformatted(uph_settings_scheduling_name(info.scheduling));
+            ImGui::TableNextColumn();
+            ImGui::Text("%d", info.priority);
+            ImGui::TableNextColumn();
+            if (info.core >= 0)
+                ImGui::Text("%d", info.core);
+            else
+                ImGui::TextDisabled("Any");
+            ImGui::TableNextColumn();
+            ImGui::TextUnformatted(info.flushes_denormals ? "Flushed" : "Kept");
+        }
+        ImGui::EndTable();
+    }
+}
+
+static void uph_settings_render(UphPanel* panel)
+{
+    uph_settings_render_device();
+    uph_settings_render_realtime();
 }
 
-UPH_REGISTER_PANEL("Settings", UphPanelFlags_Popup, uph_settings_render, uph_settings_init);
\ No newline at end of file
+UPH_REGISTER_PANEL("Settings", UphPanelFlags_Popup, uph_settings_render, uph_settings_init);
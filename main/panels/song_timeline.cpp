@@ -9,6 +9,8 @@
 
 #include <algorithm>
 #include <cmath>
+#include <cstdio>
+#include <filesystem>
 
 enum class ResizeSide
 {
@@ -119,7 +121,8 @@ static void uph_song_timeline_handle_pattern_interaction(
                         track.timeline_blocks.end(),
                         [&](UphTimelineBlock &p){ return &p == &pattern; }),
                     track.timeline_blocks.end());
-                if (track.timeline_blocks.empty() && !track.instrument.plugin.is_loaded)
+                track.blocks_version = uph_next_version();
+                if (track.timeline_blocks.empty() && !track.instrument.plugin)
                     track.track_type = UphTrackType_None;
             }
         }
@@ -131,6 +134,7 @@ static void uph_song_timeline_handle_pattern_interaction(
         {
             float mouseTime = (io.MousePos.x - timelineX + timeline_data.scroll_x) / timeline_data.zoom_x;
             float qMouseTime = quantizeToBeat(mouseTime, k_beat_size);
+            const UphTimelineBlock before = pattern;
 
             if (timeline_data.resizeSide == ResizeSide::Left)
             {
@@ -156,6 +160,9 @@ static void uph_song_timeline_handle_pattern_interaction(
                 float newLen = std::max<float>(k_min_pattern_length, qMouseTime - start);
                 pattern.length = newLen;
             }
+
+            if (pattern.start_time != before.start_time || pattern.length != before.length)
+                track.blocks_version = uph_next_version();
         }
         else {
             timeline_data.resizing = false;
@@ -172,7 +179,11 @@ static void uph_song_timeline_handle_pattern_interaction(
             float newStart = (io.MousePos.x - timelineX + timeline_data.scroll_x) / timeline_data.zoom_x - timeline_data.dragOffset;
             newStart = quantizeToBeat(newStart, k_beat_size);
             newStart = std::max<float>(0.0f, newStart);
-            pattern.start_time = newStart;
+            if (pattern.start_time != newStart)
+            {
+                pattern.start_time = newStart;
+                timeline_data.draggedTrack->blocks_version = uph_next_version();
+            }
 
             int targetTrackIdx = (int)((io.MousePos.y + timeline_data.smooth_scroll_y - canvasPos.y) / (k_track_height * timeline_data.zoom_y));
             auto& tracks = app->project.tracks;
@@ -190,15 +201,17 @@ static void uph_song_timeline_handle_pattern_interaction(
                     {
                         UphTimelineBlock moved = std::move(*it);
                         src.erase(it);
+                        timeline_data.draggedTrack->blocks_version = uph_next_version();
 
                         targetTrack.track_type = moved.track_type;
                         if (src.empty())
                         {
-                            if (!timeline_data.draggedTrack->instrument.plugin.is_loaded)
+                            if (!timeline_data.draggedTrack->instrument.plugin)
                                 timeline_data.draggedTrack->track_type = UphTrackType_None;
                         }
 
                         targetTrack.timeline_blocks.push_back(std::move(moved));
+                        targetTrack.blocks_version = uph_next_version();
                         timeline_data.draggedTrack   = &targetTrack;
                         timeline_data.draggedBlock = &targetTrack.timeline_blocks.back();
                     }
@@ -358,7 +371,10 @@ static void uph_song_timeline_draw_track_menu(UphTrack& track, size_t trackIndex
             uph_panel_show("Select Plugin", true);
         }
 
-        if (track.instrument.plugin.is_loaded)
+        UphInstrumentLoadStatus load_status;
+        const bool is_loading = uph_instrument_load_status((uint32_t)trackIndex, &load_status);
+
+        if (track.instrument.plugin || is_loading)
         {
             ImGui::SameLine();
             if (ImGui::Button("X"))
@@ -368,6 +384,15 @@ static void uph_song_timeline_draw_track_menu(UphTrack& track, size_t trackIndex
                     track.track_type = UphTrackType_None;
             }
         }
+
+        if (is_loading)
+        {
+            char overlay[32];
+            snprintf(overlay, sizeof(overlay), "%s %.1fs", load_status.is_started ? "Loading" : "Queued", load_status.seconds);
+            ImGui::SameLine();
+            ImGui::ProgressBar(-(float)ImGui::GetTime(), ImVec2(-FLT_MIN, 0.0f), overlay);
+            ImGui::SetItemTooltip("%s", std::filesystem::path(load_status.path).filename().string().c_str());
+        }
     }
 
     ImVec4 color =  ImColor(track.color);
@@ -381,7 +406,7 @@ static void uph_song_timeline_draw_track_menu(UphTrack& track, size_t trackIndex
 
 static void uph_song_timeline_draw_and_handle_playhead(ImDrawList* drawList, ImVec2 canvasPos, ImVec2 canvasSize, float keyWidth)
 {
-    const float x = canvasPos.x + keyWidth + app->song_timeline_song_position * timeline_data.zoom_x - timeline_data.scroll_x;
+    const float x = canvasPos.x + keyWidth + (float)uph_transport_beat(&app->song_timeline_transport) * timeline_data.zoom_x - timeline_data.scroll_x;
     if (x < canvasPos.x + k_track_menu_width) return;
     drawList->AddLine(ImVec2(x, canvasPos.y), ImVec2(x, canvasPos.y + canvasSize.y),
         IM_COL32(0, 255, 0, 255), 2.0f);
@@ -412,7 +437,7 @@ static void uph_song_timeline_render(UphPanel* panel)
     if (ImGui::Button(app->is_song_timeline_playing ? "Stop" : "Play"))
     {
         app->is_song_timeline_playing = !app->is_song_timeline_playing;
-        app->song_timeline_song_position = 0.0f;
+        uph_transport_seek(&app->song_timeline_transport, 0.0);
         app->is_midi_editor_playing = false;
         uph_sound_device_all_notes_off();
     }
@@ -503,12 +528,14 @@ static void uph_song_timeline_render(UphPanel* panel)
                     size_t src_index = *(const size_t*)payload->Data;
                     track.track_type = UphTrackType_Midi;
                     track.timeline_blocks.push_back(uph_create_timeline_block(canvasPos, src_index, UphTrackType_Midi));
+                    track.blocks_version = uph_next_version();
                 }
                 else if (const ImGuiPayload* payload = ImGui::AcceptDragDropPayload("SAMPLE"))
                 {
                     size_t src_index = *(const size_t*)payload->Data;
                     track.track_type = UphTrackType_Sample;
                     track.timeline_blocks.push_back(uph_create_timeline_block(canvasPos, src_index, UphTrackType_Sample));
+                    track.blocks_version = uph_next_version();
                 }
             }
             else if (track.track_type == UphTrackType_Midi)
@@ -518,6 +545,7 @@ static void uph_song_timeline_render(UphPanel* panel)
                     size_t src_index = *(const size_t*)payload->Data;
                     if (track.track_type == UphTrackType_Midi)
                         track.timeline_blocks.push_back(uph_create_timeline_block(canvasPos, src_index, UphTrackType_Midi));
+                    track.blocks_version = uph_next_version();
                 }
             }
             else if (track.track_type == UphTrackType_Sample)
@@ -527,6 +555,7 @@ static void uph_song_timeline_render(UphPanel* panel)
                     size_t src_index = *(const size_t*)payload->Data;
                     if (track.track_type == UphTrackType_Sample)
                         track.timeline_blocks.push_back(uph_create_timeline_block(canvasPos, src_index, UphTrackType_Sample));
+                    track.blocks_version = uph_next_version();
                 }
             }
             ImGui::EndDragDropTarget();
@@ -1,6 +1,9 @@
 #pragma once
 
+#include <atomic>
 #include <filesystem>
+#include <string>
+#include <vector>
 #include "base.h"
 
 typedef void *UphLibrary;
@@ -37,4 +40,13 @@ void uph_unload_library(UphLibrary library);
 UphProcAddress uph_get_proc_address(UphLibrary library, const char *name);
 std::filesystem::path uph_open_file_dialog(const wchar_t* filter, const wchar_t* title);
 std::filesystem::path uph_save_file_dialog(const wchar_t* filter, const wchar_t* title, const wchar_t* default_name = nullptr);
-std::filesystem::path uph_select_folder_dialog(const wchar_t* title);
\ No newline at end of file
+std::filesystem::path uph_select_folder_dialog(const wchar_t* title);
+
+// Runs this executable again with args and collects its stdout. Returns
+// false when the child crashed, exited with an error, ran past timeout_ms
+// or cancel was set, the last two kill it.
+bool uph_run_self_process(const std::vector<std::string> &args, uint32_t timeout_ms,
+    const std::atomic<bool> *cancel, std::string *output);
+
+// Per-user directory for files kept between runs, created on first use.
+std::filesystem::path uph_config_directory(void);
@@ -14,9 +14,15 @@
 #include "event_types.h"
 
 #include <assert.h>
+#include <algorithm>
 #include <cstdint>
+#include <cstdlib>
 #include <time.h>
 #include <dlfcn.h>
+#include <poll.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/wait.h>
 
 #include <SDL2/SDL.h>
 #include <SDL2/SDL_opengl.h>
@@ -169,4 +175,95 @@ double uph_get_time(void)
     return (double)(now_time.tv_sec - start_time.tv_sec) + (now_time.tv_nsec - start_time.tv_nsec) * clock_frequency;
 }
 
+// How often a running child checks for cancel.
+static const int k_self_process_poll_ms = 50;
+
+bool uph_run_self_process(const std::vector<std::string> &args, uint32_t timeout_ms,
+    const std::atomic<bool> *cancel, std::string *output)
+{
+    char executable[4096];
+    const ssize_t length = readlink("/proc/self/exe", executable, sizeof(executable) - 1);
+    if (length <= 0)
+        return false;
+    executable[length] = '\0';
+
+    int pipe_fds[2];
+    if (pipe(pipe_fds) != 0)
+        return false;
+
+    std::vector<char*> argv;
+    argv.push_back(executable);
+    for (const std::string &arg : args)
+        argv.push_back((char*)arg.c_str());
+    argv.push_back(nullptr);
+
+    const pid_t pid = fork();
+    if (pid < 0)
+    {
+        close(pipe_fds[0]);
+        close(pipe_fds[1]);
+        return false;
+    }
+
+    if (pid == 0)
+    {
+        dup2(pipe_fds[1], STDOUT_FILENO);
+        close(pipe_fds[0]);
+        close(pipe_fds[1]);
+        execv(executable, argv.data());
+        _exit(127);
+    }
+
+    close(pipe_fds[1]);
+
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    bool timed_out = false;
+    char buffer[4096];
+    for (;;)
+    {
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        const int64_t elapsed_ms = (now.tv_sec - start.tv_sec) * 1000 + (now.tv_nsec - start.tv_nsec) / 1000000;
+        if (elapsed_ms >= timeout_ms || (cancel && cancel->load()))
+        {
+            timed_out = true;
+            break;
+        }
+
+        struct pollfd fd = { pipe_fds[0], POLLIN, 0 };
+        if (poll(&fd, 1, (int)std::min<int64_t>(timeout_ms - elapsed_ms, k_self_process_poll_ms)) <= 0)
+            continue;
+
+        const ssize_t count = read(pipe_fds[0], buffer, sizeof(buffer));
+        if (count <= 0)
+            break;
+        output->append(buffer, (size_t)count);
+    }
+    close(pipe_fds[0]);
+
+    if (timed_out)
+        kill(pid, SIGKILL);
+
+    int status = 0;
+    waitpid(pid, &status, 0);
+    return !timed_out && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+std::filesystem::path uph_config_directory(void)
+{
+    std::filesystem::path directory;
+    if (const char *config_home = getenv("XDG_CONFIG_HOME"); config_home && *config_home)
+        directory = std::filesystem::path(config_home) / "uphonic";
+    else if (const char *home = getenv("HOME"))
+        directory = std::filesystem::path(home) / ".config" / "uphonic";
+    else
+        directory = std::filesystem::temp_directory_path() / "uphonic";
+
+    std::error_code error;
+    std::filesystem::create_directories(directory, error);
+    return directory;
+}
+
 #endif
\ No newline at end of file
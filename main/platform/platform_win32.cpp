@@ -20,6 +20,7 @@
 
 #pragma comment(lib, "d3d11.lib")
 #pragma comment(lib, "dxgi.lib")
+#pragma comment(lib, "shell32.lib")
 
 typedef struct UphWin32Platform
 {
@@ -377,6 +378,7 @@ std::filesystem::path uph_save_file_dialog(const wchar_t* filter, const wchar_t*
     return {};
 }
 
+#include <shlobj.h>
 #include <shobjidl.h>	//(Chimpchi) Microsoft, I hate your piss poor naming so much...
 std::filesystem::path uph_select_folder_dialog(const wchar_t* title) {
     IFileDialog* pfd = nullptr;
@@ -430,4 +432,94 @@ std::filesystem::path uph_select_folder_dialog(const wchar_t* title) {
 }
 
 
-#endif
\ No newline at end of file
+bool uph_run_self_process(const std::vector<std::string> &args, uint32_t timeout_ms,
+    const std::atomic<bool> *cancel, std::string *output)
+{
+    WCHAR executable[MAX_PATH];
+    if (!GetModuleFileNameW(NULL, executable, MAX_PATH))
+        return false;
+
+    std::wstring command_line = L"\"" + std::wstring(executable) + L"\"";
+    for (const std::string &arg : args)
+    {
+        std::wstring wide(arg.size() + 1, L'\0');
+        create_wide_string_from_utf8(arg.c_str(), wide.data());
+        wide.resize(wcslen(wide.c_str()));
+        command_line += L" \"" + wide + L"\"";
+    }
+
+    SECURITY_ATTRIBUTES security = { sizeof(security), NULL, TRUE };
+    HANDLE read_pipe, write_pipe;
+    if (!CreatePipe(&read_pipe, &write_pipe, &security, 0))
+        return false;
+    SetHandleInformation(read_pipe, HANDLE_FLAG_INHERIT, 0);
+
+    STARTUPINFOW startup_info{};
+    startup_info.cb = sizeof(startup_info);
+    startup_info.dwFlags = STARTF_USESTDHANDLES;
+    startup_info.hStdOutput = write_pipe;
+    startup_info.hStdError = GetStdHandle(STD_ERROR_HANDLE);
+    startup_info.hStdInput = GetStdHandle(STD_INPUT_HANDLE);
+
+    PROCESS_INFORMATION process_info{};
+    const BOOL created = CreateProcessW(executable, command_line.data(), NULL, NULL, TRUE,
+        CREATE_NO_WINDOW, NULL, NULL, &startup_info, &process_info);
+    CloseHandle(write_pipe);
+    if (!created)
+    {
+        CloseHandle(read_pipe);
+        return false;
+    }
+
+    const ULONGLONG deadline = GetTickCount64() + timeout_ms;
+    bool timed_out = false;
+    char buffer[4096];
+    for (;;)
+    {
+        DWORD available = 0;
+        if (!PeekNamedPipe(read_pipe, NULL, 0, NULL, &available, NULL))
+            break;
+
+        if (available > 0)
+        {
+            DWORD count = 0;
+            if (!ReadFile(read_pipe, buffer, available < sizeof(buffer) ? available : (DWORD)sizeof(buffer), &count, NULL) || count == 0)
+                break;
+            output->append(buffer, count);
+            continue;
+        }
+
+        if (GetTickCount64() >= deadline || (cancel && cancel->load()))
+        {
+            timed_out = true;
+            break;
+        }
+        Sleep(5);
+    }
+    CloseHandle(read_pipe);
+
+    if (timed_out)
+        TerminateProcess(process_info.hProcess, 1);
+
+    WaitForSingleObject(process_info.hProcess, INFINITE);
+    DWORD exit_code = 1;
+    GetExitCodeProcess(process_info.hProcess, &exit_code);
+    CloseHandle(process_info.hThread);
+    CloseHandle(process_info.hProcess);
+    return !timed_out && exit_code == 0;
+}
+
+std::filesystem::path uph_config_directory(void)
+{
+    std::filesystem::path directory = std::filesystem::temp_directory_path() / "uphonic";
+    PWSTR app_data = NULL;
+    if (SUCCEEDED(SHGetKnownFolderPath(FOLDERID_RoamingAppData, 0, NULL, &app_data)))
+        directory = std::filesystem::path(app_data) / "uphonic";
+    CoTaskMemFree(app_data);
+
+    std::error_code error;
+    std::filesystem::create_directories(directory, error);
+    return directory;
+}
+
+#endif
@@ -1,64 +1,329 @@
 #include "plugin_loader.h"
 #include "platform/platform.h"
+#include "engine/engine.h"
+#include "engine/render_snapshot.h"
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
 #include <cstdio>
 #include <cstdlib>
+#include <deque>
+#include <mutex>
 #include <queue>
 #include <string>
+#include <thread>
+#include <vector>
 
-struct UphPluginLoadRequest
+enum UphPluginJobType : uint8_t
 {
+    UphPluginJobType_Load,
+    UphPluginJobType_Unload
+};
+
+struct UphPluginJob
+{
+    UphPluginJobType type;
+    uint64_t id = 0;
     std::string path;
+    UviPlugin *plugin = nullptr;
+};
+
+struct UphPluginHost
+{
+    std::thread thread;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::deque<UphPluginJob> jobs;
+    std::vector<UphPluginJob> finished_loads;
+    uint64_t active_load = 0;
+    bool stop = false;
+};
+
+// Loads the main loop is waiting on, at most one per track.
+struct UphPendingLoad
+{
+    uint64_t id;
     uint32_t track_index;
+    std::string path;
+    std::chrono::steady_clock::time_point queued_at;
 };
 
-static std::queue<UphPluginLoadRequest> queued_plugin_loads;
+static UphPluginHost plugin_host;
+static std::vector<UphPendingLoad> pending_loads;
 static std::queue<uint32_t> queued_plugin_unloads;
+static uint64_t next_load_id = 1;
 
-static UphInstrument uph_load_vst2_internal(const char* path)
+static void uph_plugin_host_thread(void)
 {
-    UviPlugin plugin = uvi_plugin_load(path);
-    UphChildWindow child_window = {0};
-    uint32_t width, height;
-    plugin.get_editor_size(&plugin, &width, &height);
-    
-    const UphChildWindowCreateInfo child_window_create_info = {width, height, plugin.name};
-    child_window = uph_create_child_window(&child_window_create_info);
-    plugin.open_editor(&plugin, child_window.handle);
+    std::unique_lock<std::mutex> lock(plugin_host.mutex);
+    for (;;)
+    {
+        plugin_host.wake.wait(lock, [] { return plugin_host.stop || !plugin_host.jobs.empty(); });
+        if (plugin_host.jobs.empty())
+            return;
 
-    UphInstrument instrument;
-    instrument.plugin = plugin;
-    instrument.window = child_window;
-    strncpy_s(instrument.path, path, sizeof(instrument.path));
+        UphPluginJob job = std::move(plugin_host.jobs.front());
+        plugin_host.jobs.pop_front();
+
+        // Unloads still run when stopping, nobody is left to pick up a load.
+        if (plugin_host.stop && job.type == UphPluginJobType_Load)
+            continue;
+
+        plugin_host.active_load = job.type == UphPluginJobType_Load ? job.id : 0;
+        lock.unlock();
+
+        if (job.type == UphPluginJobType_Load)
+        {
+            UviPlugin plugin = uvi_plugin_create(job.path.c_str());
+            if (plugin.is_loaded)
+                job.plugin = new UviPlugin(plugin);
+            else
+                fprintf(stderr, "Failed to load plugin %s\n", job.path.c_str());
+        }
+        else
+        {
+            uvi_plugin_unload(job.plugin);
+            delete job.plugin;
+        }
+
+        lock.lock();
+        plugin_host.active_load = 0;
+        if (job.type == UphPluginJobType_Load)
+            plugin_host.finished_loads.push_back(std::move(job));
+    }
+}
+
+static void uph_plugin_host_post(UphPluginJob job)
+{
+    {
+        std::lock_guard<std::mutex> lock(plugin_host.mutex);
+        plugin_host.jobs.push_back(std::move(job));
+    }
+    plugin_host.wake.notify_one();
+}
+
+// Drops a load that was superseded before it was swapped in, a job that has
+// not started yet is simply taken off the queue.
+static void uph_cancel_instrument_load(uint32_t track_index)
+{
+    auto it = std::find_if(pending_loads.begin(), pending_loads.end(), [&](const UphPendingLoad &load) {
+        return load.track_index == track_index;
+    });
+    if (it == pending_loads.end())
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(plugin_host.mutex);
+        std::erase_if(plugin_host.jobs, [id = it->id](const UphPluginJob &job) {
+            return job.type == UphPluginJobType_Load && job.id == id;
+        });
+    }
+    pending_loads.erase(it);
+}
+
+// For plugins that never reached a track. CLAP only allows tearing down on
+// the main thread, everything else goes back to the plugin-host thread.
+static void uph_discard_plugin(UviPlugin *plugin)
+{
+    if (plugin->type == UviPluginType_Clap)
+    {
+        uvi_plugin_unload(plugin);
+        delete plugin;
+        return;
+    }
+
+    UphPluginJob job;
+    job.type = UphPluginJobType_Unload;
+    job.plugin = plugin;
+    uph_plugin_host_post(std::move(job));
+}
+
+// Runs once the audio thread can no longer see the instrument.
+static void uph_release_instrument(void *data)
+{
+    UphInstrument *instrument = (UphInstrument*)data;
+    uvi_plugin_unload(instrument->plugin);
+
+    if (instrument->window.handle)
+        uph_destroy_child_window(&instrument->window);
+
+    delete instrument->plugin;
+    delete instrument;
+}
+
+// Restarts are keyed by track index, like unloads.
+struct UphInstrumentRestart
+{
+    uint32_t track_index;
+    UviPlugin *plugin;
+};
+
+// Runs once the audio thread can no longer see the plugin. It may have
+// been released or replaced meanwhile, those were deferred later.
+static void uph_restart_instrument(void *data)
+{
+    UphInstrumentRestart *restart = (UphInstrumentRestart*)data;
+    std::vector<UphTrack> &tracks = app->project.tracks;
+    if (restart->track_index < tracks.size() && tracks[restart->track_index].instrument.plugin == restart->plugin)
+    {
+        UphInstrument &instrument = tracks[restart->track_index].instrument;
+        uvi_plugin_restart(instrument.plugin);
+        instrument.is_restarting = false;
+    }
+    delete restart;
+}
+
+void uph_plugin_loader_start(void)
+{
+    uph_plugin_loader_shutdown();
+
+    plugin_host.stop = false;
+    plugin_host.thread = std::thread(uph_plugin_host_thread);
+}
+
+void uph_plugin_loader_shutdown(void)
+{
+    if (!plugin_host.thread.joinable())
+        return;
 
-    return instrument;
+    // Waits for the plugin being instantiated, there is no way to interrupt it.
+    {
+        std::lock_guard<std::mutex> lock(plugin_host.mutex);
+        plugin_host.stop = true;
+    }
+    plugin_host.wake.notify_one();
+    plugin_host.thread.join();
+
+    // On the main thread, so CLAP plugins can be destroyed here as well.
+    for (UphPluginJob &job : plugin_host.finished_loads)
+    {
+        if (!job.plugin)
+            continue;
+        uvi_plugin_unload(job.plugin);
+        delete job.plugin;
+    }
+    plugin_host.finished_loads.clear();
+    pending_loads.clear();
 }
 
 void uph_queue_instrument_load(const char *path, uint32_t track_index)
 {
     if (!path) return;
-    
-    UphPluginLoadRequest request;
-    request.path = path;
-    request.track_index = track_index;
-    queued_plugin_loads.push(request);
+
+    uph_cancel_instrument_load(track_index);
+
+    UphPendingLoad load;
+    load.id = next_load_id++;
+    load.track_index = track_index;
+    load.path = path;
+    load.queued_at = std::chrono::steady_clock::now();
+    pending_loads.push_back(load);
+
+    UphPluginJob job;
+    job.type = UphPluginJobType_Load;
+    job.id = load.id;
+    job.path = path;
+    uph_plugin_host_post(std::move(job));
 }
 
 void uph_queue_instrument_unload(uint32_t track_index)
 {
+    uph_cancel_instrument_load(track_index);
     queued_plugin_unloads.push(track_index);
-    app->project.tracks[track_index].instrument.plugin.is_loaded = false;
+}
+
+bool uph_instrument_load_status(uint32_t track_index, UphInstrumentLoadStatus *status)
+{
+    for (const UphPendingLoad &load : pending_loads)
+    {
+        if (load.track_index != track_index)
+            continue;
+
+        status->path = load.path.c_str();
+        status->seconds = std::chrono::duration<float>(std::chrono::steady_clock::now() - load.queued_at).count();
+
+        std::lock_guard<std::mutex> lock(plugin_host.mutex);
+        status->is_started = plugin_host.active_load == load.id;
+        return true;
+    }
+    return false;
+}
+
+static void uph_swap_in_instrument(UphPluginJob &job)
+{
+    auto it = std::find_if(pending_loads.begin(), pending_loads.end(), [&](const UphPendingLoad &load) {
+        return load.id == job.id;
+    });
+
+    if (it == pending_loads.end() || it->track_index >= app->project.tracks.size())
+    {
+        if (it != pending_loads.end())
+            pending_loads.erase(it);
+        if (job.plugin)
+            uph_discard_plugin(job.plugin);
+        return;
+    }
+
+    UphInstrument &instrument = app->project.tracks[it->track_index].instrument;
+    pending_loads.erase(it);
+
+    // The main thread half of loading, CLAP plugins are only initialised
+    // and activated here. Plugins with more channels than the engine can
+    // bind would write through pointers they were never given. Either way
+    // the track ends up as if the load had failed.
+    if (job.plugin && !uvi_plugin_initialize(job.plugin))
+    {
+        fprintf(stderr, "Failed to initialise plugin %s\n", job.path.c_str());
+        uph_discard_plugin(job.plugin);
+        job.plugin = nullptr;
+    }
+    else if (job.plugin && (job.plugin->num_inputs > UPH_ENGINE_MAX_CHANNELS || job.plugin->num_outputs > UPH_ENGINE_MAX_CHANNELS))
+    {
+        fprintf(stderr, "Plugin %s has more than %d channels\n", job.path.c_str(), UPH_ENGINE_MAX_CHANNELS);
+        uph_discard_plugin(job.plugin);
+        job.plugin = nullptr;
+    }
+
+    // Unloads were processed first, so the slot only holds a plugin when the
+    // track was loaded again in the meantime.
+    if (instrument.plugin)
+        uph_render_snapshot_defer_free(uph_release_instrument, new UphInstrument(instrument));
+
+    instrument = {};
+    strncpy_s(instrument.path, job.path.c_str(), sizeof(instrument.path));
+    if (!job.plugin)
+        return;
+
+    // Loaded with the host info of when the job started, the device may
+    // have been reconfigured since.
+    UviPlugin *plugin = job.plugin;
+    uvi_plugin_reconfigure(plugin);
+
+    // Editors belong to the main loop's thread.
+    if (plugin->open_editor)
+    {
+        uint32_t width, height;
+        plugin->get_editor_size(plugin, &width, &height);
+
+        const UphChildWindowCreateInfo child_window_create_info = {width, height, plugin->name};
+        instrument.window = uph_create_child_window(&child_window_create_info);
+        plugin->open_editor(plugin, instrument.window.handle);
+    }
+
+    // Only published with the next snapshot, fully initialised by now.
+    instrument.plugin = plugin;
 }
 
 void uph_process_instrument_loads(void)
 {
-    while (!queued_plugin_loads.empty())
+    std::vector<UphPluginJob> finished_loads;
     {
-        UphPluginLoadRequest request = queued_plugin_loads.front();
-        queued_plugin_loads.pop();
-        
-        UphInstrument &instrument = app->project.tracks[request.track_index].instrument;
-        instrument = uph_load_vst2_internal(request.path.c_str());
+        std::lock_guard<std::mutex> lock(plugin_host.mutex);
+        finished_loads.swap(plugin_host.finished_loads);
     }
+
+    for (UphPluginJob &job : finished_loads)
+        uph_swap_in_instrument(job);
 }
 
 void uph_process_instrument_unloads(void)
@@ -67,12 +332,58 @@ void uph_process_instrument_unloads(void)
     {
         uint32_t track_index = queued_plugin_unloads.front();
         queued_plugin_unloads.pop();
+        if (track_index >= app->project.tracks.size())
+            continue;
 
         UphInstrument &instrument = app->project.tracks[track_index].instrument;
-        uvi_plugin_unload(&instrument.plugin);
-        
-        if (instrument.window.handle)
-            uph_destroy_child_window(&instrument.window);
+        if (!instrument.plugin)
+            continue;
+
+        uph_render_snapshot_defer_free(uph_release_instrument, new UphInstrument(instrument));
+        instrument.plugin = nullptr;
+        instrument.window = {};
+    }
+}
+
+void uph_plugin_loader_release_project(void)
+{
+    {
+        std::lock_guard<std::mutex> lock(plugin_host.mutex);
+        std::erase_if(plugin_host.jobs, [](const UphPluginJob &job) {
+            return job.type == UphPluginJobType_Load;
+        });
+    }
+
+    // Loads already running or finished find no pending entry and are
+    // discarded when they come back.
+    pending_loads.clear();
+    queued_plugin_unloads = {};
+
+    for (UphTrack &track : app->project.tracks)
+    {
+        UphInstrument &instrument = track.instrument;
+        if (!instrument.plugin)
+            continue;
+
+        uph_render_snapshot_defer_free(uph_release_instrument, new UphInstrument(instrument));
+        instrument.plugin = nullptr;
+        instrument.window = {};
+    }
+}
+
+void uph_process_instrument_idle(void)
+{
+    std::vector<UphTrack> &tracks = app->project.tracks;
+    for (uint32_t i = 0; i < tracks.size(); ++i)
+    {
+        UphInstrument &instrument = tracks[i].instrument;
+        if (!instrument.plugin || !uvi_plugin_idle(instrument.plugin) || instrument.is_restarting)
+            continue;
+
+        // Taken off the track with the next snapshot and restarted once the
+        // audio thread is past the current one.
+        instrument.is_restarting = true;
+        uph_render_snapshot_defer_free(uph_restart_instrument, new UphInstrumentRestart{ i, instrument.plugin });
     }
 }
 
@@ -80,4 +391,5 @@ void uph_process_plugin_loader(void)
 {
     uph_process_instrument_unloads();
     uph_process_instrument_loads();
-}
\ No newline at end of file
+    uph_process_instrument_idle();
+}
@@ -1,6 +1,34 @@
 #pragma once
 #include "types.h"
 
+// Plugins are instantiated and torn down on a dedicated plugin-host thread.
+// A finished load is handed back to the main loop, which does what has to
+// happen on the main thread (initialising CLAP plugins, opening the editor)
+// and swaps it into the track, so the next published snapshot is the first
+// place the audio thread sees it.
+
+struct UphInstrumentLoadStatus
+{
+    const char *path;
+    float seconds;   // since the load was queued
+    bool is_started; // false while waiting behind other plugin work
+};
+
+void uph_plugin_loader_start(void);
+void uph_plugin_loader_shutdown(void);
+
 void uph_queue_instrument_load(const char *path, uint32_t track_index);
 void uph_queue_instrument_unload(uint32_t track_index);
-void uph_process_plugin_loader(void);
\ No newline at end of file
+
+// Main loop, every frame. Also serves the callbacks and restarts plugins
+// asked for, a restarting plugin sits out until the audio thread is done
+// with it.
+void uph_process_plugin_loader(void);
+
+// Before app->project is replaced. Loads and unloads are keyed by track
+// index, so everything pending is cancelled, and the instruments of the
+// outgoing project are released once the audio thread is done with them.
+void uph_plugin_loader_release_project(void);
+
+// False when nothing is loading into the track.
+bool uph_instrument_load_status(uint32_t track_index, UphInstrumentLoadStatus *status);
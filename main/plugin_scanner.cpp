@@ -0,0 +1,277 @@
+#include "plugin_scanner.h"
+#include "platform/platform.h"
+
+#include <uvi_loader.h>
+#include <nlohmann/json.hpp>
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <thread>
+
+#define UPH_PLUGIN_PROBE_PREFIX "UPH_PROBE "
+
+static const char *k_plugin_cache_name = "plugin_cache.json";
+static const uint32_t k_plugin_cache_version = 1;
+static const uint32_t k_probe_timeout_ms = 15000;
+
+struct UphPluginScanner
+{
+    std::thread thread;
+    std::atomic<bool> stop = false;
+    std::atomic<uint32_t> probed = 0;
+    std::atomic<uint32_t> to_probe = 0;
+
+    std::mutex mutex;
+    std::vector<UphPluginInfo> plugins;
+    uint32_t generation = 0;
+};
+
+static UphPluginScanner scanner;
+
+static std::vector<std::filesystem::path> uph_plugin_scanner_directories(void)
+{
+#if UPH_PLATFORM_WINDOWS
+    return {
+        "C:\\Program Files\\Steinberg\\VstPlugins",
+        "C:\\Program Files\\VstPlugins",
+        "C:\\Program Files\\Common Files\\CLAP"
+    };
+#else
+    std::vector<std::filesystem::path> directories = { "/usr/lib/vst", "/usr/local/lib/vst", "/usr/lib/clap", "/usr/local/lib/clap" };
+    if (const char *home = getenv("HOME"))
+    {
+        directories.push_back(std::filesystem::path(home) / ".vst");
+        directories.push_back(std::filesystem::path(home) / ".clap");
+    }
+    return directories;
+#endif
+}
+
+static bool uph_plugin_scanner_is_plugin(const std::filesystem::path &path)
+{
+    const std::filesystem::path extension = path.extension();
+    return extension == ".dll" || extension == ".so" || extension == ".dylib" ||
+        extension == ".vst3" || extension == ".vst2" || extension == ".vst" ||
+        extension == ".uvi" || extension == ".clap";
+}
+
+static nlohmann::json uph_plugin_info_to_json(const UphPluginInfo &info)
+{
+    return {
+        { "path", info.path }, { "name", info.name }, { "vendor", info.vendor },
+        { "inputs", info.num_inputs }, { "outputs", info.num_outputs },
+        { "synth", info.is_synth }, { "valid", info.is_valid },
+        { "mtime", info.mtime }, { "size", info.size }
+    };
+}
+
+static UphPluginInfo uph_plugin_info_from_json(const nlohmann::json &json)
+{
+    UphPluginInfo info;
+    info.path = json.value("path", "");
+    info.name = json.value("name", "");
+    info.vendor = json.value("vendor", "");
+    info.num_inputs = json.value("inputs", 0);
+    info.num_outputs = json.value("outputs", 0);
+    info.is_synth = json.value("synth", false);
+    info.is_valid = json.value("valid", false);
+    info.mtime = json.value("mtime", (int64_t)0);
+    info.size = json.value("size", (uint64_t)0);
+    return info;
+}
+
+static std::map<std::string, UphPluginInfo> uph_plugin_cache_load(void)
+{
+    std::map<std::string, UphPluginInfo> cache;
+
+    std::ifstream file(uph_config_directory() / k_plugin_cache_name);
+    if (!file)
+        return cache;
+
+    nlohmann::json json = nlohmann::json::parse(file, nullptr, false);
+    if (json.is_discarded() || json.value("version", 0u) != k_plugin_cache_version || !json.contains("plugins"))
+        return cache;
+
+    for (const nlohmann::json &entry : json["plugins"])
+    {
+        UphPluginInfo info = uph_plugin_info_from_json(entry);
+        if (!info.path.empty())
+            cache[info.path] = info;
+    }
+    return cache;
+}
+
+static void uph_plugin_cache_save(const std::map<std::string, UphPluginInfo> &entries)
+{
+    nlohmann::json plugins = nlohmann::json::array();
+    for (const auto &[path, info] : entries)
+        plugins.push_back(uph_plugin_info_to_json(info));
+
+    const std::filesystem::path path = uph_config_directory() / k_plugin_cache_name;
+    std::ofstream file(path);
+    if (!file)
+    {
+        fprintf(stderr, "[Plugin Scanner] Failed to write %s\n", path.string().c_str());
+        return;
+    }
+    file << nlohmann::json{ { "version", k_plugin_cache_version }, { "plugins", plugins } }.dump(1, ' ', false, nlohmann::json::error_handler_t::replace);
+}
+
+static void uph_plugin_scanner_publish(const std::map<std::string, UphPluginInfo> &entries)
+{
+    std::vector<UphPluginInfo> plugins;
+    plugins.reserve(entries.size());
+    for (const auto &[path, info] : entries)
+        plugins.push_back(info);
+
+    std::lock_guard<std::mutex> lock(scanner.mutex);
+    scanner.plugins = std::move(plugins);
+    ++scanner.generation;
+}
+
+static UphPluginInfo uph_plugin_scanner_run_probe(const UphPluginInfo &file)
+{
+    UphPluginInfo info = file;
+    info.name = std::filesystem::path(file.path).stem().string();
+    info.is_valid = false;
+
+    std::string output;
+    const bool exited_cleanly = uph_run_self_process({ UPH_PLUGIN_PROBE_ARG, file.path }, k_probe_timeout_ms, &scanner.stop, &output);
+
+    // Plugins are free to print whatever they like, only the prefixed line
+    // is ours.
+    const size_t start = output.find(UPH_PLUGIN_PROBE_PREFIX);
+    if (!exited_cleanly || start == std::string::npos)
+    {
+        fprintf(stderr, "[Plugin Scanner] Probe failed for %s\n", file.path.c_str());
+        return info;
+    }
+
+    const size_t json_start = start + strlen(UPH_PLUGIN_PROBE_PREFIX);
+    nlohmann::json json = nlohmann::json::parse(output.substr(json_start, output.find('\n', json_start) - json_start), nullptr, false);
+    if (json.is_discarded())
+        return info;
+
+    info.name = json.value("name", info.name);
+    info.vendor = json.value("vendor", "");
+    info.num_inputs = json.value("inputs", 0);
+    info.num_outputs = json.value("outputs", 0);
+    info.is_synth = json.value("synth", false);
+    info.is_valid = true;
+    return info;
+}
+
+static void uph_plugin_scanner_thread(void)
+{
+    std::map<std::string, UphPluginInfo> cache = uph_plugin_cache_load();
+    uph_plugin_scanner_publish(cache);
+
+    std::map<std::string, UphPluginInfo> entries;
+    std::vector<UphPluginInfo> changed;
+    for (const std::filesystem::path &directory : uph_plugin_scanner_directories())
+    {
+        std::error_code error;
+        std::filesystem::recursive_directory_iterator it(directory, std::filesystem::directory_options::skip_permission_denied, error);
+        for (; !error && it != std::filesystem::recursive_directory_iterator(); it.increment(error))
+        {
+            std::error_code entry_error;
+            if (!it->is_regular_file(entry_error) || !uph_plugin_scanner_is_plugin(it->path()))
+                continue;
+
+            UphPluginInfo file;
+            file.path = it->path().string();
+            file.mtime = (int64_t)it->last_write_time(entry_error).time_since_epoch().count();
+            file.size = (uint64_t)it->file_size(entry_error);
+
+            auto cached = cache.find(file.path);
+            if (cached != cache.end() && cached->second.mtime == file.mtime && cached->second.size == file.size)
+                entries[file.path] = cached->second;
+            else
+                changed.push_back(file);
+        }
+    }
+
+    // Removed files drop out here, changed ones show up as they are probed.
+    uph_plugin_scanner_publish(entries);
+    scanner.to_probe.store((uint32_t)changed.size());
+
+    for (const UphPluginInfo &file : changed)
+    {
+        if (scanner.stop.load())
+            break;
+
+        // A cancelled probe says nothing about the plugin, it is probed
+        // again next time rather than cached as invalid.
+        UphPluginInfo info = uph_plugin_scanner_run_probe(file);
+        if (scanner.stop.load())
+            break;
+
+        entries[file.path] = info;
+        scanner.probed.fetch_add(1);
+        uph_plugin_scanner_publish(entries);
+    }
+
+    if (!changed.empty() || entries.size() != cache.size())
+        uph_plugin_cache_save(entries);
+}
+
+void uph_plugin_scanner_start(void)
+{
+    uph_plugin_scanner_shutdown();
+
+    scanner.stop.store(false);
+    scanner.probed.store(0);
+    scanner.to_probe.store(0);
+    scanner.thread = std::thread(uph_plugin_scanner_thread);
+}
+
+void uph_plugin_scanner_shutdown(void)
+{
+    if (!scanner.thread.joinable())
+        return;
+
+    // The probe in flight is killed within a poll interval.
+    scanner.stop.store(true);
+    scanner.thread.join();
+}
+
+bool uph_plugin_scanner_poll(std::vector<UphPluginInfo> *plugins, uint32_t *generation)
+{
+    std::lock_guard<std::mutex> lock(scanner.mutex);
+    if (*generation == scanner.generation)
+        return false;
+
+    *plugins = scanner.plugins;
+    *generation = scanner.generation;
+    return true;
+}
+
+void uph_plugin_scanner_progress(uint32_t *probed, uint32_t *to_probe)
+{
+    *probed = scanner.probed.load();
+    *to_probe = scanner.to_probe.load();
+}
+
+int uph_plugin_scanner_probe(const char *path)
+{
+    UviPlugin plugin = uvi_plugin_load(path);
+    if (!plugin.is_loaded)
+        return 1;
+
+    const nlohmann::json json = {
+        { "name", plugin.name }, { "vendor", plugin.vendor },
+        { "inputs", plugin.num_inputs }, { "outputs", plugin.num_outputs },
+        { "synth", plugin.is_synth }
+    };
+    printf(UPH_PLUGIN_PROBE_PREFIX "%s\n", json.dump(-1, ' ', false, nlohmann::json::error_handler_t::replace).c_str());
+    fflush(stdout);
+
+    uvi_plugin_unload(&plugin);
+    return 0;
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Finds plugins in the default directories on a background thread. Every
+// file is probed in a child process, so a plugin that crashes while loading
+// only takes the probe down. Results are cached on disk and a file is only
+// probed again once its size or modification time changes.
+
+#define UPH_PLUGIN_PROBE_ARG "--probe-plugin"
+
+struct UphPluginInfo
+{
+    std::string path;
+    std::string name;
+    std::string vendor;
+    int32_t num_inputs = 0;
+    int32_t num_outputs = 0;
+    bool is_synth = false;
+    bool is_valid = false;  // false when the probe failed, crashed or timed out
+    int64_t mtime = 0;
+    uint64_t size = 0;
+};
+
+void uph_plugin_scanner_start(void);
+void uph_plugin_scanner_shutdown(void);
+
+// Copies the plugin list when it changed since *generation.
+bool uph_plugin_scanner_poll(std::vector<UphPluginInfo> *plugins, uint32_t *generation);
+
+// Files probed so far out of those that needed probing.
+void uph_plugin_scanner_progress(uint32_t *probed, uint32_t *to_probe);
+
+// Entry point of the child process, prints what it found and exits.
+int uph_plugin_scanner_probe(const char *path);
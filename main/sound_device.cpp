@@ -1,362 +1,239 @@
 #include "sound_device.h"
+#include "engine/engine.h"
+#include "engine/interpolation.h"
+#include "engine/profiler.h"
+#include "engine/realtime.h"
+#include "engine/render_snapshot.h"
+#include "engine/resampler.h"
 
 #include <miniaudio.h>
 
 #include <iostream>
 #include <algorithm>
+#include <chrono>
 #include <filesystem>
 #include <cmath>
-
-constexpr float PI = 3.14159265358979323846f;
-constexpr float HALF_PI = PI * 0.5f;
+#include <thread>
 
 struct UphSoundDevice
 {
+    ma_context context;
     ma_device device;
-    uint32_t block_size = 512;
-
-    struct UphSoundDeviceIO
-    {
-        float inputs[64][512];
-        float outputs[64][512];
-    }
-    *io;
+    bool has_context = false;
+    bool is_initialized = false;
+    UphSoundDeviceConfig config;
+
+    // The engine runs at the project's processing rate and is converted to
+    // the device rate only when the two differ.
+    uint32_t processing_rate = 0;   // project setting the device was opened with
+    uint32_t engine_rate = 0;
+    UphResampler *resampler = nullptr;
 };
 
 static UphSoundDevice sound_device;
 
-static void uph_midi_pattern_process_playback_for_block(
-    UviPlugin *plugin, UphMidiPattern *pattern,
-    float sec_per_beat, float prev_beat, float new_beat,
-    float sample_rate, float frame_count,
-    float start_time = 0.0f,
-    float start_offset = 0.0f,
-    float length = INT32_MAX
-)
+static void uph_sound_device_render_engine(float *output, uint32_t frame_count, void *user)
 {
-    int microOffset = 0;
-    int lastSampleOffset = -1;
-
-    int noteOnMicroOffset = 0;
-    int noteOffMicroOffset = 0;
-    int lastNoteOnSample = -1;
-    int lastNoteOffSample = -1;
-
-    auto queue_event = [&](bool note_on, int pitch, int velocity, float event_beat)
-    {
-        float noteTimeSec = event_beat * sec_per_beat;
-        float prevTimeSec = prev_beat * sec_per_beat;
-        int sample_offset = int((noteTimeSec - prevTimeSec) * sample_rate);
-        sample_offset = std::clamp(sample_offset, 0, (int)frame_count - 1);
-
-        if (note_on)
-        {
-            if (sample_offset == lastNoteOnSample)
-            {
-                noteOnMicroOffset++;
-                sample_offset = std::clamp(sample_offset + noteOnMicroOffset, 0, (int)frame_count - 1);
-            } else {
-                noteOnMicroOffset = 0;
-                lastNoteOnSample = sample_offset;
-            }
-            plugin->play_note(plugin, pitch, velocity, sample_offset);
-        }
-        else
-        {
-            if (sample_offset == lastNoteOffSample)
-            {
-                noteOffMicroOffset++;
-                sample_offset = std::clamp(sample_offset + noteOffMicroOffset, 0, (int)frame_count - 1);
-            } else {
-                noteOffMicroOffset = 0;
-                lastNoteOffSample = sample_offset;
-            }
-            plugin->stop_note(plugin, pitch, sample_offset);
-        }
-    };
-
-    for (auto &note : pattern->notes)
-    {
-        const float original_start = note.start + start_time;
-        const float original_end   = original_start + note.length - 0.01f;
-
-        const float note_start = std::clamp<float>(
-            original_start - start_offset,
-            start_time,
-            start_time + length
-        );
-
-        const float note_end = std::clamp<float>(
-            original_end - start_offset,
-            0.0f,
-            start_time + length
-        );
-
-        if (note_end <= note_start)
-            continue;
-
-        if (note_end >= prev_beat && note_end < new_beat)
-            queue_event(false, note.key, 0, note_end);
-
-        if (note_start >= prev_beat && note_start < new_beat)
-            queue_event(true, note.key, note.velocity, note_start);
-    }
+    uph_engine_render(output, frame_count, (float)sound_device.engine_rate);
 }
 
-static void uph_midi_editor_process_playback_for_block(float sample_rate, float frame_count)
+static void uph_audio_callback(ma_device* p_device, void* p_output, const void* p_input, ma_uint32 frame_count)
 {
-    const float sec_per_beat = 60.0f / app->project.bpm;
-    float prev_beat = app->midi_editor_song_position;
-    float new_beat = prev_beat + frame_count / sample_rate / sec_per_beat;
-
-    UviPlugin *plugin = &app->project.tracks[app->current_track_index].instrument.plugin;
-    if (plugin->is_loaded)
-        uph_midi_pattern_process_playback_for_block(
-            plugin,
-            &app->project.patterns[app->current_pattern_index],
-            sec_per_beat, prev_beat, new_beat,
-            sample_rate, frame_count
-        );
-
-    app->midi_editor_song_position = new_beat;
+    uph_realtime_setup_thread(UphRealtimeRole_Audio, 0);
+    uph_realtime_flush_denormals();
+
+    const uint64_t start = uph_profiler_now_ns();
+    if (sound_device.resampler)
+        uph_resampler_process(sound_device.resampler, (float*)p_output, frame_count, uph_sound_device_render_engine, nullptr);
+    else
+        uph_engine_render((float*)p_output, frame_count, (float)p_device->sampleRate);
+    uph_profiler_record_callback(uph_profiler_now_ns() - start, frame_count, (float)p_device->sampleRate);
 }
 
-static void uph_song_timeline_process_playback_for_block(float sample_rate, float frame_count)
+// Fixed size callbacks, so every callback is exactly one period.
+static uint32_t uph_sound_device_period(void)
 {
-    const float prev_beat = app->song_timeline_song_position;
-
-    const float sec_per_beat = 60.0f / app->project.bpm;
-    float new_beat = prev_beat + frame_count / sample_rate / sec_per_beat;
-
-    std::vector<UphTrack> &tracks = app->project.tracks;
-    for (auto &track : tracks)
-    {
-        if (track.track_type == UphTrackType_Midi)
-        {
-            UviPlugin *plugin = &track.instrument.plugin;
-            if (!plugin->is_loaded)
-                continue;
-            for (auto &pattern_instance : track.timeline_blocks)
-            {
-                UphMidiPattern &pattern = app->project.patterns[pattern_instance.pattern_index];
-                uph_midi_pattern_process_playback_for_block(
-                    plugin,
-                    &pattern,
-                    sec_per_beat, prev_beat, new_beat,
-                    sample_rate, frame_count,
-                    pattern_instance.start_time,
-                    pattern_instance.start_offset,
-                    pattern_instance.length
-                );
-            }
-        }
-    }
-
-    app->song_timeline_song_position = new_beat;
+    const ma_device *device = &sound_device.device;
+    return device->playback.intermediaryBufferCap ? device->playback.intermediaryBufferCap : device->playback.internalPeriodSizeInFrames;
 }
 
-static inline void uph_audio_stop_all_notes(std::vector<UphTrack> &tracks)
+static bool uph_sound_device_find(const char *name, ma_device_id *id)
 {
-    for (auto &track : tracks)
+    if (!sound_device.has_context || !name[0])
+        return false;
+
+    ma_device_info *infos;
+    ma_uint32 count;
+    if (ma_context_get_devices(&sound_device.context, &infos, &count, NULL, NULL) != MA_SUCCESS)
+        return false;
+
+    for (ma_uint32 i = 0; i < count; ++i)
     {
-        if (track.track_type == UphTrackType_Midi)
+        if (strcmp(infos[i].name, name) == 0)
         {
-            UviPlugin *plugin = &track.instrument.plugin;
-            if (!plugin->is_loaded)
-                continue;
-            plugin->stop_all_notes(plugin);
+            *id = infos[i].id;
+            return true;
         }
     }
+    return false;
 }
 
-static void uph_audio_callback(ma_device* p_device, void* p_output, const void* p_input, ma_uint32 frame_count)
+static bool uph_sound_device_open(const UphSoundDeviceConfig *config)
 {
-    float* output = (float*)p_output;
-    std::vector<UphTrack> &tracks = app->project.tracks;
+    sound_device.processing_rate = app->project.processing_rate;
 
-    static float *inputs[64] = { 0 };
-    static float *outputs[64] = { 0 };
+    ma_device_id device_id;
+    const bool has_device_id = uph_sound_device_find(config->device_name, &device_id);
+    if (config->device_name[0] && !has_device_id)
+        std::cerr << "Audio device " << config->device_name << " not found, using the default\n";
 
-    for (int i = 0; i < 64; ++i)
+    ma_device_config device_config = ma_device_config_init(ma_device_type_playback);
+    device_config.playback.pDeviceID  = has_device_id ? &device_id : NULL;
+    device_config.playback.format     = ma_format_f32;
+    device_config.playback.channels   = 2;
+    device_config.sampleRate          = config->sample_rate;
+    device_config.periodSizeInFrames  = config->period_size;
+    device_config.dataCallback        = uph_audio_callback;
+
+    if (ma_device_init(sound_device.has_context ? &sound_device.context : NULL, &device_config, &sound_device.device) != MA_SUCCESS)
     {
-        inputs[i] = sound_device.io->inputs[i];
-        outputs[i] = sound_device.io->outputs[i];
+        std::cerr << "Failed to initialize audio device\n";
+        return false;
     }
+    sound_device.is_initialized = true;
 
-    if (!app->is_exporting)
-    {
-        if (app->should_stop_all_notes.load())
-        {
-            uph_audio_stop_all_notes(tracks);
-            app->should_stop_all_notes.store(false);
-        }
-        else if (app->is_midi_editor_playing)
-            uph_midi_editor_process_playback_for_block(p_device->sampleRate, frame_count);
-        else if (app->is_song_timeline_playing)
-            uph_song_timeline_process_playback_for_block(p_device->sampleRate, frame_count);
-    }
-    else uph_song_timeline_process_playback_for_block(p_device->sampleRate, frame_count);
+    const uint32_t device_rate = sound_device.device.sampleRate;
+    const uint32_t period = std::max<uint32_t>(uph_sound_device_period(), 1);
+    sound_device.engine_rate = sound_device.processing_rate ? sound_device.processing_rate : device_rate;
 
-    for (auto &track : tracks)
+    // Plugins never see more than one render call, or a sub-block of it.
+    uint32_t max_render = period;
+    if (sound_device.engine_rate != device_rate)
     {
-        if (track.muted || (app->solo_track_index != -1 && !track.solo))
-        {
-            track.peak_left = 0.0f;
-            track.peak_right = 0.0f;
-            continue;
-        }
-
-        memset(sound_device.io->inputs, 0, sizeof(sound_device.io->inputs));
-        memset(sound_device.io->outputs, 0, sizeof(sound_device.io->outputs));
-
-        if (track.track_type == UphTrackType_Midi)
-        {
-            UviPlugin *plugin = &track.instrument.plugin;
-            if (!plugin->is_loaded)
-                continue;
-            plugin->process(plugin, inputs, outputs, frame_count);
-        }
-        else if ((app->is_song_timeline_playing || app->is_exporting) && track.track_type == UphTrackType_Sample)
-        {
-            for (auto &sample_instance : track.timeline_blocks)
-            {
-                if (sample_instance.sample_index < 0 || sample_instance.sample_index >= (int)app->project.samples.size())
-                    continue;
-
-                const UphSample &sample = app->project.samples[sample_instance.sample_index];
-                if (!sample.frames || sample.frame_count == 0)
-                    continue;
-
-                const float sec_per_beat = 60.0f / app->project.bpm;
-
-                float sample_rate_ratio = (float)sample.sample_rate / (float)p_device->sampleRate;
-                float playback_speed = sample_rate_ratio / sample_instance.stretch_scale;
-
-                float playback_rate = (playback_speed > 0.0f) ? playback_speed : 1.0f;
-
-                float instance_start_beat = sample_instance.start_time;
-
-                float instance_length_beats = (sample_instance.length > 0.0f)
-                    ? sample_instance.length
-                    : (sample.frame_count / (float)p_device->sampleRate / sec_per_beat) / playback_rate;
-
-                float instance_end_beat = instance_start_beat + instance_length_beats;
-
-                const float prev_beat = app->song_timeline_song_position;
-                if (instance_end_beat <= prev_beat || instance_start_beat >= app->song_timeline_song_position)
-                    continue;
-
-                int block_start_sample = int(std::round((instance_start_beat - prev_beat) * sec_per_beat * p_device->sampleRate));
-                int sample_read_start  = int(std::round(sample_instance.start_offset * sec_per_beat * p_device->sampleRate * playback_rate));
-                if (sample_read_start < 0) sample_read_start = 0;
-
-                int write_i = std::max<int>(0, block_start_sample);
-
-                double read_index = (double)sample_read_start + (double)(write_i - block_start_sample) * playback_rate;
-
-                ma_uint64 available_in_sample = (sample.frame_count > (ma_uint64)read_index) ? sample.frame_count - (ma_uint64)read_index : 0;
-                int available_in_block = (int)frame_count - write_i;
-                int frames_to_copy = (int)std::min<ma_uint64>(available_in_sample, (ma_uint64)available_in_block);
-                if (frames_to_copy <= 0) continue;
-
-                const int sample_channels = (sample.type == UphSampleType_Mono) ? 1 : 2;
-                const float *src = sample.frames;
-                const float track_volume = track.volume;
+        sound_device.resampler = uph_resampler_create(sound_device.engine_rate, device_rate, period);
+        max_render = uph_resampler_max_render(sound_device.resampler);
+    }
 
-                for (int i = 0; i < frames_to_copy; ++i)
-                {
-                    double sample_frame_idx_f = read_index + (double)i * playback_rate;
-                    ma_uint64 base = (ma_uint64)sample_frame_idx_f;
+    UviHostInfo host_info = uvi_host_info();
+    host_info.sample_rate = (float)sound_device.engine_rate;
+    host_info.block_size = (int32_t)std::min<uint32_t>(max_render, UPH_ENGINE_BLOCK_SIZE);
+    uvi_set_host_info(&host_info);
+    return true;
+}
 
-                    float left_sample = 0.0f;
-                    float right_sample = 0.0f;
+static void uph_sound_device_close(void)
+{
+    if (!sound_device.is_initialized)
+        return;
 
-                    float frac = (float)(sample_frame_idx_f - (double)base);
+    ma_device_stop(&sound_device.device);
+    ma_device_uninit(&sound_device.device);
+    sound_device.is_initialized = false;
 
-                    if (sample_channels == 1)
-                    {
-                        float s1 = src[base];
-                        float s2 = (base + 1 < sample.frame_count) ? src[base + 1] : 0.0f;
-                        float sample_val = s1 + (s2 - s1) * frac;
+    uph_resampler_destroy(sound_device.resampler);
+    sound_device.resampler = nullptr;
+}
 
-                        left_sample = sample_val;
-                        right_sample = sample_val;
-                    }
-                    else
-                    {
-                        ma_uint64 base2 = base * 2;
-                        float l1 = src[base2];
-                        float l2 = (base2 + 2 < sample.frame_count * 2) ? src[base2 + 2] : 0.0f;
-                        float r1 = src[base2 + 1];
-                        float r2 = (base2 + 3 < sample.frame_count * 2) ? src[base2 + 3] : 0.0f;
+static void uph_sound_device_start(void)
+{
+    if (ma_device_start(&sound_device.device) != MA_SUCCESS)
+    {
+        std::cerr << "Failed to start audio device\n";
+        uph_sound_device_close();
+    }
+}
 
-                        left_sample  = l1 + (l2 - l1) * frac;
-                        right_sample = r1 + (r2 - r1) * frac;
-                    }
+void uph_sound_device_initialize(const UphSoundDeviceConfig *config)
+{
+    sound_device.config = *config;
+    sound_device.has_context = ma_context_init(NULL, 0, NULL, &sound_device.context) == MA_SUCCESS;
 
-                    int out_idx = write_i + i;
-                    
-                    sound_device.io->outputs[0][out_idx] += left_sample;
-                    sound_device.io->outputs[1][out_idx] += right_sample;
-                }
-            }
-        }
+    if (uph_sound_device_open(config))
+        uph_sound_device_start();
+}
 
-        float peakL = 0.0f;
-        float peakR = 0.0f;
+void uph_sound_device_shutdown(void)
+{
+    uph_sound_device_close();
+    if (sound_device.has_context)
+        ma_context_uninit(&sound_device.context);
+    sound_device.has_context = false;
+    uph_realtime_thread_stopped(0);
+}
 
-        float panNorm = (track.pan + 1.0f) * 0.5f;
-        float gainL = cosf(panNorm * HALF_PI);
-        float gainR = sinf(panNorm * HALF_PI);
-        
-        const float final_volume = app->project.volume;
+void uph_sound_device_reconfigure(const UphSoundDeviceConfig *config)
+{
+    // Notes are released while the device still runs, the audio thread
+    // clears the flag once it did. Stopping it also waits for the callback.
+    if (sound_device.is_initialized && ma_device_is_started(&sound_device.device))
+    {
+        app->should_stop_all_notes.store(true);
+        for (int i = 0; i < 200 && app->should_stop_all_notes.load(); ++i)
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    uph_sound_device_close();
 
-        for (ma_uint32 i = 0; i < frame_count; i++)
-        {
-            const float l = sound_device.io->outputs[0][i] * track.volume * gainL;
-            const float r = sound_device.io->outputs[1][i] * track.volume * gainR;
+    sound_device.config = *config;
+    if (!uph_sound_device_open(config))
+        return;
 
-            peakL = std::max<float>(peakL, fabsf(l));
-            peakR = std::max<float>(peakR, fabsf(r));
+    // Nothing renders now. Plugins still being loaded are brought along
+    // when the loader swaps them in.
+    for (UphTrack &track : app->project.tracks)
+    {
+        if (track.instrument.plugin)
+            uvi_plugin_reconfigure(track.instrument.plugin);
+    }
 
-            output[i * 2]     += l * final_volume;
-            output[i * 2 + 1] += r * final_volume;
-        }
+    // The delay lines hold audio at the old rate and latencies may have
+    // changed, start from a clean snapshot. Samples are resampled on the
+    // fly from their own rate, there is no cache to rebuild.
+    uph_render_snapshot_reset_tracks();
+    uph_render_snapshot_publish();
 
-        track.peak_left = peakL;
-        track.peak_right = peakR;
-    }
+    uph_sound_device_start();
 }
 
-void uph_sound_device_initialize(void)
+void uph_sound_device_update(void)
 {
-    sound_device.io = new UphSoundDevice::UphSoundDeviceIO;
+    if (app->project.processing_rate != sound_device.processing_rate)
+        uph_sound_device_reconfigure(&sound_device.config);
+}
 
-    ma_device_config device_config = ma_device_config_init(ma_device_type_playback);
-    device_config.playback.format   = ma_format_f32;
-    device_config.playback.channels = 2;
-    device_config.sampleRate        = 44100;
-    device_config.dataCallback      = uph_audio_callback;
+UphSoundDeviceConfig uph_sound_device_config(void)
+{
+    return sound_device.config;
+}
 
-    if (ma_device_init(NULL, &device_config, &sound_device.device) != MA_SUCCESS)
-    {
-        std::cerr << "Failed to initialize audio device\n";
-        return;
-    }
+UphSoundDeviceStatus uph_sound_device_status(void)
+{
+    UphSoundDeviceStatus status{};
+    if (!sound_device.is_initialized)
+        return status;
 
-    if (ma_device_start(&sound_device.device) != MA_SUCCESS)
-    {
-        std::cerr << "Failed to start audio device\n";
-        ma_device_uninit(&sound_device.device);
-        return;
-    }
+    ma_device *device = &sound_device.device;
+    status.is_running = ma_device_is_started(device);
+    strncpy_s(status.device_name, device->playback.name, sizeof(status.device_name));
+    status.sample_rate = device->sampleRate;
+    status.period_size = uph_sound_device_period();
+    status.engine_rate = sound_device.engine_rate;
+    return status;
 }
 
-void uph_sound_device_shutdown(void)
+std::vector<std::string> uph_sound_device_list(void)
 {
-    ma_device_stop(&sound_device.device);
-    ma_device_uninit(&sound_device.device);
-    delete sound_device.io;
+    std::vector<std::string> names;
+    if (!sound_device.has_context)
+        return names;
+
+    ma_device_info *infos;
+    ma_uint32 count;
+    if (ma_context_get_devices(&sound_device.context, &infos, &count, NULL, NULL) != MA_SUCCESS)
+        return names;
+
+    for (ma_uint32 i = 0; i < count; ++i)
+        names.push_back(infos[i].name);
+    return names;
 }
 
 void uph_sound_device_all_notes_off(void)
@@ -398,7 +275,7 @@ UphSample uph_create_sample_from_file(const char *path)
     ma_uint64 frameCount;
     ma_decoder_get_length_in_pcm_frames(&decoder, &frameCount);
 
-    float* pFrames = (float*)malloc((size_t)(frameCount * decoder.outputChannels * sizeof(float)));
+    float* pFrames = uph_sample_frames_alloc(frameCount, decoder.outputChannels);
 
     ma_uint64 readFrames = 0;
     ma_decoder_read_pcm_frames(&decoder, pFrames, frameCount, &readFrames);
@@ -419,16 +296,24 @@ UphSample uph_create_sample_from_file(const char *path)
 
 void uph_destroy_sample(const UphSample *sample)
 {
-    free(sample->frames);
+    uph_render_snapshot_defer_free(uph_sample_frames_free, sample->frames);
 }
 
 void uph_export_song_to_wav(const char* output_path)
 {
+    // Same rate and block size the plugins were set up with.
+    const UviHostInfo host_info = uvi_host_info();
+    const float sample_rate = host_info.sample_rate;
+    const ma_uint32 block_size = (ma_uint32)host_info.block_size;
+
     ma_device *device = &sound_device.device;
-    const float sample_rate = device->sampleRate;
-    const ma_uint32 block_size = sound_device.block_size;
+    if (sound_device.is_initialized)
+        ma_device_stop(device);
 
-    ma_device_stop(device);
+    // Nothing of the live playback may leak into the file, every export of
+    // the same project renders the same.
+    uph_render_snapshot_reset_tracks();
+    uph_render_snapshot_publish_complete();
 
     app->is_exporting = true;
     app->is_midi_editor_playing = false;
@@ -449,24 +334,30 @@ void uph_export_song_to_wav(const char* output_path)
 
     float* mix_buffer = new float[block_size * 2];
 
-    float saved_pos = app->song_timeline_song_position;
-    app->song_timeline_song_position = 0.0f;
+    double saved_pos = uph_transport_beat(&app->song_timeline_transport);
+    uph_transport_seek(&app->song_timeline_transport, 0.0);
 
+    // Flushes denormals like the audio callback, then gives the UI thread
+    // its own float mode back.
+    const uint32_t saved_float_mode = uph_realtime_float_mode();
     for (ma_uint64 frame = 0; frame < total_frames; frame += block_size)
     {
         ma_uint32 frames_this_block = (ma_uint32)std::min<ma_uint64>(block_size, total_frames - frame);
         memset(mix_buffer, 0, frames_this_block * 2 * sizeof(float));
-        uph_audio_callback(device, mix_buffer, NULL, frames_this_block);
+        uph_realtime_flush_denormals();
+        uph_engine_render(mix_buffer, frames_this_block, sample_rate);
         ma_encoder_write_pcm_frames(&encoder, mix_buffer, frames_this_block, NULL);
     }
+    uph_realtime_restore_float_mode(saved_float_mode);
 
-    app->song_timeline_song_position = saved_pos;
+    uph_transport_seek(&app->song_timeline_transport, saved_pos);
     delete[] mix_buffer;
     ma_encoder_uninit(&encoder);
 
     app->is_exporting = false;
 
-    ma_device_start(device);
+    if (sound_device.is_initialized)
+        ma_device_start(device);
 
     std::cout << "Export complete!\n";
 }
\ No newline at end of file
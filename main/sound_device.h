@@ -2,9 +2,40 @@
 
 #include "types.h"
 
-void uph_sound_device_initialize(void);
+#include <string>
+
+struct UphSoundDeviceConfig
+{
+    char device_name[256] = {}; // empty picks the system default
+    uint32_t sample_rate = 44100;
+    uint32_t period_size = 0; // frames, 0 lets the backend pick
+};
+
+// What the device actually runs with, which may differ from what was asked.
+struct UphSoundDeviceStatus
+{
+    bool is_running;
+    char device_name[256];
+    uint32_t sample_rate;
+    uint32_t period_size;   // frames per callback
+    uint32_t engine_rate;   // resampled to sample_rate when they differ
+};
+
+void uph_sound_device_initialize(const UphSoundDeviceConfig *config);
 void uph_sound_device_shutdown(void);
 
+// UI thread. Stops the device, brings every loaded plugin to the new rate
+// and block size, then restarts, so no plugin changes while it renders.
+void uph_sound_device_reconfigure(const UphSoundDeviceConfig *config);
+
+// Main loop, reopens the device once the project's processing rate changed.
+void uph_sound_device_update(void);
+UphSoundDeviceConfig uph_sound_device_config(void);
+UphSoundDeviceStatus uph_sound_device_status(void);
+
+// Names of the playback devices, enumerated again on every call.
+std::vector<std::string> uph_sound_device_list(void);
+
 void uph_sound_device_all_notes_off(void);
 
 UphSample uph_create_sample_from_file(const char *path);
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "platform/platform.h"
+#include "engine/transport.h"
 
 #include <vector>
 #include <atomic>
@@ -37,11 +38,21 @@ union UphTimelineBlock
     };
 };
 
+// Edits give what they touched a new version, the render snapshot only
+// rebuilds what changed. Versions are never reused, so equal versions mean
+// equal contents even after a pattern or track moved.
+inline uint64_t uph_next_version(void)
+{
+    static std::atomic<uint64_t> counter = 0;
+    return counter.fetch_add(1, std::memory_order_relaxed) + 1;
+}
+
 struct UphInstrument
 {
     char path[260];
-    UviPlugin plugin;
+    UviPlugin *plugin = nullptr;
     UphChildWindow window;
+    bool is_restarting = false;     // kept off the audio thread until the plugin restarted
 };
 
 struct UphNote
@@ -55,6 +66,7 @@ struct UphMidiPattern
 {
     char name[64];
     std::vector<UphNote> notes;
+    uint64_t notes_version = uph_next_version();    // new one on every edit to notes
 };
 
 enum UphSampleType : uint8_t
@@ -63,6 +75,19 @@ enum UphSampleType : uint8_t
     UphSampleType_Stereo
 };
 
+// How sample tracks read between the frames of a sample, cheapest first.
+enum UphInterpolation : uint8_t
+{
+    UphInterpolation_Linear,
+    UphInterpolation_Cubic,     // 4 point Hermite
+    UphInterpolation_Sinc,      // windowed sinc, band limited to the playback rate
+    UphInterpolation_Count
+};
+
+// Silent frames readable before and after a sample's frames, so the
+// interpolation kernels never check bounds.
+#define UPH_SAMPLE_PADDING 256
+
 struct UphSample
 {
     char name[64];
@@ -79,13 +104,19 @@ struct UphTrack
     char name[64] = "Untitled Track";
     float volume = 1.0f, pan = 0.0f, pitch = 1.0f;
     float peak_left = 0.0f, peak_right = 0.0f;
+    bool is_sleeping = false;
     bool solo = false, muted = false;
     uint32_t color = 0xFFFFFFFF;
     UphTrackType track_type;
+    UphInterpolation interpolation = UphInterpolation_Cubic;
     UphInstrument instrument;
     std::vector<UphTimelineBlock> timeline_blocks;
+    uint64_t blocks_version = uph_next_version();   // new one on every edit to timeline_blocks
 };
 
+// What a project's processing rate can be set to, 0 follows the device.
+inline constexpr uint32_t uph_processing_rates[] = { 0, 44100, 48000, 88200, 96000, 192000 };
+
 struct UphProject
 {
 	int time_sig_numerator = 4;
@@ -93,6 +124,9 @@ struct UphProject
 	int steps_per_beat = 4;
 	int pulse_per_quarter = 480;
     float volume = 0.5f, bpm = 120.0f;
+    bool double_precision = false;  // tracks render and mix in doubles
+    uint32_t processing_rate = 0;   // Hz every track and plugin runs at, 0 follows the device
+    UphInterpolation export_interpolation = UphInterpolation_Sinc; // sample tracks, in place of their own
     std::vector<UphMidiPattern> patterns;
     std::vector<UphSample> samples;
     std::vector<UphTrack> tracks = std::vector<UphTrack>(8);
@@ -105,12 +139,16 @@ struct UphApplication
     uint32_t current_track_index = 0;
     uint32_t current_instrument_track_index = 0;
     int32_t solo_track_index = -1;
-    float midi_editor_song_position = 0.0f;
-    float song_timeline_song_position = 0.0f;
+    UphTransport midi_editor_transport;
+    UphTransport song_timeline_transport;
     bool is_midi_editor_playing = false;
     bool is_song_timeline_playing = false;
     bool is_exporting = false;
     std::atomic<bool> should_stop_all_notes = false;
+
+    // Frames every track is held back to line up with the most latent
+    // plugin, as of the last published snapshot.
+    uint32_t delay_compensation = 0;
 };
 
 inline UphApplication *app = nullptr;
\ No newline at end of file
@@ -66,4 +66,33 @@ project "Uphonic"
             "vendor/imgui/imgui_impl_dx11.cpp",
             "vendor/imgui/imgui_impl_dx11.h"
         }
-        links { "SDL2", "GL", "dl", "m" }
\ No newline at end of file
+        links { "SDL2", "GL", "dl", "m" }
+
+project "UphonicBench"
+    kind "ConsoleApp"
+    architecture "x64"
+    language "C++"
+    cppdialect "C++20"
+    files {
+        "bench/**.h",
+        "bench/**.cpp",
+        "main/engine/**.h",
+        "main/engine/**.cpp"
+    }
+
+    includedirs {
+        "main",
+        "uvi"
+    }
+
+    links { "UVI" }
+
+    filter { "configurations:Release" }
+        defines { "NDEBUG" }
+        optimize "On"
+
+    filter "system:windows"
+        links { "psapi" }
+
+    filter "system:linux"
+        links { "dl", "pthread" }
@@ -0,0 +1,449 @@
+#include "uvi_clap.h"
+
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+#if defined(_WIN32)
+#define UVI_CLAP_WINDOW_API "win32"
+#elif defined(__APPLE__)
+#define UVI_CLAP_WINDOW_API "cocoa"
+#else
+#define UVI_CLAP_WINDOW_API "x11"
+#endif
+
+// Heap allocated so the host pointer handed to the plugin stays valid when
+// the owning UviPlugin is copied around.
+struct UviClapInstance
+{
+    UviClapHost host;
+    UviClapInputEvents in_events;
+    UviClapOutputEvents out_events;
+
+    const UviClapPlugin *plugin;
+
+    const UviClapPluginThreadPool *thread_pool;
+    const UviClapPluginLatency *latency;
+    const UviClapPluginState *state;
+    const UviClapPluginGui *gui;
+
+    bool is_initialized;
+    bool is_active;
+    bool is_processing;
+    bool is_gui_created;
+    int64_t steady_time;
+
+    // Set by the plugin from any thread, served by uvi_clap_plugin_idle.
+    std::atomic<bool> is_restart_requested;
+    std::atomic<bool> is_callback_requested;
+
+    UviClapEventNote *events;  // the plugin's events.capacity
+    uint32_t event_count;
+};
+
+static void uvi_clap_thread_pool_task(void *user, uint32_t task_index)
+{
+    UviClapInstance *instance = (UviClapInstance*)user;
+    instance->thread_pool->exec(instance->plugin, task_index);
+}
+
+// Called by the plugin from inside process, the tasks run on the engine's
+// workers while the calling thread helps and waits.
+static bool uvi_clap_host_request_exec(const UviClapHost *host, uint32_t num_tasks)
+{
+    UviClapInstance *instance = (UviClapInstance*)host->host_data;
+    if (!instance->thread_pool)
+        return false;
+
+    uvi_thread_pool_run(uvi_clap_thread_pool_task, instance, num_tasks);
+    return true;
+}
+
+static const UviClapHostThreadPool uvi_clap_host_thread_pool = { uvi_clap_host_request_exec };
+
+static const void *uvi_clap_host_get_extension(const UviClapHost *, const char *extension_id)
+{
+    if (strcmp(extension_id, UVI_CLAP_EXT_THREAD_POOL) == 0)
+        return &uvi_clap_host_thread_pool;
+    return nullptr;
+}
+
+// Every block is processed anyway.
+static void uvi_clap_host_request_process(const UviClapHost *)
+{
+}
+
+static void uvi_clap_host_request_restart(const UviClapHost *host)
+{
+    ((UviClapInstance*)host->host_data)->is_restart_requested.store(true);
+}
+
+static void uvi_clap_host_request_callback(const UviClapHost *host)
+{
+    ((UviClapInstance*)host->host_data)->is_callback_requested.store(true);
+}
+
+static uint32_t uvi_clap_in_events_size(const UviClapInputEvents *list)
+{
+    return ((const UviClapInstance*)list->ctx)->event_count;
+}
+
+static const UviClapEventHeader *uvi_clap_in_events_get(const UviClapInputEvents *list, uint32_t index)
+{
+    const UviClapInstance *instance = (const UviClapInstance*)list->ctx;
+    return index < instance->event_count ? &instance->events[index].header : nullptr;
+}
+
+// Nothing the plugin sends back is used.
+static bool uvi_clap_out_events_try_push(const UviClapOutputEvents *, const UviClapEventHeader *)
+{
+    return true;
+}
+
+static void uvi_clap_plugin_process(UviPlugin *plugin, float **inputs, float **outputs, int32_t sample_frames)
+{
+    UviClapInstance *instance = plugin->clap.instance;
+
+    if (!instance->is_processing && instance->is_active)
+        instance->is_processing = instance->plugin->start_processing(instance->plugin);
+
+    const uint32_t event_count = uvi_event_buffer_due(&plugin->events, sample_frames);
+    if (!instance->is_processing)
+    {
+        for (int32_t c = 0; c < plugin->num_outputs; ++c)
+            memset(outputs[c], 0, sample_frames * sizeof(float));
+        uvi_event_buffer_consume(&plugin->events, event_count, sample_frames);
+        plugin->is_silent = true;
+        return;
+    }
+
+    // Already sorted by time as CLAP requires. A key of -1 is the CLAP
+    // wildcard, one note off ends every note.
+    for (uint32_t i = 0; i < event_count; ++i)
+    {
+        const UviEvent &source = plugin->events.events[i];
+        const bool all_notes = source.type == UviEventType_AllNotesOff;
+
+        UviClapEventNote &event = instance->events[i];
+        event = {};
+        event.header.size = sizeof(UviClapEventNote);
+        event.header.time = (uint32_t)source.frame;
+        event.header.type = source.type == UviEventType_NoteOn ? UviClapEventType_NoteOn : UviClapEventType_NoteOff;
+        event.note_id = -1;
+        event.port_index = all_notes ? -1 : 0;
+        event.channel = all_notes ? -1 : source.channel;
+        event.key = all_notes ? -1 : (int16_t)source.key;
+        event.velocity = source.velocity / 127.0;
+    }
+    instance->event_count = event_count;
+
+    UviClapAudioBuffer input{ inputs, nullptr, (uint32_t)plugin->num_inputs, 0, 0 };
+    UviClapAudioBuffer output{ outputs, nullptr, (uint32_t)plugin->num_outputs, 0, 0 };
+
+    UviClapProcess process{};
+    process.steady_time = instance->steady_time;
+    process.frames_count = (uint32_t)sample_frames;
+    process.audio_inputs = plugin->num_inputs > 0 ? &input : nullptr;
+    process.audio_inputs_count = plugin->num_inputs > 0 ? 1 : 0;
+    process.audio_outputs = plugin->num_outputs > 0 ? &output : nullptr;
+    process.audio_outputs_count = plugin->num_outputs > 0 ? 1 : 0;
+    process.in_events = &instance->in_events;
+    process.out_events = &instance->out_events;
+
+    const int32_t status = instance->plugin->process(instance->plugin, &process);
+    plugin->is_silent = status == UviClapProcessStatus_Sleep;
+
+    instance->steady_time += sample_frames;
+    instance->event_count = 0;
+    uvi_event_buffer_consume(&plugin->events, event_count, sample_frames);
+}
+
+static void uvi_clap_plugin_play_note(UviPlugin *plugin, int32_t key, int32_t velocity, int32_t sample_offset)
+{
+    uvi_plugin_queue_event(plugin, UviEventType_NoteOn, 0, key, velocity, sample_offset);
+}
+
+static void uvi_clap_plugin_stop_note(UviPlugin *plugin, int32_t key, int32_t sample_offset)
+{
+    uvi_plugin_queue_event(plugin, UviEventType_NoteOff, 0, key, 0, sample_offset);
+}
+
+static void uvi_clap_plugin_stop_all_notes(UviPlugin *plugin)
+{
+    plugin->events.count = 0;
+    uvi_plugin_queue_event(plugin, UviEventType_AllNotesOff, 0, 0, 0, 0);
+}
+
+static bool uvi_clap_gui_create(UviClapInstance *instance)
+{
+    if (!instance->is_gui_created)
+        instance->is_gui_created = instance->gui->create(instance->plugin, UVI_CLAP_WINDOW_API, false);
+    return instance->is_gui_created;
+}
+
+static void uvi_clap_plugin_open_editor(UviPlugin *plugin, void *handle)
+{
+    UviClapInstance *instance = plugin->clap.instance;
+    if (!uvi_clap_gui_create(instance))
+        return;
+
+    UviClapWindow window{};
+    window.api = UVI_CLAP_WINDOW_API;
+#if defined(_WIN32) || defined(__APPLE__)
+    window.ptr = handle;
+#else
+    window.x11 = (unsigned long)(uintptr_t)handle;
+#endif
+
+    instance->gui->set_parent(instance->plugin, &window);
+    instance->gui->show(instance->plugin);
+}
+
+static void uvi_clap_plugin_close_editor(UviPlugin *plugin)
+{
+    UviClapInstance *instance = plugin->clap.instance;
+    if (!instance->is_gui_created)
+        return;
+
+    instance->gui->hide(instance->plugin);
+    instance->gui->destroy(instance->plugin);
+    instance->is_gui_created = false;
+}
+
+static void uvi_clap_plugin_get_editor_size(UviPlugin *plugin, uint32_t *width, uint32_t *height)
+{
+    UviClapInstance *instance = plugin->clap.instance;
+    *width = 0;
+    *height = 0;
+    if (uvi_clap_gui_create(instance))
+        instance->gui->get_size(instance->plugin, width, height);
+}
+
+static int64_t uvi_clap_stream_write(const UviClapOutputStream *stream, const void *buffer, uint64_t size)
+{
+    std::ofstream *file = (std::ofstream*)stream->ctx;
+    file->write((const char*)buffer, (std::streamsize)size);
+    return file->good() ? (int64_t)size : -1;
+}
+
+static int64_t uvi_clap_stream_read(const UviClapInputStream *stream, void *buffer, uint64_t size)
+{
+    std::ifstream *file = (std::ifstream*)stream->ctx;
+    file->read((char*)buffer, (std::streamsize)size);
+    return file->bad() ? -1 : (int64_t)file->gcount();
+}
+
+static void uvi_clap_plugin_serialize(UviPlugin *plugin, const char *file_path)
+{
+    UviClapInstance *instance = plugin->clap.instance;
+    if (!instance->state)
+        return;
+
+    std::ofstream file(file_path, std::ios::binary);
+    if (!file)
+    {
+        fprintf(stderr, "[UVI Loader] Failed to open state file for writing: %s\n", file_path);
+        return;
+    }
+
+    const UviClapOutputStream stream = { &file, uvi_clap_stream_write };
+    if (!instance->state->save(instance->plugin, &stream))
+        fprintf(stderr, "[UVI Loader] CLAP plugin failed to save its state.\n");
+}
+
+static void uvi_clap_plugin_deserialize(UviPlugin *plugin, const char *file_path)
+{
+    UviClapInstance *instance = plugin->clap.instance;
+    if (!instance->state)
+        return;
+
+    std::ifstream file(file_path, std::ios::binary);
+    if (!file)
+    {
+        fprintf(stderr, "[UVI Loader] Failed to open state file: %s\n", file_path);
+        return;
+    }
+
+    const UviClapInputStream stream = { &file, uvi_clap_stream_read };
+    if (!instance->state->load(instance->plugin, &stream))
+        fprintf(stderr, "[UVI Loader] CLAP plugin rejected its state file.\n");
+
+    if (instance->latency)
+        plugin->latency = (int32_t)instance->latency->get(instance->plugin);
+}
+
+// Channels of the first port, which CLAP defines as the main one.
+static int32_t uvi_clap_channel_count(UviClapInstance *instance, bool is_input)
+{
+    const UviClapPluginAudioPorts *ports = (const UviClapPluginAudioPorts*)
+        instance->plugin->get_extension(instance->plugin, UVI_CLAP_EXT_AUDIO_PORTS);
+    if (!ports)
+        return is_input ? 0 : 2;
+
+    UviClapAudioPortInfo info{};
+    if (ports->count(instance->plugin, is_input) == 0 || !ports->get(instance->plugin, 0, is_input, &info))
+        return 0;
+    return (int32_t)info.channel_count;
+}
+
+bool uvi_clap_plugin_load(UviPlugin *plugin, const UviClapPluginEntry *entry)
+{
+    if (!entry)
+    {
+        printf("[UVI Loader] Not a valid CLAP plugin.\n");
+        return false;
+    }
+
+    const UviClapPluginFactory *factory = (const UviClapPluginFactory*)entry->get_factory(UVI_CLAP_PLUGIN_FACTORY_ID);
+    const UviClapPluginDescriptor *descriptor = (factory && factory->get_plugin_count(factory) > 0)
+        ? factory->get_plugin_descriptor(factory, 0) : nullptr;
+    if (!descriptor)
+    {
+        printf("[UVI Loader] CLAP library contains no plugins.\n");
+        return false;
+    }
+
+    UviClapInstance *instance = new UviClapInstance{};
+    instance->host.clap_version = { 1, 2, 0 };
+    instance->host.host_data = instance;
+    instance->host.name = "Uphonic";
+    instance->host.vendor = "Uphonic";
+    instance->host.url = "";
+    instance->host.version = "1.0";
+    instance->host.get_extension = uvi_clap_host_get_extension;
+    instance->host.request_restart = uvi_clap_host_request_restart;
+    instance->host.request_process = uvi_clap_host_request_process;
+    instance->host.request_callback = uvi_clap_host_request_callback;
+    instance->in_events = { instance, uvi_clap_in_events_size, uvi_clap_in_events_get };
+    instance->out_events = { instance, uvi_clap_out_events_try_push };
+    instance->events = new UviClapEventNote[plugin->events.capacity];
+
+    instance->plugin = factory->create_plugin(factory, &instance->host, descriptor->id);
+    if (!instance->plugin)
+    {
+        printf("[UVI Loader] CLAP plugin failed to instantiate.\n");
+        delete[] instance->events;
+        delete instance;
+        return false;
+    }
+
+    plugin->process = uvi_clap_plugin_process;
+    plugin->play_note = uvi_clap_plugin_play_note;
+    plugin->stop_note = uvi_clap_plugin_stop_note;
+    plugin->stop_all_notes = uvi_clap_plugin_stop_all_notes;
+    plugin->serialize = uvi_clap_plugin_serialize;
+    plugin->deserialize = uvi_clap_plugin_deserialize;
+
+    plugin->clap.instance = instance;
+    if (descriptor->name)
+        strncpy_s(plugin->name, descriptor->name, sizeof(plugin->name));
+    if (descriptor->vendor)
+        strncpy_s(plugin->vendor, descriptor->vendor, sizeof(plugin->vendor));
+    for (const char *const *feature = descriptor->features; feature && *feature; ++feature)
+    {
+        if (strcmp(*feature, "instrument") == 0)
+            plugin->is_synth = true;
+    }
+    plugin->is_loaded = true;
+    return true;
+}
+
+bool uvi_clap_plugin_initialize(UviPlugin *plugin, float sample_rate, int32_t block_size)
+{
+    UviClapInstance *instance = plugin->clap.instance;
+    const UviClapPlugin *p = instance->plugin;
+    if (instance->is_initialized)
+        return true;
+
+    if (!p->init(p))
+    {
+        printf("[UVI Loader] CLAP plugin failed to initialise.\n");
+        return false;
+    }
+    instance->is_initialized = true;
+
+    instance->thread_pool = (const UviClapPluginThreadPool*)p->get_extension(p, UVI_CLAP_EXT_THREAD_POOL);
+    instance->latency = (const UviClapPluginLatency*)p->get_extension(p, UVI_CLAP_EXT_LATENCY);
+    instance->state = (const UviClapPluginState*)p->get_extension(p, UVI_CLAP_EXT_STATE);
+    instance->gui = (const UviClapPluginGui*)p->get_extension(p, UVI_CLAP_EXT_GUI);
+    if (instance->gui && !instance->gui->is_api_supported(p, UVI_CLAP_WINDOW_API, false))
+        instance->gui = nullptr;
+
+    plugin->num_inputs = uvi_clap_channel_count(instance, true);
+    plugin->num_outputs = uvi_clap_channel_count(instance, false);
+
+    if (!p->activate(p, sample_rate, 1, (uint32_t)block_size))
+    {
+        printf("[UVI Loader] CLAP plugin failed to activate.\n");
+        return false;
+    }
+    instance->is_active = true;
+
+    const bool has_editor = instance->gui != nullptr;
+    plugin->open_editor = has_editor ? uvi_clap_plugin_open_editor : nullptr;
+    plugin->close_editor = has_editor ? uvi_clap_plugin_close_editor : nullptr;
+    plugin->get_editor_size = has_editor ? uvi_clap_plugin_get_editor_size : nullptr;
+    plugin->latency = instance->latency ? (int32_t)instance->latency->get(p) : 0;
+    return true;
+}
+
+// Unloads are deferred until the audio thread is done with the plugin, so
+// stopping processing here can't race a process call.
+void uvi_clap_plugin_unload(UviPlugin *plugin)
+{
+    plugin->is_loaded = false;
+
+    UviClapInstance *instance = plugin->clap.instance;
+    const UviClapPlugin *p = instance->plugin;
+
+    uvi_clap_plugin_close_editor(plugin);
+    if (instance->is_processing)
+        p->stop_processing(p);
+    if (instance->is_active)
+        p->deactivate(p);
+    p->destroy(p);
+
+    delete[] instance->events;
+    delete instance;
+}
+
+bool uvi_clap_plugin_reconfigure(UviPlugin *plugin, float sample_rate, int32_t block_size)
+{
+    UviClapInstance *instance = plugin->clap.instance;
+    const UviClapPlugin *p = instance->plugin;
+    if (!instance->is_initialized)
+        return false;
+
+    // Reactivating is what a restart asks for, requests from here on need
+    // another one.
+    instance->is_restart_requested.store(false);
+
+    if (instance->is_processing)
+        p->stop_processing(p);
+    if (instance->is_active)
+        p->deactivate(p);
+    instance->is_processing = false;
+    instance->event_count = 0;
+
+    instance->is_active = p->activate(p, sample_rate, 1, (uint32_t)block_size);
+    if (!instance->is_active)
+    {
+        printf("[UVI Loader] CLAP plugin failed to reactivate at %g Hz.\n", sample_rate);
+        return false;
+    }
+
+    plugin->latency = instance->latency ? (int32_t)instance->latency->get(p) : 0;
+    return true;
+}
+
+bool uvi_clap_plugin_idle(UviPlugin *plugin)
+{
+    UviClapInstance *instance = plugin->clap.instance;
+    if (!instance->is_initialized)
+        return false;
+
+    if (instance->is_callback_requested.exchange(false))
+        instance->plugin->on_main_thread(instance->plugin);
+    return instance->is_restart_requested.load();
+}
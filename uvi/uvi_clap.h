@@ -0,0 +1,252 @@
+#pragma once
+
+#include "uvi_loader.h"
+
+// The subset of the CLAP 1.x C ABI the host uses, declared here the same
+// way the VST2 structs are so no SDK is needed to build.
+
+#define UVI_CLAP_ENTRY_NAME         "clap_entry"
+#define UVI_CLAP_PLUGIN_FACTORY_ID  "clap.plugin-factory"
+#define UVI_CLAP_EXT_AUDIO_PORTS    "clap.audio-ports"
+#define UVI_CLAP_EXT_LATENCY        "clap.latency"
+#define UVI_CLAP_EXT_STATE          "clap.state"
+#define UVI_CLAP_EXT_GUI            "clap.gui"
+#define UVI_CLAP_EXT_THREAD_POOL    "clap.thread-pool"
+
+#define UVI_CLAP_NAME_SIZE 256
+
+struct UviClapVersion
+{
+    uint32_t major, minor, revision;
+};
+
+enum UviClapProcessStatus : int32_t
+{
+    UviClapProcessStatus_Error = 0,
+    UviClapProcessStatus_Continue = 1,
+    UviClapProcessStatus_ContinueIfNotQuiet = 2,
+    UviClapProcessStatus_Tail = 3,
+    UviClapProcessStatus_Sleep = 4
+};
+
+enum UviClapEventType : uint16_t
+{
+    UviClapEventType_NoteOn = 0,
+    UviClapEventType_NoteOff = 1,
+    UviClapEventType_NoteChoke = 2
+};
+
+struct UviClapEventHeader
+{
+    uint32_t size;
+    uint32_t time;
+    uint16_t space_id;
+    uint16_t type;
+    uint32_t flags;
+};
+
+struct UviClapEventNote
+{
+    UviClapEventHeader header;
+    int32_t note_id;
+    int16_t port_index;
+    int16_t channel;
+    int16_t key;
+    double velocity;
+};
+
+struct UviClapInputEvents
+{
+    void *ctx;
+    uint32_t (*size)(const UviClapInputEvents *list);
+    const UviClapEventHeader *(*get)(const UviClapInputEvents *list, uint32_t index);
+};
+
+struct UviClapOutputEvents
+{
+    void *ctx;
+    bool (*try_push)(const UviClapOutputEvents *list, const UviClapEventHeader *event);
+};
+
+struct UviClapAudioBuffer
+{
+    float **data32;
+    double **data64;
+    uint32_t channel_count;
+    uint32_t latency;
+    uint64_t constant_mask;
+};
+
+struct UviClapProcess
+{
+    int64_t steady_time;
+    uint32_t frames_count;
+    const void *transport;
+    const UviClapAudioBuffer *audio_inputs;
+    UviClapAudioBuffer *audio_outputs;
+    uint32_t audio_inputs_count;
+    uint32_t audio_outputs_count;
+    const UviClapInputEvents *in_events;
+    const UviClapOutputEvents *out_events;
+};
+
+struct UviClapHost
+{
+    UviClapVersion clap_version;
+    void *host_data;
+    const char *name;
+    const char *vendor;
+    const char *url;
+    const char *version;
+    const void *(*get_extension)(const UviClapHost *host, const char *extension_id);
+    void (*request_restart)(const UviClapHost *host);
+    void (*request_process)(const UviClapHost *host);
+    void (*request_callback)(const UviClapHost *host);
+};
+
+struct UviClapPluginDescriptor
+{
+    UviClapVersion clap_version;
+    const char *id;
+    const char *name;
+    const char *vendor;
+    const char *url;
+    const char *manual_url;
+    const char *support_url;
+    const char *version;
+    const char *description;
+    const char *const *features;
+};
+
+struct UviClapPlugin
+{
+    const UviClapPluginDescriptor *desc;
+    void *plugin_data;
+    bool (*init)(const UviClapPlugin *plugin);
+    void (*destroy)(const UviClapPlugin *plugin);
+    bool (*activate)(const UviClapPlugin *plugin, double sample_rate, uint32_t min_frames_count, uint32_t max_frames_count);
+    void (*deactivate)(const UviClapPlugin *plugin);
+    bool (*start_processing)(const UviClapPlugin *plugin);
+    void (*stop_processing)(const UviClapPlugin *plugin);
+    void (*reset)(const UviClapPlugin *plugin);
+    int32_t (*process)(const UviClapPlugin *plugin, const UviClapProcess *process);
+    const void *(*get_extension)(const UviClapPlugin *plugin, const char *id);
+    void (*on_main_thread)(const UviClapPlugin *plugin);
+};
+
+struct UviClapPluginFactory
+{
+    uint32_t (*get_plugin_count)(const UviClapPluginFactory *factory);
+    const UviClapPluginDescriptor *(*get_plugin_descriptor)(const UviClapPluginFactory *factory, uint32_t index);
+    const UviClapPlugin *(*create_plugin)(const UviClapPluginFactory *factory, const UviClapHost *host, const char *plugin_id);
+};
+
+struct UviClapPluginEntry
+{
+    UviClapVersion clap_version;
+    bool (*init)(const char *plugin_path);
+    void (*deinit)(void);
+    const void *(*get_factory)(const char *factory_id);
+};
+
+struct UviClapAudioPortInfo
+{
+    uint32_t id;
+    char name[UVI_CLAP_NAME_SIZE];
+    uint32_t flags;
+    uint32_t channel_count;
+    const char *port_type;
+    uint32_t in_place_pair;
+};
+
+struct UviClapPluginAudioPorts
+{
+    uint32_t (*count)(const UviClapPlugin *plugin, bool is_input);
+    bool (*get)(const UviClapPlugin *plugin, uint32_t index, bool is_input, UviClapAudioPortInfo *info);
+};
+
+struct UviClapPluginLatency
+{
+    uint32_t (*get)(const UviClapPlugin *plugin);
+};
+
+struct UviClapOutputStream
+{
+    void *ctx;
+    int64_t (*write)(const UviClapOutputStream *stream, const void *buffer, uint64_t size);
+};
+
+struct UviClapInputStream
+{
+    void *ctx;
+    int64_t (*read)(const UviClapInputStream *stream, void *buffer, uint64_t size);
+};
+
+struct UviClapPluginState
+{
+    bool (*save)(const UviClapPlugin *plugin, const UviClapOutputStream *stream);
+    bool (*load)(const UviClapPlugin *plugin, const UviClapInputStream *stream);
+};
+
+struct UviClapWindow
+{
+    const char *api;
+    union
+    {
+        void *cocoa;
+        unsigned long x11;
+        void *win32;
+        void *ptr;
+    };
+};
+
+struct UviClapPluginGui
+{
+    bool (*is_api_supported)(const UviClapPlugin *plugin, const char *api, bool is_floating);
+    bool (*get_preferred_api)(const UviClapPlugin *plugin, const char **api, bool *is_floating);
+    bool (*create)(const UviClapPlugin *plugin, const char *api, bool is_floating);
+    void (*destroy)(const UviClapPlugin *plugin);
+    bool (*set_scale)(const UviClapPlugin *plugin, double scale);
+    bool (*get_size)(const UviClapPlugin *plugin, uint32_t *width, uint32_t *height);
+    bool (*can_resize)(const UviClapPlugin *plugin);
+    bool (*get_resize_hints)(const UviClapPlugin *plugin, void *hints);
+    bool (*adjust_size)(const UviClapPlugin *plugin, uint32_t *width, uint32_t *height);
+    bool (*set_size)(const UviClapPlugin *plugin, uint32_t width, uint32_t height);
+    bool (*set_parent)(const UviClapPlugin *plugin, const UviClapWindow *window);
+    bool (*set_transient)(const UviClapPlugin *plugin, const UviClapWindow *window);
+    void (*suggest_title)(const UviClapPlugin *plugin, const char *title);
+    bool (*show)(const UviClapPlugin *plugin);
+    bool (*hide)(const UviClapPlugin *plugin);
+};
+
+struct UviClapPluginThreadPool
+{
+    void (*exec)(const UviClapPlugin *plugin, uint32_t task_index);
+};
+
+struct UviClapHostThreadPool
+{
+    bool (*request_exec)(const UviClapHost *host, uint32_t num_tasks);
+};
+
+// Instantiates the first plugin in the library's factory. The entry is
+// initialised once per library by the loader, which also releases the library
+// when this returns false. Creating is allowed on any thread, the rest of the
+// setup waits for uvi_clap_plugin_initialize.
+bool uvi_clap_plugin_load(UviPlugin *plugin, const UviClapPluginEntry *entry);
+
+// [main-thread] Initialises and activates the plugin, false when it refused,
+// in which case it can only be unloaded.
+bool uvi_clap_plugin_initialize(UviPlugin *plugin, float sample_rate, int32_t block_size);
+
+// [main-thread] Deactivates and destroys the plugin.
+void uvi_clap_plugin_unload(UviPlugin *plugin);
+
+// Reactivates the plugin with a new rate, false when it refused and is left
+// inactive, in which case it outputs silence until reconfigured again.
+bool uvi_clap_plugin_reconfigure(UviPlugin *plugin, float sample_rate, int32_t block_size);
+
+// [main-thread] Calls on_main_thread when the plugin asked for it. True
+// while it asks to be restarted, which is a reconfigure with the same
+// settings once nothing processes it.
+bool uvi_clap_plugin_idle(UviPlugin *plugin);
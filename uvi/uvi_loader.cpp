@@ -1,9 +1,17 @@
 #include "uvi_loader.h"
+#include "uvi_clap.h"
+#include "uvi_synth.h"
 
+#include <algorithm>
+#include <atomic>
+#include <bit>
 #include <filesystem>
 #include <fstream>
+#include <map>
+#include <mutex>
 #include <queue>
-#include <thread>
+#include <string>
+#include <vector>
 
 #if defined(_WIN32)
 static UviLibrary uvi_library_load(const char *path)
@@ -37,6 +45,69 @@ static UviProcAddress uvi_get_proc_address(UviLibrary library, const char *name)
 }
 #endif
 
+// Instances of the same plugin share one library, it is closed together with
+// the last of them. Unloads are deferred until the audio thread is done with
+// the plugin, so nothing can still be running inside the library by then.
+struct UviLibraryEntry
+{
+    UviLibrary library;
+    uint32_t references;
+    const UviClapPluginEntry *clap_entry;  // initialised once per library
+};
+
+static std::mutex library_cache_mutex;
+static std::map<std::string, UviLibraryEntry> library_cache;
+
+static UviLibrary uvi_library_acquire(const char *path, UviPluginType type)
+{
+    const std::string key = std::filesystem::path(path).lexically_normal().string();
+
+    std::lock_guard<std::mutex> lock(library_cache_mutex);
+    auto it = library_cache.find(key);
+    if (it != library_cache.end())
+    {
+        ++it->second.references;
+        return it->second.library;
+    }
+
+    UviLibrary library = uvi_library_load(path);
+    if (!library)
+        return nullptr;
+
+    UviLibraryEntry entry = { library, 1, nullptr };
+    if (type == UviPluginType_Clap)
+    {
+        const UviClapPluginEntry *clap_entry = (const UviClapPluginEntry*)uvi_get_proc_address(library, UVI_CLAP_ENTRY_NAME);
+        if (!clap_entry || clap_entry->clap_version.major < 1 || !clap_entry->init(path))
+        {
+            uvi_library_unload(library);
+            return nullptr;
+        }
+        entry.clap_entry = clap_entry;
+    }
+
+    library_cache[key] = entry;
+    return library;
+}
+
+static void uvi_library_release(UviLibrary library)
+{
+    if (!library)
+        return;
+
+    std::lock_guard<std::mutex> lock(library_cache_mutex);
+    auto it = std::find_if(library_cache.begin(), library_cache.end(), [library](const auto &cached) {
+        return cached.second.library == library;
+    });
+    if (it == library_cache.end() || --it->second.references > 0)
+        return;
+
+    if (it->second.clap_entry)
+        it->second.clap_entry->deinit();
+    uvi_library_unload(library);
+    library_cache.erase(it);
+}
+
 enum UviV2AudioMasterOpcodes
 {
 	UviV2AudioMasterOpcodes_Automate = 0,
@@ -51,17 +122,25 @@ enum UviV2AudioMasterOpcodes
     UviV2AudioMasterOpcodes_CanDo = 37
 };
 
+// Written by the UI thread while plugins load on another one. The VST2
+// callback can come from any thread, it reads the atomic copies.
+static UviHostInfo host_info = { 44100.0f, 512, 0 };
+static std::mutex host_info_mutex;
+static std::atomic<float> host_sample_rate = 44100.0f;
+static std::atomic<int32_t> host_block_size = 512;
+static UviThreadPoolRunFunc thread_pool_run = nullptr;
+
 static intptr_t uvi_v2_audio_master_callback_function(
-    UviV2Plugin* plugin, int32_t opcode, int32_t index,
-    intptr_t value, void* ptr, float opt
+    UviV2Plugin*, int32_t opcode, int32_t,
+    intptr_t, void* ptr, float
 )
 {
     switch (opcode)
     {
         case UviV2AudioMasterOpcodes_Version: return 2400;
         case UviV2AudioMasterOpcodes_Idle:    return 0;
-        case UviV2AudioMasterOpcodes_GetSampleRate: return (intptr_t)44100;
-        case UviV2AudioMasterOpcodes_GetBlockSize:  return 512;
+        case UviV2AudioMasterOpcodes_GetSampleRate: return (intptr_t)host_sample_rate.load(std::memory_order_relaxed);
+        case UviV2AudioMasterOpcodes_GetBlockSize:  return host_block_size.load(std::memory_order_relaxed);
         case UviV2AudioMasterOpcodes_CanDo:
         {
             const char* canDo = (const char*)ptr;
@@ -73,6 +152,7 @@ static intptr_t uvi_v2_audio_master_callback_function(
             return 0;
         }
     }
+    return 0;
 }
 
 struct UviV2Event
@@ -88,81 +168,86 @@ struct UviV2Events
 {
 	int32_t num_events;
 	intptr_t reserved;
-	UviV2Event* events[256];
+	UviV2Event* events[1];  // num_events long, allocated with the plugin
 };
 
-static void uvi_v2_plugin_process_events(UviPlugin *plugin)
+static UviV2Events *uvi_v2_events_alloc(uint32_t capacity)
+{
+    return (UviV2Events*)calloc(1, sizeof(UviV2Events) + (capacity - 1) * sizeof(UviV2Event*));
+}
+
+static void uvi_v2_plugin_process_events(UviPlugin *plugin, uint32_t event_count)
 {
-    const uint32_t midi_event_count = plugin->v2.midi_event_count;
-    if (midi_event_count == 0)
+    if (event_count == 0)
         return;
 
-    UviV2Plugin *p = plugin->v2.plugin;
-    UviV2Events events{};
-    events.num_events = midi_event_count;
+    UviV2Events *events = plugin->v2.event_list;
+    events->num_events = (int32_t)event_count;
 
-    for (uint32_t i = 0; i < midi_event_count; ++i)
-        events.events[i] = (UviV2Event*)&plugin->v2.midi_events[i];
+    for (uint32_t i = 0; i < event_count; ++i)
+    {
+        const UviEvent &event = plugin->events.events[i];
+        UviV2MidiEvent &ev = plugin->v2.midi_events[i];
+        ev = {};
+        ev.type = 1;
+        ev.byte_size = sizeof(ev);
+        ev.delta_frames = event.frame;
+        ev.midi_data[0] = (char)((event.type == UviEventType_NoteOn ? 0x90 : 0x80) | event.channel);
+        ev.midi_data[1] = (char)event.key;
+        ev.midi_data[2] = (char)event.velocity;
+        events->events[i] = (UviV2Event*)&ev;
+    }
+
+    UviV2Plugin *p = plugin->v2.plugin;
+    p->dispatcher(p, UviV2PluginOpcodes_ProcessEvents, 0, 0, events, 0.0f);
+}
 
-    p->dispatcher(p, UviV2PluginOpcodes_ProcessEvents, 0, 0, &events, 0.0f);
-    plugin->v2.midi_event_count = 0;
+static void uvi_v2_plugin_deliver_events(UviPlugin *plugin, int32_t sample_frames)
+{
+    const uint32_t event_count = uvi_event_buffer_due(&plugin->events, sample_frames);
+    uvi_v2_plugin_process_events(plugin, event_count);
+    uvi_event_buffer_consume(&plugin->events, event_count, sample_frames);
 }
 
 static void uvi_v2_plugin_process(UviPlugin *plugin, float **inputs, float **outputs, int32_t sample_frames)
 {
-    uvi_v2_plugin_process_events(plugin);
+    uvi_v2_plugin_deliver_events(plugin, sample_frames);
+
     UviV2Plugin *p = plugin->v2.plugin;
     if (p->flags & UviV2PluginFlags_CanReplacing)
         p->process_replacing(p, inputs, outputs, sample_frames);
 }
 
-static void uvi_v2_plugin_apply_note_event(UviPlugin *plugin, int32_t status, int32_t key, int32_t velocity, int32_t sample_offset)
+static void uvi_v2_plugin_process_double(UviPlugin *plugin, double **inputs, double **outputs, int32_t sample_frames)
 {
-    if (plugin->v2.midi_event_count >= 256)
-        return;
+    uvi_v2_plugin_deliver_events(plugin, sample_frames);
 
-    UviV2MidiEvent &ev = plugin->v2.midi_events[plugin->v2.midi_event_count++];
-    ev.type = 1;
-    ev.byte_size = sizeof(ev);
-    ev.midi_data[0] = (unsigned char)status;
-    ev.midi_data[1] = (unsigned char)key;
-    ev.midi_data[2] = (unsigned char)velocity;
-    ev.delta_frames = sample_offset;
+    UviV2Plugin *p = plugin->v2.plugin;
+    p->process_double_replacing(p, inputs, outputs, sample_frames);
 }
 
 static void uvi_v2_plugin_play_note(UviPlugin *plugin, int32_t key, int32_t velocity, int32_t sample_offset)
 {
-    uvi_v2_plugin_apply_note_event(plugin, 0x90, key, velocity, sample_offset);
+    uvi_plugin_queue_event(plugin, UviEventType_NoteOn, 0, key, velocity, sample_offset);
 }
 
 static void uvi_v2_plugin_stop_note(UviPlugin *plugin, int32_t key, int32_t sample_offset)
 {
-    uvi_v2_plugin_apply_note_event(plugin, 0x80, key, 0, sample_offset);
+    uvi_plugin_queue_event(plugin, UviEventType_NoteOff, 0, key, 0, sample_offset);
 }
 
+// A note off for every held key, plugins are less consistent about
+// honouring the all notes off controller.
 static void uvi_v2_stop_all_notes(UviPlugin *plugin)
 {
-    /*for (int32_t channel = 0; channel < 16; channel++)
+    plugin->events.count = 0;
+    for (int32_t channel = 0; channel < 16; ++channel)
     {
-        UviV2MidiEvent &ev = plugin->v2.midi_events[plugin->v2.midi_event_count++];
-        ev.type = 1;
-        ev.byte_size = sizeof(ev);
-        ev.midiData[0] = 0xB0 | channel;
-        ev.midiData[1] = 123;
-        ev.midiData[2] = 0;
-        ev.delta_frames = 0;
-    }*/
-
-    plugin->v2.midi_event_count = 0;
-    for (int32_t i = 0; i < 128; i++)
-    {
-        UviV2MidiEvent &ev = plugin->v2.midi_events[plugin->v2.midi_event_count++];
-        ev.type = 1;
-        ev.byte_size = sizeof(ev);
-        ev.midi_data[0] = 0x90;
-        ev.midi_data[1] = i;
-        ev.midi_data[2] = 0;
-        ev.delta_frames = 0;
+        for (int32_t word = 0; word < 2; ++word)
+        {
+            for (uint64_t keys = plugin->active_notes[channel][word]; keys; keys &= keys - 1)
+                uvi_plugin_queue_event(plugin, UviEventType_NoteOff, channel, word * 64 + std::countr_zero(keys), 0, 0);
+        }
     }
 }
 
@@ -243,7 +328,7 @@ static void uvi_v2_plugin_deserialize(UviPlugin *plugin, const char *file_path)
         static_cast<intptr_t>(buffer.size()), buffer.data(), 0.0f);
 }
 
-static void uvi_v2_plugin_load(UviPlugin *plugin, float sample_rate = 44100.0f, int32_t block_size = 512)
+static void uvi_v2_plugin_load(UviPlugin *plugin, float sample_rate, int32_t block_size)
 {
     typedef UviV2Plugin* (*PluginMain)(V2AudioMasterCallback audioMaster);
     PluginMain entry = (PluginMain)uvi_get_proc_address(plugin->library, "VSTPluginMain");
@@ -253,7 +338,7 @@ static void uvi_v2_plugin_load(UviPlugin *plugin, float sample_rate = 44100.0f,
     if (!entry)
     {
         printf("[UVI Loader] Not a valid VST 2.x plugin.\n");
-        uvi_library_unload(plugin->library);
+        uvi_library_release(plugin->library);
         return;
     }
     
@@ -261,7 +346,7 @@ static void uvi_v2_plugin_load(UviPlugin *plugin, float sample_rate = 44100.0f,
     if (!p)
     {
         printf("[UVI Loader] VST plugin failed to instantiate.\n");
-        uvi_library_unload(plugin->library);
+        uvi_library_release(plugin->library);
         return;
     }
     
@@ -273,6 +358,8 @@ static void uvi_v2_plugin_load(UviPlugin *plugin, float sample_rate = 44100.0f,
     plugin->close_editor = uvi_v2_plugin_close_editor;
     plugin->get_editor_size = uvi_v2_plugin_get_editor_size;
     plugin->process = uvi_v2_plugin_process;
+    if ((p->flags & UviV2PluginFlags_CanDoubleReplacing) && p->process_double_replacing)
+        plugin->process_double = uvi_v2_plugin_process_double;
     plugin->play_note = uvi_v2_plugin_play_note;
     plugin->stop_note = uvi_v2_plugin_stop_note;
     plugin->stop_all_notes = uvi_v2_stop_all_notes;
@@ -281,6 +368,15 @@ static void uvi_v2_plugin_load(UviPlugin *plugin, float sample_rate = 44100.0f,
     
     memset(&plugin->v2, 0, sizeof(plugin->v2));
     plugin->v2.plugin = p;
+    plugin->v2.midi_events = new UviV2MidiEvent[plugin->events.capacity];
+    plugin->v2.event_list = uvi_v2_events_alloc(plugin->events.capacity);
+    plugin->num_inputs = p->num_inputs;
+    plugin->num_outputs = p->num_outputs;
+    plugin->latency = p->initial_delay;
+    plugin->is_synth = (p->flags & UviV2PluginFlags_IsSynth) != 0;
+    plugin->no_sound_when_idle = (p->flags & UviV2PluginFlags_NoSoundInStop) != 0;
+    p->dispatcher(p, UviV2PluginOpcodes_GetVendorString, 0, 0, plugin->vendor, 0.0f);
+    plugin->vendor[sizeof(plugin->vendor) - 1] = '\0';
     plugin->is_loaded = true;
 }
 
@@ -297,15 +393,347 @@ static void uvi_v2_plguin_unload(UviPlugin *plugin)
     p->dispatcher(p, UviV2PluginOpcodes_MainsChanged, 0, 0, nullptr, 0.0f);
     p->dispatcher(p, UviV2PluginOpcodes_Close, 0, 0, nullptr, 0.0f);
 
-    std::thread([library = plugin->library]() {
-        std::this_thread::sleep_for(std::chrono::milliseconds(1000));
-        uvi_library_unload(library);
-    }).detach();
+    delete[] plugin->v2.midi_events;
+    free(plugin->v2.event_list);
+    uvi_library_release(plugin->library);
 }
 
-UviPlugin uvi_plugin_load(const char *path)
+static void uvi_v2_plugin_reconfigure(UviPlugin *plugin, float sample_rate, int32_t block_size)
+{
+    UviV2Plugin *p = plugin->v2.plugin;
+    p->dispatcher(p, UviV2PluginOpcodes_MainsChanged, 0, 0, nullptr, 0.0f);
+    p->dispatcher(p, UviV2PluginOpcodes_SetSampleRate, 0, 0, nullptr, sample_rate);
+    p->dispatcher(p, UviV2PluginOpcodes_SetBlockSize, 0, (intptr_t)block_size, nullptr, 0);
+    p->dispatcher(p, UviV2PluginOpcodes_MainsChanged, 0, 1, nullptr, 0);
+    plugin->latency = p->initial_delay;
+}
+
+static void uvi_native_plugin_process(UviPlugin *plugin, float **inputs, float **outputs, int32_t sample_frames)
+{
+    const uint32_t event_count = uvi_event_buffer_due(&plugin->events, sample_frames);
+    UviNativeEvent *events = plugin->uvi.events;
+    for (uint32_t i = 0; i < event_count; ++i)
+    {
+        const UviEvent &event = plugin->events.events[i];
+        events[i].frame = (uint32_t)event.frame;
+        events[i].type = (uint8_t)(event.type == UviEventType_NoteOn ? UviNativeEventType_NoteOn :
+            event.type == UviEventType_NoteOff ? UviNativeEventType_NoteOff : UviNativeEventType_AllNotesOff);
+        events[i].channel = event.channel;
+        events[i].key = event.key;
+        events[i].velocity = event.velocity;
+    }
+
+    const uint32_t num_inputs = (uint32_t)plugin->num_inputs;
+    UviNativeProcess process{};
+    process.frame_count = (uint32_t)sample_frames;
+    process.num_inputs = num_inputs;
+    process.num_outputs = (uint32_t)plugin->num_outputs;
+    process.inputs = inputs;
+    process.outputs = outputs;
+    process.silent_inputs = num_inputs >= 64 ? ~0ull : (1ull << num_inputs) - 1;
+    process.events = events;
+    process.event_count = event_count;
+
+    const UviNativeDescriptor *descriptor = plugin->uvi.descriptor;
+    const uint32_t result = descriptor->process(plugin->uvi.instance, &process);
+    plugin->is_silent = (result & UVI_NATIVE_PROCESS_SILENT) != 0;
+    uvi_event_buffer_consume(&plugin->events, event_count, sample_frames);
+}
+
+static void uvi_native_plugin_play_note(UviPlugin *plugin, int32_t key, int32_t velocity, int32_t sample_offset)
+{
+    uvi_plugin_queue_event(plugin, UviEventType_NoteOn, 0, key, velocity, sample_offset);
+}
+
+static void uvi_native_plugin_stop_note(UviPlugin *plugin, int32_t key, int32_t sample_offset)
+{
+    uvi_plugin_queue_event(plugin, UviEventType_NoteOff, 0, key, 0, sample_offset);
+}
+
+static void uvi_native_plugin_stop_all_notes(UviPlugin *plugin)
+{
+    plugin->events.count = 0;
+    uvi_plugin_queue_event(plugin, UviEventType_AllNotesOff, 0, 0, 0, 0);
+}
+
+static void uvi_native_plugin_open_editor(UviPlugin *plugin, void *handle)
+{
+    plugin->uvi.descriptor->open_editor(plugin->uvi.instance, handle);
+    plugin->uvi.editor_handle = handle;
+}
+
+static void uvi_native_plugin_close_editor(UviPlugin *plugin)
+{
+    plugin->uvi.descriptor->close_editor(plugin->uvi.instance);
+    plugin->uvi.editor_handle = nullptr;
+}
+
+static void uvi_native_plugin_get_editor_size(UviPlugin *plugin, uint32_t *width, uint32_t *height)
+{
+    plugin->uvi.descriptor->get_editor_size(plugin->uvi.instance, width, height);
+}
+
+static void uvi_native_plugin_serialize(UviPlugin *plugin, const char *file_path)
+{
+    const UviNativeDescriptor *descriptor = plugin->uvi.descriptor;
+    if (!descriptor->save_state)
+        return;
+
+    std::vector<char> buffer(descriptor->save_state(plugin->uvi.instance, nullptr, 0));
+    if (buffer.empty())
+        return;
+    descriptor->save_state(plugin->uvi.instance, buffer.data(), (uint32_t)buffer.size());
+
+    std::ofstream out(file_path, std::ios::binary);
+    if (!out)
+    {
+        fprintf(stderr, "[UVI Loader] Failed to open state file.\n");
+        return;
+    }
+
+    out.write(buffer.data(), buffer.size());
+}
+
+static void uvi_native_plugin_deserialize(UviPlugin *plugin, const char *file_path)
+{
+    const UviNativeDescriptor *descriptor = plugin->uvi.descriptor;
+    if (!descriptor->load_state)
+        return;
+
+    std::ifstream in(file_path, std::ios::binary);
+    if (!in)
+    {
+        fprintf(stderr, "[UVI Loader] Failed to open state file.\n");
+        return;
+    }
+
+    std::vector<char> buffer((std::istreambuf_iterator<char>(in)),
+        std::istreambuf_iterator<char>());
+
+    if (descriptor->load_state(plugin->uvi.instance, buffer.data(), (uint32_t)buffer.size()) != 0)
+        fprintf(stderr, "[UVI Loader] Plugin rejected its state file.\n");
+
+    if (descriptor->get_latency)
+        plugin->latency = (int32_t)descriptor->get_latency(plugin->uvi.instance);
+}
+
+static void uvi_native_plugin_load(UviPlugin *plugin, float sample_rate, int32_t block_size)
+{
+    UviNativeEntryFunc entry = (UviNativeEntryFunc)uvi_get_proc_address(plugin->library, UVI_NATIVE_ENTRY_NAME);
+    const UviNativeDescriptor *descriptor = entry ? entry(UVI_NATIVE_ABI_VERSION) : nullptr;
+
+    if (!descriptor || descriptor->abi_version != UVI_NATIVE_ABI_VERSION ||
+        !descriptor->create || !descriptor->destroy || !descriptor->process)
+    {
+        printf("[UVI Loader] Not a valid .uvi plugin.\n");
+        uvi_library_release(plugin->library);
+        return;
+    }
+
+    const UviNativeHostInfo native_host_info = { UVI_NATIVE_ABI_VERSION, sample_rate, (uint32_t)block_size };
+    void *instance = descriptor->create(&native_host_info);
+    if (!instance)
+    {
+        printf("[UVI Loader] .uvi plugin failed to instantiate.\n");
+        uvi_library_release(plugin->library);
+        return;
+    }
+
+    const bool has_editor = descriptor->open_editor && descriptor->close_editor && descriptor->get_editor_size;
+    plugin->open_editor = has_editor ? uvi_native_plugin_open_editor : nullptr;
+    plugin->close_editor = has_editor ? uvi_native_plugin_close_editor : nullptr;
+    plugin->get_editor_size = has_editor ? uvi_native_plugin_get_editor_size : nullptr;
+    plugin->process = uvi_native_plugin_process;
+    plugin->play_note = uvi_native_plugin_play_note;
+    plugin->stop_note = uvi_native_plugin_stop_note;
+    plugin->stop_all_notes = uvi_native_plugin_stop_all_notes;
+    plugin->serialize = uvi_native_plugin_serialize;
+    plugin->deserialize = uvi_native_plugin_deserialize;
+
+    memset(&plugin->uvi, 0, sizeof(plugin->uvi));
+    plugin->uvi.descriptor = descriptor;
+    plugin->uvi.instance = instance;
+    plugin->uvi.events = new UviNativeEvent[plugin->events.capacity];
+    if (descriptor->name)
+        strncpy_s(plugin->name, descriptor->name, sizeof(plugin->name));
+    plugin->num_inputs = (int32_t)descriptor->num_inputs;
+    plugin->num_outputs = (int32_t)descriptor->num_outputs;
+    plugin->is_synth = descriptor->num_inputs == 0;
+    plugin->latency = descriptor->get_latency ? (int32_t)descriptor->get_latency(instance) : 0;
+    plugin->is_loaded = true;
+}
+
+// The ABI fixes the rate at create, so the instance is replaced by one
+// created with the new rate and handed the old one's state.
+static void uvi_native_plugin_reconfigure(UviPlugin *plugin, float sample_rate, int32_t block_size)
+{
+    const UviNativeDescriptor *descriptor = plugin->uvi.descriptor;
+    const UviNativeHostInfo native_host_info = { UVI_NATIVE_ABI_VERSION, sample_rate, (uint32_t)block_size };
+    void *instance = descriptor->create(&native_host_info);
+    if (!instance)
+    {
+        printf("[UVI Loader] .uvi plugin failed to instantiate at %g Hz, keeping the old instance.\n", sample_rate);
+        return;
+    }
+
+    std::vector<char> state;
+    if (descriptor->save_state && descriptor->load_state)
+    {
+        state.resize(descriptor->save_state(plugin->uvi.instance, nullptr, 0));
+        if (!state.empty())
+            descriptor->save_state(plugin->uvi.instance, state.data(), (uint32_t)state.size());
+        if (!state.empty() && descriptor->load_state(instance, state.data(), (uint32_t)state.size()) != 0)
+            fprintf(stderr, "[UVI Loader] Plugin rejected its own state.\n");
+    }
+
+    void *editor_handle = plugin->uvi.editor_handle;
+    if (editor_handle)
+        descriptor->close_editor(plugin->uvi.instance);
+    descriptor->destroy(plugin->uvi.instance);
+
+    plugin->uvi.instance = instance;
+    if (editor_handle)
+        descriptor->open_editor(instance, editor_handle);
+    plugin->latency = descriptor->get_latency ? (int32_t)descriptor->get_latency(instance) : 0;
+}
+
+static void uvi_native_plugin_unload(UviPlugin *plugin)
+{
+    plugin->is_loaded = false;
+
+    const UviNativeDescriptor *descriptor = plugin->uvi.descriptor;
+    if (descriptor->close_editor)
+        descriptor->close_editor(plugin->uvi.instance);
+    descriptor->destroy(plugin->uvi.instance);
+    delete[] plugin->uvi.events;
+    uvi_library_release(plugin->library);
+}
+
+static void uvi_event_buffer_alloc(UviEventBuffer *buffer, const UviHostInfo *info)
+{
+    const uint32_t capacity = info->event_capacity ? info->event_capacity : UVI_DEFAULT_EVENT_CAPACITY;
+    buffer->capacity = std::max<uint32_t>(capacity, UVI_MIN_EVENT_CAPACITY);
+    buffer->events = new UviEvent[buffer->capacity];
+    buffer->count = 0;
+}
+
+static void uvi_event_buffer_free(UviEventBuffer *buffer)
+{
+    delete[] buffer->events;
+    *buffer = {};
+}
+
+bool uvi_event_buffer_push(UviEventBuffer *buffer, const UviEvent *event)
+{
+    if (buffer->count >= buffer->capacity)
+        return false;
+
+    // Events mostly arrive in order, equal frames keep the order they came in.
+    uint32_t i = buffer->count++;
+    while (i > 0 && buffer->events[i - 1].frame > event->frame)
+    {
+        buffer->events[i] = buffer->events[i - 1];
+        --i;
+    }
+    buffer->events[i] = *event;
+    return true;
+}
+
+uint32_t uvi_event_buffer_due(const UviEventBuffer *buffer, int32_t frame_count)
+{
+    uint32_t count = 0;
+    while (count < buffer->count && buffer->events[count].frame < frame_count)
+        ++count;
+    return count;
+}
+
+void uvi_event_buffer_consume(UviEventBuffer *buffer, uint32_t event_count, int32_t frame_count)
+{
+    const uint32_t remaining = buffer->count - event_count;
+    for (uint32_t i = 0; i < remaining; ++i)
+    {
+        buffer->events[i] = buffer->events[event_count + i];
+        buffer->events[i].frame -= frame_count;
+    }
+    buffer->count = remaining;
+}
+
+bool uvi_plugin_queue_event(UviPlugin *plugin, UviEventType type, int32_t channel, int32_t key, int32_t velocity, int32_t frame)
+{
+    UviEvent event;
+    event.frame = frame > 0 ? frame : 0;
+    event.type = type;
+    event.channel = (uint8_t)(channel & 15);
+    event.key = (uint8_t)(key & 127);
+    event.velocity = (uint8_t)velocity;
+
+    // A dropped event never reaches the plugin, so it doesn't count.
+    if (!uvi_event_buffer_push(&plugin->events, &event))
+        return false;
+
+    uint64_t *active = plugin->active_notes[event.channel];
+    const uint64_t bit = 1ull << (event.key & 63);
+    if (type == UviEventType_NoteOn)
+        active[event.key >> 6] |= bit;
+    else if (type == UviEventType_NoteOff)
+        active[event.key >> 6] &= ~bit;
+    else
+        memset(plugin->active_notes, 0, sizeof(plugin->active_notes));
+    return true;
+}
+
+bool uvi_plugin_has_active_notes(const UviPlugin *plugin)
+{
+    uint64_t any = 0;
+    for (const uint64_t (&channel)[2] : plugin->active_notes)
+        any |= channel[0] | channel[1];
+    return any != 0;
+}
+
+void uvi_set_host_info(const UviHostInfo *info)
+{
+    std::lock_guard<std::mutex> lock(host_info_mutex);
+    host_info = *info;
+    host_sample_rate.store(info->sample_rate, std::memory_order_relaxed);
+    host_block_size.store(info->block_size, std::memory_order_relaxed);
+}
+
+UviHostInfo uvi_host_info(void)
+{
+    std::lock_guard<std::mutex> lock(host_info_mutex);
+    return host_info;
+}
+
+void uvi_set_thread_pool(UviThreadPoolRunFunc run)
+{
+    thread_pool_run = run;
+}
+
+void uvi_thread_pool_run(UviTaskFunc task, void *task_user, uint32_t task_count)
+{
+    if (thread_pool_run)
+    {
+        thread_pool_run(task, task_user, task_count);
+        return;
+    }
+
+    for (uint32_t i = 0; i < task_count; ++i)
+        task(task_user, i);
+}
+
+UviPlugin uvi_plugin_create(const char *path)
 {
     UviPlugin plugin{};
+    const UviHostInfo info = uvi_host_info();
+    plugin.sample_rate = info.sample_rate;
+    plugin.block_size = info.block_size;
+
+    if (strcmp(path, UVI_SYNTH_PATH) == 0)
+    {
+        uvi_event_buffer_alloc(&plugin.events, &info);
+        uvi_synth_load(&plugin, info.sample_rate);
+        return plugin;
+    }
 
     std::filesystem::path p(path);
     std::filesystem::path extension = p.extension();
@@ -316,17 +744,62 @@ UviPlugin uvi_plugin_load(const char *path)
         plugin.type = UviPluginType_V3;
     else if (extension == ".uvi")
         plugin.type = UviPluginType_Uvi;
+    else if (extension == ".clap")
+        plugin.type = UviPluginType_Clap;
     else
         return {};
 
-    plugin.library = uvi_library_load(path);
+    plugin.library = uvi_library_acquire(path, plugin.type);
+    if (!plugin.library)
+    {
+        printf("[UVI Loader] Failed to open %s.\n", path);
+        return {};
+    }
     strncpy_s(plugin.name, p.stem().string().c_str(), sizeof(plugin.name));
+    uvi_event_buffer_alloc(&plugin.events, &info);
 
     switch (plugin.type)
     {
-    case UviPluginType_V2: uvi_v2_plugin_load(&plugin); break;
+    case UviPluginType_V2: uvi_v2_plugin_load(&plugin, info.sample_rate, info.block_size); break;
+    case UviPluginType_V3:
+        printf("[UVI Loader] VST 3 plugins are not supported.\n");
+        uvi_library_release(plugin.library);
+        break;
+    case UviPluginType_Uvi: uvi_native_plugin_load(&plugin, info.sample_rate, info.block_size); break;
+    case UviPluginType_Clap:
+    {
+        const UviClapPluginEntry *entry = (const UviClapPluginEntry*)uvi_get_proc_address(plugin.library, UVI_CLAP_ENTRY_NAME);
+        if (!uvi_clap_plugin_load(&plugin, entry))
+            uvi_library_release(plugin.library);
+        break;
+    }
+    case UviPluginType_Builtin: break; // loaded before the library is opened
     }
 
+    if (!plugin.is_loaded)
+        uvi_event_buffer_free(&plugin.events);
+    return plugin;
+}
+
+bool uvi_plugin_initialize(UviPlugin *plugin)
+{
+    if (!plugin->is_loaded || plugin->type != UviPluginType_Clap)
+        return plugin->is_loaded;
+
+    const UviHostInfo info = uvi_host_info();
+    plugin->sample_rate = info.sample_rate;
+    plugin->block_size = info.block_size;
+    return uvi_clap_plugin_initialize(plugin, info.sample_rate, info.block_size);
+}
+
+UviPlugin uvi_plugin_load(const char *path)
+{
+    UviPlugin plugin = uvi_plugin_create(path);
+    if (plugin.is_loaded && !uvi_plugin_initialize(&plugin))
+    {
+        uvi_plugin_unload(&plugin);
+        return {};
+    }
     return plugin;
 }
 
@@ -335,5 +808,51 @@ void uvi_plugin_unload(UviPlugin *plugin)
     switch (plugin->type)
     {
     case UviPluginType_V2: uvi_v2_plguin_unload(plugin); break;
+    case UviPluginType_Uvi: uvi_native_plugin_unload(plugin); break;
+    case UviPluginType_V3: break; // never loaded, the library went back on create
+    case UviPluginType_Builtin: uvi_synth_unload(plugin); break;
+    case UviPluginType_Clap:
+        uvi_clap_plugin_unload(plugin);
+        uvi_library_release(plugin->library);
+        break;
     }
+    uvi_event_buffer_free(&plugin->events);
+}
+
+void uvi_plugin_reconfigure(UviPlugin *plugin)
+{
+    const UviHostInfo info = uvi_host_info();
+    if (!plugin->is_loaded || (plugin->sample_rate == info.sample_rate && plugin->block_size == info.block_size))
+        return;
+
+    switch (plugin->type)
+    {
+    case UviPluginType_V2: uvi_v2_plugin_reconfigure(plugin, info.sample_rate, info.block_size); break;
+    case UviPluginType_Uvi: uvi_native_plugin_reconfigure(plugin, info.sample_rate, info.block_size); break;
+    case UviPluginType_Builtin: uvi_synth_set_sample_rate(plugin, info.sample_rate); break;
+    case UviPluginType_Clap: uvi_clap_plugin_reconfigure(plugin, info.sample_rate, info.block_size); break;
+    default: break;
+    }
+
+    plugin->sample_rate = info.sample_rate;
+    plugin->block_size = info.block_size;
+    plugin->events.count = 0;
+    memset(plugin->active_notes, 0, sizeof(plugin->active_notes));
+}
+
+bool uvi_plugin_idle(UviPlugin *plugin)
+{
+    if (!plugin->is_loaded || plugin->type != UviPluginType_Clap)
+        return false;
+    return uvi_clap_plugin_idle(plugin);
+}
+
+void uvi_plugin_restart(UviPlugin *plugin)
+{
+    if (!plugin->is_loaded || plugin->type != UviPluginType_Clap)
+        return;
+
+    uvi_clap_plugin_reconfigure(plugin, plugin->sample_rate, plugin->block_size);
+    plugin->events.count = 0;
+    memset(plugin->active_notes, 0, sizeof(plugin->active_notes));
 }
\ No newline at end of file
@@ -2,6 +2,8 @@
 
 #include <cstdint>
 
+#include "uvi_native.h"
+
 #if defined(_WIN32)
 #include <windows.h>
     typedef HINSTANCE UviLibrary;
@@ -16,16 +18,19 @@ enum UviPluginType : uint8_t
 {
     UviPluginType_V2,
     UviPluginType_V3,
-    UviPluginType_Uvi
+    UviPluginType_Uvi,
+    UviPluginType_Builtin,
+    UviPluginType_Clap
 };
 
 enum UviV2PluginFlags
 {
-	UviV2PluginFlags_HasEditor     = 1 << 0,
-	UviV2PluginFlags_CanReplacing  = 1 << 4,
-	UviV2PluginFlags_ProgramChunks = 1 << 5,
-	UviV2PluginFlags_IsSynth       = 1 << 8,
-	UviV2PluginFlags_NoSoundInStop = 1 << 9
+	UviV2PluginFlags_HasEditor          = 1 << 0,
+	UviV2PluginFlags_CanReplacing       = 1 << 4,
+	UviV2PluginFlags_ProgramChunks      = 1 << 5,
+	UviV2PluginFlags_IsSynth            = 1 << 8,
+	UviV2PluginFlags_NoSoundInStop      = 1 << 9,
+	UviV2PluginFlags_CanDoubleReplacing = 1 << 12
 };
 
 enum UviV2PluginOpcodes
@@ -49,6 +54,7 @@ enum UviV2PluginOpcodes
 	UviV2PluginOpcodes_GetChunk = 23,
 	UviV2PluginOpcodes_SetChunk = 24,
 	UviV2PluginOpcodes_ProcessEvents = 25,
+	UviV2PluginOpcodes_GetVendorString = 47,
 	UviV2PluginOpcodes_StopProcess = 72
  };
 
@@ -106,21 +112,84 @@ struct UviV2MidiEvent
 	char reserved2;
 };
 
+#define UVI_DEFAULT_EVENT_CAPACITY 512
+#define UVI_MIN_EVENT_CAPACITY     256  // a VST 2 stop of every note takes 128
+
+enum UviEventType : uint8_t
+{
+	UviEventType_NoteOn,
+	UviEventType_NoteOff,
+	UviEventType_AllNotesOff
+};
+
+struct UviEvent
+{
+	int32_t frame;
+	UviEventType type;
+	uint8_t channel;
+	uint8_t key;
+	uint8_t velocity;
+};
+
+// Notes queued for the next process call, sorted by frame. Allocated when the
+// plugin loads so queueing never allocates on the audio thread. A process
+// call delivers the events that fall inside it, later ones stay queued and
+// move up by the frames processed. Hosts render up to the queued events when
+// it fills up instead of dropping notes.
+struct UviEventBuffer
+{
+	UviEvent *events = nullptr;
+	uint32_t count = 0;
+	uint32_t capacity = 0;
+};
+
+// False when the buffer is full, the event is dropped.
+bool uvi_event_buffer_push(UviEventBuffer *buffer, const UviEvent *event);
+
+// Number of queued events inside the first frame_count frames.
+uint32_t uvi_event_buffer_due(const UviEventBuffer *buffer, int32_t frame_count);
+
+// Removes the first event_count events and moves the rest frame_count earlier.
+void uvi_event_buffer_consume(UviEventBuffer *buffer, uint32_t event_count, int32_t frame_count);
+
 struct UviPlugin
 {
     UviPluginType type;
     UviLibrary library = nullptr;
 
 	char name[64];
+	char vendor[64];
 	bool is_loaded = false;
+	bool is_synth = false;
+
+	int32_t num_inputs;
+	int32_t num_outputs;
+
+	// Frames of delay the plugin declares, and whether its last process
+	// call produced nothing but silence.
+	int32_t latency = 0;
+	bool is_silent = false;
+
+	// Declared by the plugin, it makes no sound once no note is held.
+	bool no_sound_when_idle = false;
+
+	// Host info the plugin was last set up with.
+	float sample_rate = 0.0f;
+	int32_t block_size = 0;
+
+	UviEventBuffer events;
+
+	// One bit per key and channel, set by a queued note on and cleared by
+	// the matching note off, so a stop only has to release what is held.
+	uint64_t active_notes[16][2] = {};
 
     union
     {
         struct
         {
-			UviV2MidiEvent midi_events[256];
-			uint32_t midi_event_count;
             UviV2Plugin *plugin;
+            UviV2MidiEvent *midi_events;     // events.capacity of each
+            struct UviV2Events *event_list;
         }
 		v2;
 
@@ -132,15 +201,33 @@ struct UviPlugin
 
         struct
         {
-            //V2Plugin *plugin;
+            const UviNativeDescriptor *descriptor;
+            void *instance;
+            UviNativeEvent *events;          // events.capacity
+            void *editor_handle;             // so a recreated instance can reopen it
         }
 		uvi;
+
+        struct
+        {
+            struct UviSynth *synth;
+        }
+		builtin;
+
+        struct
+        {
+            struct UviClapInstance *instance;
+        }
+		clap;
     };
 
 	void (*open_editor)(UviPlugin *plugin, void *handle);
 	void (*close_editor)(UviPlugin *plugin);
 	void (*get_editor_size)(UviPlugin *plugin, uint32_t *width, uint32_t *height);
 	void (*process)(UviPlugin *plugin, float **inputs, float **outputs, int32_t sample_frames);
+
+	// Same as process in double precision, null when the plugin only does floats.
+	void (*process_double)(UviPlugin *plugin, double **inputs, double **outputs, int32_t sample_frames) = nullptr;
 	
 	void (*play_note)(UviPlugin *plugin, int32_t key, int32_t velocity, int32_t sample_offset);
 	void (*stop_note)(UviPlugin *plugin, int32_t key, int32_t sample_offset);
@@ -150,5 +237,63 @@ struct UviPlugin
 	void (*deserialize)(UviPlugin *plugin, const char *file_path);
 };
 
+// Queues an event and keeps active_notes up to date, what play_note,
+// stop_note and stop_all_notes of every plugin type go through. False when
+// the buffer is full, active_notes is left as it was.
+bool uvi_plugin_queue_event(UviPlugin *plugin, UviEventType type, int32_t channel, int32_t key, int32_t velocity, int32_t frame);
+
+inline bool uvi_plugin_is_note_active(const UviPlugin *plugin, int32_t channel, int32_t key)
+{
+	return (plugin->active_notes[channel & 15][(key >> 6) & 1] >> (key & 63)) & 1;
+}
+
+bool uvi_plugin_has_active_notes(const UviPlugin *plugin);
+
+struct UviHostInfo
+{
+	float sample_rate;
+	int32_t block_size;
+	uint32_t event_capacity;  // per plugin, UVI_DEFAULT_EVENT_CAPACITY when 0
+};
+
+// What the host reports to plugins, applies to plugins loaded afterwards.
+// Plugins already loaded pick it up through uvi_plugin_reconfigure.
+void uvi_set_host_info(const UviHostInfo *info);
+UviHostInfo uvi_host_info(void);
+
+// Lets plugins that split their work fan it out over the host's threads.
+// run calls task for every index below task_count and returns once all of
+// them finished, it is called from inside a plugin's process call.
+typedef void (*UviTaskFunc)(void *task_user, uint32_t task_index);
+typedef void (*UviThreadPoolRunFunc)(UviTaskFunc task, void *task_user, uint32_t task_count);
+
+void uvi_set_thread_pool(UviThreadPoolRunFunc run);
+
+// Runs the tasks serially on the caller when no pool was set.
+void uvi_thread_pool_run(UviTaskFunc task, void *task_user, uint32_t task_count);
+
+// Opens the library and creates the plugin, on any thread. CLAP plugins are
+// only instantiated, initialising and activating them is main thread work
+// left to uvi_plugin_initialize, and so is unloading them.
+UviPlugin uvi_plugin_create(const char *path);
+
+// Main thread. Finishes what uvi_plugin_create started with the current host
+// info, false when the plugin refused and can only be unloaded.
+bool uvi_plugin_initialize(UviPlugin *plugin);
+
+// Both of the above at once.
 UviPlugin uvi_plugin_load(const char *path);
-void uvi_plugin_unload(UviPlugin *plugin);
\ No newline at end of file
+void uvi_plugin_unload(UviPlugin *plugin);
+
+// Brings a loaded plugin to the current host info, a no-op when it already
+// runs with it. Nothing may process the plugin meanwhile. Held notes are
+// gone afterwards and the latency may have changed.
+void uvi_plugin_reconfigure(UviPlugin *plugin);
+
+// Main thread, every frame. Serves what the plugin asked the host for from
+// other threads, true while it asks to be restarted.
+bool uvi_plugin_idle(UviPlugin *plugin);
+
+// Main thread. Deactivates and reactivates the plugin with the settings it
+// has, what a restart request asks for. Same rules as reconfiguring.
+void uvi_plugin_restart(UviPlugin *plugin);
\ No newline at end of file
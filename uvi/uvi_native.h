@@ -0,0 +1,101 @@
+#pragma once
+
+// Native .uvi plugin ABI. A .uvi file is a shared library exporting
+// UVI_NATIVE_ENTRY_NAME. Everything crossing the boundary is plain C, the
+// host hands over its own buffers and event list by pointer so nothing is
+// copied or converted per block.
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define UVI_NATIVE_ABI_VERSION       1
+#define UVI_NATIVE_ENTRY_NAME        "uvi_native_entry"
+#define UVI_NATIVE_BUFFER_ALIGNMENT  64
+
+#if defined(_WIN32)
+#define UVI_NATIVE_EXPORT __declspec(dllexport)
+#else
+#define UVI_NATIVE_EXPORT __attribute__((visibility("default")))
+#endif
+
+typedef enum UviNativeEventType
+{
+    UviNativeEventType_NoteOn      = 1,
+    UviNativeEventType_NoteOff     = 2,
+    UviNativeEventType_AllNotesOff = 3
+} UviNativeEventType;
+
+typedef struct UviNativeEvent
+{
+    uint32_t frame;     // offset into the block, < frame_count
+    uint8_t type;       // UviNativeEventType
+    uint8_t channel;
+    uint8_t key;
+    uint8_t velocity;
+} UviNativeEvent;
+
+typedef struct UviNativeHostInfo
+{
+    uint32_t abi_version;
+    float sample_rate;
+    uint32_t max_frame_count;
+} UviNativeHostInfo;
+
+typedef struct UviNativeProcess
+{
+    uint32_t frame_count;
+
+    // Non-interleaved channels, each aligned to UVI_NATIVE_BUFFER_ALIGNMENT
+    // and at least frame_count floats long. Outputs are not cleared.
+    uint32_t num_inputs;
+    uint32_t num_outputs;
+    const float *const *inputs;
+    float *const *outputs;
+
+    // Bit n set when input n is known to be silent this block.
+    uint64_t silent_inputs;
+
+    // Sorted by frame, valid for the duration of the call only.
+    const UviNativeEvent *events;
+    uint32_t event_count;
+} UviNativeProcess;
+
+// Returned by process. With SILENT set the host treats every output as
+// silence and may skip reading them.
+#define UVI_NATIVE_PROCESS_OK      0u
+#define UVI_NATIVE_PROCESS_SILENT  (1u << 0)
+
+typedef struct UviNativeDescriptor
+{
+    uint32_t abi_version;
+    const char *name;
+    uint32_t num_inputs;
+    uint32_t num_outputs;
+
+    void *(*create)(const UviNativeHostInfo *host);
+    void (*destroy)(void *instance);
+
+    // Frames between an input or event and its effect on the output.
+    uint32_t (*get_latency)(void *instance);
+
+    // Called from the audio thread, must not block or allocate.
+    uint32_t (*process)(void *instance, const UviNativeProcess *process);
+
+    // Returns the state size, writes nothing when capacity is too small.
+    uint32_t (*save_state)(void *instance, void *data, uint32_t capacity);
+    int32_t (*load_state)(void *instance, const void *data, uint32_t size);
+
+    // Optional, null when the plugin has no editor.
+    void (*open_editor)(void *instance, void *parent_handle);
+    void (*close_editor)(void *instance);
+    void (*get_editor_size)(void *instance, uint32_t *width, uint32_t *height);
+} UviNativeDescriptor;
+
+typedef const UviNativeDescriptor *(*UviNativeEntryFunc)(uint32_t host_abi_version);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,413 @@
+#include "uvi_synth.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+
+#if defined(_M_X64) || defined(__x86_64__) || defined(__SSE2__)
+#include <emmintrin.h>
+#define UVI_SYNTH_SSE 1
+#endif
+
+// Four voices side by side, the voice loop runs one lane per voice.
+#if UVI_SYNTH_SSE
+struct UviLanes
+{
+    __m128 v;
+
+    static UviLanes load(const float *p) { return { _mm_load_ps(p) }; }
+    static UviLanes set(float x) { return { _mm_set1_ps(x) }; }
+    void store(float *p) const { _mm_store_ps(p, v); }
+
+    friend UviLanes operator+(UviLanes a, UviLanes b) { return { _mm_add_ps(a.v, b.v) }; }
+    friend UviLanes operator-(UviLanes a, UviLanes b) { return { _mm_sub_ps(a.v, b.v) }; }
+    friend UviLanes operator*(UviLanes a, UviLanes b) { return { _mm_mul_ps(a.v, b.v) }; }
+
+    // x - 1 wherever x >= 1
+    static UviLanes wrap(UviLanes x)
+    {
+        const __m128 one = _mm_set1_ps(1.0f);
+        return { _mm_sub_ps(x.v, _mm_and_ps(_mm_cmpge_ps(x.v, one), one)) };
+    }
+};
+#else
+struct UviLanes
+{
+    float v[4];
+
+    static UviLanes load(const float *p) { return { { p[0], p[1], p[2], p[3] } }; }
+    static UviLanes set(float x) { return { { x, x, x, x } }; }
+    void store(float *p) const { for (int i = 0; i < 4; ++i) p[i] = v[i]; }
+
+    friend UviLanes operator+(UviLanes a, UviLanes b) { for (int i = 0; i < 4; ++i) a.v[i] += b.v[i]; return a; }
+    friend UviLanes operator-(UviLanes a, UviLanes b) { for (int i = 0; i < 4; ++i) a.v[i] -= b.v[i]; return a; }
+    friend UviLanes operator*(UviLanes a, UviLanes b) { for (int i = 0; i < 4; ++i) a.v[i] *= b.v[i]; return a; }
+
+    static UviLanes wrap(UviLanes x)
+    {
+        for (int i = 0; i < 4; ++i)
+            x.v[i] -= x.v[i] >= 1.0f ? 1.0f : 0.0f;
+        return x;
+    }
+};
+#endif
+
+// Envelopes and filter coefficients are updated at control rate and
+// ramped linearly in between.
+static constexpr uint32_t k_control_rate = 16;
+static constexpr uint32_t k_lane_groups = UVI_SYNTH_MAX_VOICES / 4;
+static constexpr float k_silence = 1e-4f;
+
+enum UviSynthStage : uint8_t
+{
+    UviSynthStage_Idle,
+    UviSynthStage_Attack,
+    UviSynthStage_Decay,
+    UviSynthStage_Sustain,
+    UviSynthStage_Release
+};
+
+struct UviSynth
+{
+    UviSynthParams params;
+    float sample_rate;
+
+    // Per voice, laid out so four consecutive voices form one lane group.
+    alignas(16) float phase1[UVI_SYNTH_MAX_VOICES];
+    alignas(16) float phase2[UVI_SYNTH_MAX_VOICES];
+    alignas(16) float step1[UVI_SYNTH_MAX_VOICES];
+    alignas(16) float step2[UVI_SYNTH_MAX_VOICES];
+    alignas(16) float low[UVI_SYNTH_MAX_VOICES];
+    alignas(16) float band[UVI_SYNTH_MAX_VOICES];
+    alignas(16) float amp[UVI_SYNTH_MAX_VOICES];
+    alignas(16) float amp_step[UVI_SYNTH_MAX_VOICES];
+    alignas(16) float cutoff[UVI_SYNTH_MAX_VOICES];
+    alignas(16) float cutoff_step[UVI_SYNTH_MAX_VOICES];
+    alignas(16) float damping[UVI_SYNTH_MAX_VOICES];
+
+    float env[UVI_SYNTH_MAX_VOICES];
+    float velocity[UVI_SYNTH_MAX_VOICES];
+    int16_t key[UVI_SYNTH_MAX_VOICES];
+    UviSynthStage stage[UVI_SYNTH_MAX_VOICES];
+    uint32_t age[UVI_SYNTH_MAX_VOICES];
+    uint32_t next_age;
+
+    alignas(16) float mix[k_control_rate][4];
+};
+
+static UviSynth *uvi_synth_get(UviPlugin *plugin)
+{
+    return plugin->builtin.synth;
+}
+
+static void uvi_synth_start_voice(UviSynth *synth, int32_t key, int32_t velocity)
+{
+    // Take an idle voice, otherwise steal the oldest one.
+    uint32_t voice = 0;
+    for (uint32_t i = 0; i < UVI_SYNTH_MAX_VOICES; ++i)
+    {
+        if (synth->stage[i] == UviSynthStage_Idle)
+        {
+            voice = i;
+            break;
+        }
+        if (synth->age[i] < synth->age[voice])
+            voice = i;
+    }
+
+    const float frequency = 440.0f * powf(2.0f, (key - 69) / 12.0f);
+    const float spread = powf(2.0f, synth->params.detune / 1200.0f);
+
+    synth->key[voice] = (int16_t)key;
+    synth->velocity[voice] = velocity / 127.0f;
+    synth->stage[voice] = UviSynthStage_Attack;
+    synth->age[voice] = synth->next_age++;
+    synth->env[voice] = 0.0f;
+    synth->phase1[voice] = 0.0f;
+    synth->phase2[voice] = 0.5f;
+    synth->step1[voice] = frequency / synth->sample_rate;
+    synth->step2[voice] = frequency * spread / synth->sample_rate;
+    synth->low[voice] = 0.0f;
+    synth->band[voice] = 0.0f;
+}
+
+static void uvi_synth_release_voices(UviSynth *synth, int32_t key)
+{
+    for (uint32_t i = 0; i < UVI_SYNTH_MAX_VOICES; ++i)
+    {
+        if (synth->stage[i] != UviSynthStage_Idle && (key < 0 || synth->key[i] == key))
+            synth->stage[i] = UviSynthStage_Release;
+    }
+}
+
+// Advances one voice's envelope by frame_count frames and sets up the
+// per-sample ramps to get there.
+static void uvi_synth_update_voice(UviSynth *synth, uint32_t voice, uint32_t frame_count)
+{
+    const UviSynthParams &params = synth->params;
+    const float sample_rate = synth->sample_rate;
+    const float frames = (float)frame_count;
+
+    const float env_start = synth->env[voice];
+    float env = env_start;
+
+    switch (synth->stage[voice])
+    {
+    case UviSynthStage_Idle:
+        env = 0.0f;
+        break;
+    case UviSynthStage_Attack:
+        env += frames / std::max(params.attack * sample_rate, 1.0f);
+        if (env >= 1.0f)
+        {
+            env = 1.0f;
+            synth->stage[voice] = UviSynthStage_Decay;
+        }
+        break;
+    case UviSynthStage_Decay:
+        env = params.sustain + (env - params.sustain) * expf(-frames / std::max(params.decay * sample_rate, 1.0f));
+        if (fabsf(env - params.sustain) < k_silence)
+        {
+            env = params.sustain;
+            synth->stage[voice] = UviSynthStage_Sustain;
+        }
+        break;
+    case UviSynthStage_Sustain:
+        env = params.sustain;
+        break;
+    case UviSynthStage_Release:
+        env *= expf(-frames / std::max(params.release * sample_rate, 1.0f));
+        if (env < k_silence)
+        {
+            env = 0.0f;
+            synth->stage[voice] = UviSynthStage_Idle;
+        }
+        break;
+    }
+    synth->env[voice] = env;
+
+    const float gain = params.gain * synth->velocity[voice];
+    synth->amp[voice] = env_start * gain;
+    synth->amp_step[voice] = (env - env_start) * gain / frames;
+
+    // Chamberlin state variable filter, only stable well below Nyquist.
+    auto coefficient = [&](float e)
+    {
+        const float hz = std::min(params.cutoff * (1.0f + params.env_amount * e), sample_rate * 0.16f);
+        return 2.0f * sinf(3.14159265f * hz / sample_rate);
+    };
+    const float f_start = coefficient(env_start);
+    synth->cutoff[voice] = f_start;
+    synth->cutoff_step[voice] = (coefficient(env) - f_start) / frames;
+    synth->damping[voice] = 2.0f - 1.9f * std::clamp(params.resonance, 0.0f, 1.0f);
+}
+
+static bool uvi_synth_group_audible(const UviSynth *synth, uint32_t group)
+{
+    for (uint32_t i = group * 4; i < group * 4 + 4; ++i)
+    {
+        if (synth->amp[i] != 0.0f || synth->amp_step[i] != 0.0f)
+            return true;
+    }
+    return false;
+}
+
+static void uvi_synth_render(UviSynth *synth, float *left, float *right, uint32_t frame_count)
+{
+    for (uint32_t i = 0; i < UVI_SYNTH_MAX_VOICES; ++i)
+        uvi_synth_update_voice(synth, i, frame_count);
+
+    memset(synth->mix, 0, sizeof(synth->mix));
+
+    const UviLanes one = UviLanes::set(1.0f);
+    for (uint32_t group = 0; group < k_lane_groups; ++group)
+    {
+        if (!uvi_synth_group_audible(synth, group))
+            continue;
+
+        const uint32_t base = group * 4;
+        UviLanes phase1 = UviLanes::load(synth->phase1 + base);
+        UviLanes phase2 = UviLanes::load(synth->phase2 + base);
+        UviLanes low = UviLanes::load(synth->low + base);
+        UviLanes band = UviLanes::load(synth->band + base);
+        UviLanes amp = UviLanes::load(synth->amp + base);
+        UviLanes f = UviLanes::load(synth->cutoff + base);
+        const UviLanes step1 = UviLanes::load(synth->step1 + base);
+        const UviLanes step2 = UviLanes::load(synth->step2 + base);
+        const UviLanes amp_step = UviLanes::load(synth->amp_step + base);
+        const UviLanes f_step = UviLanes::load(synth->cutoff_step + base);
+        const UviLanes q = UviLanes::load(synth->damping + base);
+
+        for (uint32_t i = 0; i < frame_count; ++i)
+        {
+            const UviLanes osc = (phase1 + phase2) - one;
+            phase1 = UviLanes::wrap(phase1 + step1);
+            phase2 = UviLanes::wrap(phase2 + step2);
+
+            low = low + f * band;
+            const UviLanes high = osc - low - q * band;
+            band = band + f * high;
+
+            (UviLanes::load(synth->mix[i]) + low * amp).store(synth->mix[i]);
+            amp = amp + amp_step;
+            f = f + f_step;
+        }
+
+        phase1.store(synth->phase1 + base);
+        phase2.store(synth->phase2 + base);
+        low.store(synth->low + base);
+        band.store(synth->band + base);
+    }
+
+    for (uint32_t i = 0; i < frame_count; ++i)
+    {
+        const float sample = synth->mix[i][0] + synth->mix[i][1] + synth->mix[i][2] + synth->mix[i][3];
+        left[i] = sample;
+        right[i] = sample;
+    }
+
+    for (uint32_t i = 0; i < UVI_SYNTH_MAX_VOICES; ++i)
+    {
+        if (synth->stage[i] == UviSynthStage_Idle)
+            synth->low[i] = synth->band[i] = 0.0f;
+    }
+}
+
+static void uvi_synth_apply_event(UviSynth *synth, const UviEvent &event)
+{
+    if (event.type == UviEventType_NoteOn)
+        uvi_synth_start_voice(synth, event.key, std::max<int32_t>(1, event.velocity));
+    else
+        uvi_synth_release_voices(synth, event.type == UviEventType_AllNotesOff ? -1 : event.key);
+}
+
+static void uvi_synth_process(UviPlugin *plugin, float **, float **outputs, int32_t sample_frames)
+{
+    UviSynth *synth = uvi_synth_get(plugin);
+    const UviEvent *events = plugin->events.events;
+    const uint32_t event_count = uvi_event_buffer_due(&plugin->events, sample_frames);
+
+    uint32_t event_index = 0;
+    uint32_t frame = 0;
+    while (frame < (uint32_t)sample_frames)
+    {
+        while (event_index < event_count && (uint32_t)events[event_index].frame <= frame)
+            uvi_synth_apply_event(synth, events[event_index++]);
+
+        uint32_t end = std::min<uint32_t>(frame + k_control_rate, (uint32_t)sample_frames);
+        if (event_index < event_count)
+            end = std::min<uint32_t>(end, (uint32_t)events[event_index].frame);
+
+        uvi_synth_render(synth, outputs[0] + frame, outputs[1] + frame, end - frame);
+        frame = end;
+    }
+
+    uvi_event_buffer_consume(&plugin->events, event_count, sample_frames);
+}
+
+static void uvi_synth_play_note(UviPlugin *plugin, int32_t key, int32_t velocity, int32_t sample_offset)
+{
+    uvi_plugin_queue_event(plugin, UviEventType_NoteOn, 0, key, velocity, sample_offset);
+}
+
+static void uvi_synth_stop_note(UviPlugin *plugin, int32_t key, int32_t sample_offset)
+{
+    uvi_plugin_queue_event(plugin, UviEventType_NoteOff, 0, key, 0, sample_offset);
+}
+
+static void uvi_synth_stop_all_notes(UviPlugin *plugin)
+{
+    plugin->events.count = 0;
+    uvi_plugin_queue_event(plugin, UviEventType_AllNotesOff, 0, 0, 0, 0);
+}
+
+#define UVI_SYNTH_PARAMS(X) \
+    X(attack) X(decay) X(sustain) X(release) X(detune) X(cutoff) X(resonance) X(env_amount) X(gain)
+
+static void uvi_synth_serialize(UviPlugin *plugin, const char *file_path)
+{
+    const UviSynthParams &params = uvi_synth_get(plugin)->params;
+
+    std::ofstream out(file_path);
+    if (!out)
+    {
+        fprintf(stderr, "[UVI Synth] Failed to open state file.\n");
+        return;
+    }
+
+#define UVI_SYNTH_WRITE(NAME) out << #NAME << " " << params.NAME << "\n";
+    UVI_SYNTH_PARAMS(UVI_SYNTH_WRITE)
+#undef UVI_SYNTH_WRITE
+}
+
+static void uvi_synth_deserialize(UviPlugin *plugin, const char *file_path)
+{
+    UviSynthParams &params = uvi_synth_get(plugin)->params;
+
+    std::ifstream in(file_path);
+    if (!in)
+    {
+        fprintf(stderr, "[UVI Synth] Failed to open state file.\n");
+        return;
+    }
+
+    std::string name;
+    float value;
+    while (in >> name >> value)
+    {
+#define UVI_SYNTH_READ(NAME) if (name == #NAME) params.NAME = value;
+        UVI_SYNTH_PARAMS(UVI_SYNTH_READ)
+#undef UVI_SYNTH_READ
+    }
+}
+
+void uvi_synth_load(UviPlugin *plugin, float sample_rate)
+{
+    UviSynth *synth = new UviSynth{};
+    synth->sample_rate = sample_rate > 0.0f ? sample_rate : 44100.0f;
+
+    plugin->type = UviPluginType_Builtin;
+    plugin->builtin.synth = synth;
+    strncpy(plugin->name, "Uphonic Synth", sizeof(plugin->name) - 1);
+
+    plugin->open_editor = nullptr;
+    plugin->close_editor = nullptr;
+    plugin->get_editor_size = nullptr;
+    plugin->process = uvi_synth_process;
+    plugin->play_note = uvi_synth_play_note;
+    plugin->stop_note = uvi_synth_stop_note;
+    plugin->stop_all_notes = uvi_synth_stop_all_notes;
+    plugin->serialize = uvi_synth_serialize;
+    plugin->deserialize = uvi_synth_deserialize;
+
+    plugin->num_inputs = 0;
+    plugin->num_outputs = 2;
+    plugin->is_synth = true;
+    plugin->is_loaded = true;
+}
+
+void uvi_synth_unload(UviPlugin *plugin)
+{
+    plugin->is_loaded = false;
+    delete plugin->builtin.synth;
+    plugin->builtin.synth = nullptr;
+}
+
+void uvi_synth_set_sample_rate(UviPlugin *plugin, float sample_rate)
+{
+    // Pitch steps and envelope rates were derived from the old rate, start
+    // over with only the params kept.
+    UviSynth *synth = uvi_synth_get(plugin);
+    const UviSynthParams params = synth->params;
+    *synth = UviSynth{};
+    synth->params = params;
+    synth->sample_rate = sample_rate > 0.0f ? sample_rate : 44100.0f;
+}
+
+UviSynthParams *uvi_synth_params(UviPlugin *plugin)
+{
+    return plugin->type == UviPluginType_Builtin ? &plugin->builtin.synth->params : nullptr;
+}
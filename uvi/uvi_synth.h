@@ -0,0 +1,29 @@
+#pragma once
+
+#include "uvi_loader.h"
+
+// Built-in polyphonic synth, two detuned saws per voice through a resonant
+// low pass with an ADSR on both amplitude and cutoff. It lives in the host
+// so MIDI tracks work without any external plugin.
+
+#define UVI_SYNTH_PATH       "builtin:synth"
+#define UVI_SYNTH_MAX_VOICES 16
+
+struct UviSynthParams
+{
+    float attack = 0.005f;      // seconds
+    float decay = 0.3f;         // seconds
+    float sustain = 0.6f;
+    float release = 0.25f;      // seconds
+    float detune = 8.0f;        // cents between the two oscillators
+    float cutoff = 2400.0f;     // Hz
+    float resonance = 0.3f;     // 0..1
+    float env_amount = 2.0f;    // cutoff multiplier at full envelope
+    float gain = 0.25f;
+};
+
+void uvi_synth_load(UviPlugin *plugin, float sample_rate);
+void uvi_synth_unload(UviPlugin *plugin);
+void uvi_synth_set_sample_rate(UviPlugin *plugin, float sample_rate);
+
+UviSynthParams *uvi_synth_params(UviPlugin *plugin);